@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global operator new with one that counts every heap allocation
+// the program makes, for benchmarks that check a path does not allocate.
+// Include it in exactly one translation unit of an executable.
+
+static std::atomic<uint64_t> g_Allocations{ 0 };
+
+inline uint64_t AllocationCount()
+{
+	return g_Allocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size)
+{
+	g_Allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = std::malloc(size ? size : 1))
+	{
+		return memory;
+	}
+	throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+// GCC sees the free of memory from operator new once both are inlined and
+// warns about a mismatch that this replacement makes intended.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+void operator delete[](void* memory) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	operator delete(memory);
+}
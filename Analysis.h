@@ -0,0 +1,484 @@
+#pragma once
+
+#include "Decode.h"
+#include "Latency.h"
+#include "Throttle.h"
+#include "Trace.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Offline statistics over a recorded trace, computed in parallel.
+//
+// The trace is cut into fixed-size chunks that worker threads analyse
+// independently. Everything that depends on what came before a chunk (the
+// interval to the previous frame, which pointer a promoted mouse message
+// belongs to, throttle windows) is patched up when the chunk results are merged,
+// which happens in chunk order on the calling thread, so the result is the
+// same whatever the thread count and chunk size.
+
+// Messages are attributed to devices by pointer type, as captured in the
+// record's pointer details; records without details count as POINTER_KIND_UNKNOWN.
+constexpr size_t POINTER_KIND_UNKNOWN = 0;
+constexpr size_t POINTER_KIND_COUNT = PT_TOUCHPAD + 1;
+
+constexpr std::string_view PointerKindName(size_t kind)
+{
+	switch (kind)
+	{
+	case PT_POINTER: return "pointer";
+	case PT_TOUCH: return "touch";
+	case PT_PEN: return "pen";
+	case PT_MOUSE: return "mouse";
+	case PT_TOUCHPAD: return "touchpad";
+	default: return "unknown";
+	}
+}
+
+inline size_t PointerKind(const TraceRecord& record)
+{
+	return (record.flags & TRACE_HAS_POINTER) && record.pointer.pointerType < POINTER_KIND_COUNT ? record.pointer.pointerType : POINTER_KIND_UNKNOWN;
+}
+
+// A sum of squares kept exactly in 128 bits. A double would round
+// differently depending on the order the terms are added in, which depends on
+// where the chunks start.
+struct SquareSum
+{
+	uint64_t low = 0;
+	uint64_t high = 0;
+
+	void Add(uint64_t value)
+	{
+		// value * value from its 32-bit halves a and b:
+		// a^2 * 2^64 + 2ab * 2^32 + b^2.
+		const uint64_t a = value >> 32;
+		const uint64_t b = value & 0xFFFFFFFF;
+		const uint64_t ab = a * b;
+		const uint64_t squareLow = b * b + (ab << 33);
+		const uint64_t squareHigh = a * a + (ab >> 31) + (squareLow < (ab << 33) ? 1 : 0);
+		Add(squareLow, squareHigh);
+	}
+
+	void Merge(const SquareSum& other) { Add(other.low, other.high); }
+
+	double Value() const { return std::ldexp(static_cast<double>(high), 64) + static_cast<double>(low); }
+
+	bool operator==(const SquareSum&) const = default;
+
+private:
+	void Add(uint64_t addLow, uint64_t addHigh)
+	{
+		low += addLow;
+		high += addHigh + (low < addLow ? 1 : 0);
+	}
+};
+
+struct DeviceStats
+{
+	uint64_t pointerMessages = 0;
+	// WM_MOUSE* messages that followed a primary pointer message of the device.
+	uint64_t promotedMessages = 0;
+	// Nanoseconds between consecutive WM_POINTERUPDATEs of the primary pointer.
+	LatencyHistogram intervals{};
+	SquareSum intervalSquares{};
+
+	void AddInterval(int64_t nanoseconds)
+	{
+		intervals.Record(nanoseconds);
+		intervalSquares.Add(nanoseconds < 0 ? 0 - static_cast<uint64_t>(nanoseconds) : static_cast<uint64_t>(nanoseconds));
+	}
+
+	void Merge(const DeviceStats& other)
+	{
+		pointerMessages += other.pointerMessages;
+		promotedMessages += other.promotedMessages;
+		intervals.Merge(other.intervals);
+		intervalSquares.Merge(other.intervalSquares);
+	}
+
+	double PromotionRatio() const
+	{
+		return pointerMessages ? static_cast<double>(promotedMessages) / static_cast<double>(pointerMessages) : 0.0;
+	}
+
+	// Standard deviation of the update interval, in nanoseconds.
+	double Jitter() const
+	{
+		const uint64_t count = intervals.Count();
+		if (count < 2)
+		{
+			return 0.0;
+		}
+		const double mean = static_cast<double>(intervals.Mean());
+		return std::sqrt(std::max<double>(0.0, intervalSquares.Value() / static_cast<double>(count) - mean * mean));
+	}
+};
+
+struct TraceAnalysis
+{
+	uint64_t records = 0;
+	// Records no decoder exists for.
+	uint64_t undecoded = 0;
+	// WM_MOUSE* messages seen before any primary pointer message.
+	uint64_t unattributedMouse = 0;
+	std::array<DeviceStats, POINTER_KIND_COUNT> devices{};
+	// Per g_Messages entry: messages seen, and the ones a fixed-window
+	// Throttler would have dropped.
+	std::array<uint64_t, g_MessageCount> messages{};
+	std::array<uint64_t, g_MessageCount> throttled{};
+};
+
+struct AnalysisOptions
+{
+	size_t threads = 0;
+	size_t chunkRecords = 64 * 1024;
+	std::chrono::nanoseconds throttleWindow = ThrottleConfig::DEFAULT_WINDOW;
+};
+
+namespace AnalysisDetail
+{
+	constexpr int64_t NEVER = INT64_MIN / 2;
+
+	inline bool IsMouseMessage(UINT uMsg)
+	{
+		return uMsg >= WM_MOUSEMOVE && uMsg <= WM_MOUSEHWHEEL;
+	}
+
+	// ThrottlePolicy::FixedWindow, replayed on trace timestamps: a message is
+	// dropped when it arrives within the window of the last one let through.
+	struct FixedWindow
+	{
+		std::array<int64_t, g_MessageCount> marks;
+
+		FixedWindow() { marks.fill(NEVER); }
+
+		bool Drop(size_t index, int64_t now, int64_t window)
+		{
+			if (now - marks[index] < window)
+			{
+				return true;
+			}
+			marks[index] = now;
+			return false;
+		}
+	};
+
+	struct ChunkResult
+	{
+		TraceAnalysis analysis{};
+		// Mouse messages before the first primary pointer message, which belong
+		// to whichever device was primary at the end of the previous chunks.
+		uint64_t leadingMouse = 0;
+		size_t lastPrimaryKind = SIZE_MAX;
+		std::array<int64_t, POINTER_KIND_COUNT> firstUpdate{};
+		std::array<int64_t, POINTER_KIND_COUNT> lastUpdate{};
+		FixedWindow throttle{};
+	};
+
+	inline void AnalyzeChunk(const TraceRecord* records, size_t count, int64_t frequency, int64_t window, ChunkResult& result)
+	{
+		TraceAnalysis& analysis = result.analysis;
+		result.firstUpdate.fill(NEVER);
+		result.lastUpdate.fill(NEVER);
+		analysis.records = count;
+		for (size_t i = 0; i < count; i++)
+		{
+			const TraceRecord& record = records[i];
+			const MessageInfo* info = FindMessage(record.message);
+			if (!info)
+			{
+				analysis.undecoded++;
+				continue;
+			}
+			const size_t index = static_cast<size_t>(info - g_Messages);
+			analysis.messages[index]++;
+			analysis.throttled[index] += result.throttle.Drop(index, record.timestamp, window);
+
+			if (IsMouseMessage(record.message))
+			{
+				if (result.lastPrimaryKind == SIZE_MAX)
+				{
+					result.leadingMouse++;
+				}
+				else
+				{
+					analysis.devices[result.lastPrimaryKind].promotedMessages++;
+				}
+				continue;
+			}
+			if (!HasPointerIdWParam(record.message))
+			{
+				continue;
+			}
+
+			const size_t kind = PointerKind(record);
+			DeviceStats& device = analysis.devices[kind];
+			device.pointerMessages++;
+			if (!IS_POINTER_PRIMARY_WPARAM(record.wParam))
+			{
+				continue;
+			}
+			result.lastPrimaryKind = kind;
+			if (record.message == WM_POINTERUPDATE)
+			{
+				if (result.lastUpdate[kind] == NEVER)
+				{
+					result.firstUpdate[kind] = record.timestamp;
+				}
+				else
+				{
+					device.AddInterval(TicksToNanoseconds(record.timestamp - result.lastUpdate[kind], frequency));
+				}
+				result.lastUpdate[kind] = record.timestamp;
+			}
+		}
+	}
+
+	// Replays the start of a chunk with the throttle state carried over from
+	// the chunks before it, next to the chunk's own replay from a clean state,
+	// until the two agree for every message type. From then on the chunk's own
+	// decisions stand. Message types whose carried mark is a window older than
+	// the current record can no longer be affected, so the replay usually stops
+	// within a window of the chunk start. Returns the throttle state at the end
+	// of the chunk.
+	inline FixedWindow RethrottleChunk(const TraceRecord* records, size_t count, int64_t window, const FixedWindow& incoming, ChunkResult& result)
+	{
+		FixedWindow carried = incoming;
+		FixedWindow clean{};
+		std::array<bool, g_MessageCount> pending{};
+		std::array<bool, g_MessageCount> seen{};
+		size_t unsettled = 0;
+		size_t active = 0;
+		int64_t horizon = NEVER;
+		for (size_t index = 0; index < g_MessageCount; index++)
+		{
+			if (incoming.marks[index] != NEVER)
+			{
+				pending[index] = true;
+				unsettled++;
+				horizon = std::max<int64_t>(horizon, incoming.marks[index] + window);
+			}
+		}
+
+		for (size_t i = 0; i < count && unsettled > 0; i++)
+		{
+			if (active == 0 && records[i].timestamp >= horizon)
+			{
+				break;
+			}
+			const MessageInfo* info = FindMessage(records[i].message);
+			if (!info)
+			{
+				continue;
+			}
+			const size_t index = static_cast<size_t>(info - g_Messages);
+			if (!pending[index])
+			{
+				continue;
+			}
+			if (!seen[index])
+			{
+				seen[index] = true;
+				active++;
+			}
+			const bool carriedDrop = carried.Drop(index, records[i].timestamp, window);
+			const bool cleanDrop = clean.Drop(index, records[i].timestamp, window);
+			result.analysis.throttled[index] += static_cast<uint64_t>(carriedDrop) - static_cast<uint64_t>(cleanDrop);
+			if (carried.marks[index] == clean.marks[index])
+			{
+				pending[index] = false;
+				unsettled--;
+				active--;
+			}
+		}
+
+		FixedWindow outgoing = result.throttle;
+		for (size_t index = 0; index < g_MessageCount; index++)
+		{
+			// A type still pending was either never settled, or did not occur
+			// before the replay stopped; in the second case its first later
+			// occurrence is let through either way.
+			if (pending[index] && (seen[index] || outgoing.marks[index] == NEVER))
+			{
+				outgoing.marks[index] = carried.marks[index];
+			}
+		}
+		return outgoing;
+	}
+
+	// Hands out chunk indices. Each worker owns a contiguous range and takes
+	// from its front; idle workers steal from the back of the fullest range.
+	// Both ends live in one word so either side claims a chunk with one CAS.
+	class alignas(64) ChunkRange
+	{
+	public:
+		void Assign(uint32_t begin, uint32_t end) { m_range.store(Pack(begin, end), std::memory_order_relaxed); }
+
+		bool TakeFront(uint32_t& index)
+		{
+			uint64_t range = m_range.load(std::memory_order_relaxed);
+			do
+			{
+				if (Begin(range) >= End(range))
+				{
+					return false;
+				}
+				index = Begin(range);
+			} while (!m_range.compare_exchange_weak(range, Pack(index + 1, End(range)), std::memory_order_relaxed));
+			return true;
+		}
+
+		bool TakeBack(uint32_t& index)
+		{
+			uint64_t range = m_range.load(std::memory_order_relaxed);
+			do
+			{
+				if (Begin(range) >= End(range))
+				{
+					return false;
+				}
+				index = End(range) - 1;
+			} while (!m_range.compare_exchange_weak(range, Pack(Begin(range), index), std::memory_order_relaxed));
+			return true;
+		}
+
+		uint32_t Remaining() const
+		{
+			const uint64_t range = m_range.load(std::memory_order_relaxed);
+			return Begin(range) < End(range) ? End(range) - Begin(range) : 0;
+		}
+
+	private:
+		static uint64_t Pack(uint32_t begin, uint32_t end) { return static_cast<uint64_t>(begin) << 32 | end; }
+		static uint32_t Begin(uint64_t range) { return static_cast<uint32_t>(range >> 32); }
+		static uint32_t End(uint64_t range) { return static_cast<uint32_t>(range); }
+
+		std::atomic<uint64_t> m_range{ 0 };
+	};
+}
+
+// `frequency` is the trace's timestamp frequency.
+inline TraceAnalysis AnalyzeTrace(const TraceRecord* records, size_t count, int64_t frequency, const AnalysisOptions& options = {})
+{
+	using namespace AnalysisDetail;
+
+	const size_t chunkRecords = std::max<size_t>(options.chunkRecords, 1);
+	const size_t chunkCount = (count + chunkRecords - 1) / chunkRecords;
+	const size_t hardware = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	const size_t threads = std::clamp<size_t>(options.threads ? options.threads : hardware, 1, std::max<size_t>(chunkCount, 1));
+	const int64_t window = options.throttleWindow.count() / 1000000000 * frequency + options.throttleWindow.count() % 1000000000 * frequency / 1000000000;
+
+	std::vector<ChunkResult> chunks(chunkCount);
+	const auto chunkSize = [&](size_t chunk) { return std::min<size_t>(chunkRecords, count - chunk * chunkRecords); };
+
+	auto ranges = std::make_unique<ChunkRange[]>(threads);
+	for (size_t t = 0; t < threads; t++)
+	{
+		ranges[t].Assign(static_cast<uint32_t>(chunkCount * t / threads), static_cast<uint32_t>(chunkCount * (t + 1) / threads));
+	}
+	const auto work = [&](size_t self)
+	{
+		for (;;)
+		{
+			uint32_t chunk = 0;
+			if (!ranges[self].TakeFront(chunk))
+			{
+				size_t victim = self;
+				uint32_t most = 0;
+				for (size_t t = 0; t < threads; t++)
+				{
+					const uint32_t remaining = ranges[t].Remaining();
+					if (remaining > most)
+					{
+						most = remaining;
+						victim = t;
+					}
+				}
+				if (most == 0)
+				{
+					return;
+				}
+				if (!ranges[victim].TakeBack(chunk))
+				{
+					continue;
+				}
+			}
+			AnalyzeChunk(records + chunk * chunkRecords, chunkSize(chunk), frequency, window, chunks[chunk]);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	for (size_t t = 1; t < threads; t++)
+	{
+		workers.emplace_back(work, t);
+	}
+	work(0);
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	TraceAnalysis analysis{};
+	size_t primaryKind = SIZE_MAX;
+	std::array<int64_t, POINTER_KIND_COUNT> lastUpdate{};
+	lastUpdate.fill(NEVER);
+	FixedWindow throttle{};
+	for (size_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		ChunkResult& result = chunks[chunk];
+		if (chunk > 0)
+		{
+			throttle = RethrottleChunk(records + chunk * chunkRecords, chunkSize(chunk), window, throttle, result);
+		}
+		else
+		{
+			throttle = result.throttle;
+		}
+
+		const TraceAnalysis& part = result.analysis;
+		analysis.records += part.records;
+		analysis.undecoded += part.undecoded;
+		for (size_t i = 0; i < g_MessageCount; i++)
+		{
+			analysis.messages[i] += part.messages[i];
+			analysis.throttled[i] += part.throttled[i];
+		}
+		if (primaryKind == SIZE_MAX)
+		{
+			analysis.unattributedMouse += result.leadingMouse;
+		}
+		else
+		{
+			analysis.devices[primaryKind].promotedMessages += result.leadingMouse;
+		}
+		for (size_t kind = 0; kind < POINTER_KIND_COUNT; kind++)
+		{
+			analysis.devices[kind].Merge(part.devices[kind]);
+			if (result.firstUpdate[kind] != NEVER && lastUpdate[kind] != NEVER)
+			{
+				analysis.devices[kind].AddInterval(TicksToNanoseconds(result.firstUpdate[kind] - lastUpdate[kind], frequency));
+			}
+			if (result.lastUpdate[kind] != NEVER)
+			{
+				lastUpdate[kind] = result.lastUpdate[kind];
+			}
+		}
+		if (result.lastPrimaryKind != SIZE_MAX)
+		{
+			primaryKind = result.lastPrimaryKind;
+		}
+		// Chunk histograms are large; release them as soon as they are merged.
+		result = ChunkResult{};
+	}
+	return analysis;
+}
@@ -0,0 +1,77 @@
+#include "Analysis.h"
+#include "Trace.h"
+#include <fmt/core.h>
+#include <chrono>
+#include <cstdlib>
+
+// Prints per-device and per-message statistics for a recorded trace.
+//
+//     WmPointerAnalyzer trace.wmpt [threads]
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fmt::print(stderr, "Usage: {} trace.wmpt [threads]\n", argv[0]);
+		return 1;
+	}
+	TraceReader reader{};
+	if (!reader.Open(argv[1]))
+	{
+		fmt::print(stderr, "Unable to open trace {}\n", argv[1]);
+		return 1;
+	}
+
+	AnalysisOptions options{};
+	if (argc > 2)
+	{
+		options.threads = static_cast<size_t>(std::strtoul(argv[2], nullptr, 10));
+	}
+	const int64_t frequency = reader.Header().timestampFrequency;
+	const auto start = std::chrono::steady_clock::now();
+	const TraceAnalysis analysis = AnalyzeTrace(reader.begin(), reader.size(), frequency, options);
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+
+	fmt::print(
+		"{} records, {} undecoded, analysed in {:.1f} ms\n",
+		analysis.records,
+		analysis.undecoded,
+		static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()) / 1000.0
+	);
+
+	fmt::print("\nIntervals between primary pointer updates, in ms\n");
+	fmt::print("Device      Pointer msgs  Promoted  Ratio  Mean interval  p50      p99      Jitter\n");
+	for (size_t kind = 0; kind < POINTER_KIND_COUNT; kind++)
+	{
+		const DeviceStats& device = analysis.devices[kind];
+		if (device.pointerMessages == 0 && device.promotedMessages == 0)
+		{
+			continue;
+		}
+		fmt::print(
+			"{:<10}  {:>12}  {:>8}  {:>5.2f}  {:>13.3f}  {:>7.3f}  {:>7.3f}  {:>7.3f}\n",
+			PointerKindName(kind),
+			device.pointerMessages,
+			device.promotedMessages,
+			device.PromotionRatio(),
+			static_cast<double>(device.intervals.Mean()) / 1e6,
+			static_cast<double>(device.intervals.Percentile(50)) / 1e6,
+			static_cast<double>(device.intervals.Percentile(99)) / 1e6,
+			device.Jitter() / 1e6
+		);
+	}
+	if (analysis.unattributedMouse)
+	{
+		fmt::print("{} mouse messages before any primary pointer\n", analysis.unattributedMouse);
+	}
+
+	fmt::print("\nMessage                    Count    Throttled ({} ms)\n", std::chrono::duration_cast<std::chrono::milliseconds>(options.throttleWindow).count());
+	for (size_t i = 0; i < g_MessageCount; i++)
+	{
+		if (analysis.messages[i])
+		{
+			fmt::print("{:<24}  {:>8}  {:>8}\n", g_Messages[i].name, analysis.messages[i], analysis.throttled[i]);
+		}
+	}
+	return 0;
+}
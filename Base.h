@@ -5,8 +5,6 @@
 #include <fmt/core.h>
 #include <string>
 
-constexpr int g_ThrottleMilliseconds = 500;
-
 #ifdef UNICODE
 #include <locale>
 
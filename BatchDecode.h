@@ -0,0 +1,220 @@
+#pragma once
+
+#include "Trace.h"
+#include "WinCompat.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BATCH_DECODE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define BATCH_DECODE_AVX2
+#else
+#define BATCH_DECODE_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Column-wise decode of pointer message parameters, for analysing recorded
+// streams in bulk. For every message:
+//
+//     pointerId[i] = GET_POINTERID_WPARAM(wParam[i])
+//     flags[i]     = HIWORD(wParam[i]), the POINTER_MESSAGE_FLAG_* bits tested
+//                    by IS_POINTER_*_WPARAM
+//     x[i]         = GET_X_LPARAM(lParam[i])
+//     y[i]         = GET_Y_LPARAM(lParam[i])
+//
+// Only the low 32 bits of each parameter are significant, as with the macros.
+struct PointerParamColumns
+{
+	std::vector<uint16_t> pointerId;
+	std::vector<uint16_t> flags;
+	std::vector<int32_t> x;
+	std::vector<int32_t> y;
+
+	void Resize(size_t count)
+	{
+		pointerId.resize(count);
+		flags.resize(count);
+		x.resize(count);
+		y.resize(count);
+	}
+
+	size_t Size() const { return pointerId.size(); }
+};
+
+enum class DecodeKernel : uint8_t
+{
+	Scalar,
+	SSE2,
+	AVX2,
+};
+
+constexpr const char* DecodeKernelName(DecodeKernel kernel)
+{
+	switch (kernel)
+	{
+	case DecodeKernel::SSE2: return "SSE2";
+	case DecodeKernel::AVX2: return "AVX2";
+	default: return "scalar";
+	}
+}
+
+inline void DecodeParamsScalar(const uint64_t* wParam, const int64_t* lParam, size_t count, uint16_t* pointerId, uint16_t* flags, int32_t* x, int32_t* y)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		pointerId[i] = static_cast<uint16_t>(GET_POINTERID_WPARAM(wParam[i]));
+		flags[i] = HIWORD(wParam[i]);
+		x[i] = GET_X_LPARAM(lParam[i]);
+		y[i] = GET_Y_LPARAM(lParam[i]);
+	}
+}
+
+#ifdef BATCH_DECODE_X86
+
+namespace BatchDecodeDetail
+{
+	// Low 32 bits of four consecutive 64-bit values.
+	inline __m128i LowDwords(const void* values)
+	{
+		const __m128i a = _mm_loadu_si128(static_cast<const __m128i*>(values));
+		const __m128i b = _mm_loadu_si128(static_cast<const __m128i*>(values) + 1);
+		return _mm_unpacklo_epi64(_mm_shuffle_epi32(a, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 0, 2, 0)));
+	}
+
+	// Eight 16-bit halves, taken from the low (shift 16) or high (shift 0)
+	// word of two vectors of dwords. SSE2 only packs with signed saturation,
+	// so each word is sign-extended first, which makes the pack exact.
+	template <int Shift>
+	inline __m128i PackWords(__m128i a, __m128i b)
+	{
+		return _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, Shift), 16), _mm_srai_epi32(_mm_slli_epi32(b, Shift), 16));
+	}
+
+	BATCH_DECODE_AVX2 inline __m256i LowDwords256(const void* values)
+	{
+		const __m256i index = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+		const __m256i a = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(static_cast<const __m256i*>(values)), index);
+		const __m256i b = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(static_cast<const __m256i*>(values) + 1), index);
+		return _mm256_permute2x128_si256(a, b, 0x20);
+	}
+
+	template <int Shift>
+	BATCH_DECODE_AVX2 inline __m256i PackWords256(__m256i a, __m256i b)
+	{
+		// packs works within 128-bit lanes; put the quadwords back in order.
+		const __m256i packed = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_slli_epi32(a, Shift), 16), _mm256_srai_epi32(_mm256_slli_epi32(b, Shift), 16));
+		return _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+	}
+}
+
+inline void DecodeParamsSSE2(const uint64_t* wParam, const int64_t* lParam, size_t count, uint16_t* pointerId, uint16_t* flags, int32_t* x, int32_t* y)
+{
+	using namespace BatchDecodeDetail;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i w0 = LowDwords(wParam + i);
+		const __m128i w1 = LowDwords(wParam + i + 4);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pointerId + i), PackWords<16>(w0, w1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(flags + i), PackWords<0>(w0, w1));
+
+		const __m128i l0 = LowDwords(lParam + i);
+		const __m128i l1 = LowDwords(lParam + i + 4);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(x + i), _mm_srai_epi32(_mm_slli_epi32(l0, 16), 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(x + i + 4), _mm_srai_epi32(_mm_slli_epi32(l1, 16), 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(y + i), _mm_srai_epi32(l0, 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(y + i + 4), _mm_srai_epi32(l1, 16));
+	}
+	DecodeParamsScalar(wParam + i, lParam + i, count - i, pointerId + i, flags + i, x + i, y + i);
+}
+
+BATCH_DECODE_AVX2 inline void DecodeParamsAVX2(const uint64_t* wParam, const int64_t* lParam, size_t count, uint16_t* pointerId, uint16_t* flags, int32_t* x, int32_t* y)
+{
+	using namespace BatchDecodeDetail;
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m256i w0 = LowDwords256(wParam + i);
+		const __m256i w1 = LowDwords256(wParam + i + 8);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pointerId + i), PackWords256<16>(w0, w1));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(flags + i), PackWords256<0>(w0, w1));
+
+		const __m256i l0 = LowDwords256(lParam + i);
+		const __m256i l1 = LowDwords256(lParam + i + 8);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(x + i), _mm256_srai_epi32(_mm256_slli_epi32(l0, 16), 16));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(x + i + 8), _mm256_srai_epi32(_mm256_slli_epi32(l1, 16), 16));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(y + i), _mm256_srai_epi32(l0, 16));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(y + i + 8), _mm256_srai_epi32(l1, 16));
+	}
+	DecodeParamsSSE2(wParam + i, lParam + i, count - i, pointerId + i, flags + i, x + i, y + i);
+}
+
+inline bool HasAVX2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4]{};
+	__cpuid(info, 0);
+	if (info[0] < 7)
+	{
+		return false;
+	}
+	__cpuid(info, 1);
+	// OSXSAVE and AVX, and the OS saving the YMM state.
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+	{
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+// The fastest kernel the CPU supports; SSE2 is part of the x86-64 baseline.
+inline DecodeKernel BestDecodeKernel()
+{
+#ifdef BATCH_DECODE_X86
+	static const DecodeKernel kernel = HasAVX2() ? DecodeKernel::AVX2 : DecodeKernel::SSE2;
+	return kernel;
+#else
+	return DecodeKernel::Scalar;
+#endif
+}
+
+inline void DecodeParams(const uint64_t* wParam, const int64_t* lParam, size_t count, PointerParamColumns& columns, DecodeKernel kernel = BestDecodeKernel())
+{
+	columns.Resize(count);
+	switch (kernel)
+	{
+#ifdef BATCH_DECODE_X86
+	case DecodeKernel::AVX2:
+		DecodeParamsAVX2(wParam, lParam, count, columns.pointerId.data(), columns.flags.data(), columns.x.data(), columns.y.data());
+		break;
+	case DecodeKernel::SSE2:
+		DecodeParamsSSE2(wParam, lParam, count, columns.pointerId.data(), columns.flags.data(), columns.x.data(), columns.y.data());
+		break;
+#endif
+	default:
+		DecodeParamsScalar(wParam, lParam, count, columns.pointerId.data(), columns.flags.data(), columns.x.data(), columns.y.data());
+		break;
+	}
+}
+
+// Splits recorded messages into the parameter arrays the kernels read.
+inline void GatherParams(const TraceRecord* records, size_t count, std::vector<uint64_t>& wParam, std::vector<int64_t>& lParam)
+{
+	wParam.resize(count);
+	lParam.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		wParam[i] = records[i].wParam;
+		lParam[i] = records[i].lParam;
+	}
+}
@@ -0,0 +1,771 @@
+#include "AllocationCount.h"
+#include "Analysis.h"
+#include "BatchDecode.h"
+#include "CoordinateTransform.h"
+#include "DeviceInventory.h"
+#include "DevicePool.h"
+#include "EventCollector.h"
+#include "EventFile.h"
+#include "EventLog.h"
+#include "Gesture.h"
+#include "HeadlessPlatform.h"
+#include "Latency.h"
+#include "LogHistory.h"
+#include "Pipeline.h"
+#include "Print.h"
+#include "Trace.h"
+#include <fmt/core.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Runs recorded or synthetic messages through the headless platform and
+// reports, in order:
+//
+//  - the event pipeline, for each combination of Terse, Throttle and contact
+//    summaries
+//  - keeping the log in the bounded history behind the log view
+//  - formatting decoded messages, with heap allocations
+//  - recording events against rendering them
+//  - exporting events to compressed files
+//  - batch parameter decoding against one record at a time
+//  - batch coordinate conversion against one point at a time
+//  - offline analysis by thread count
+//  - pooled injection devices against one per gesture
+//  - inventory lookups against listing the devices again
+//  - merging messages captured on several threads
+//
+//     WmPointerBenchmark [trace.wmpt]
+
+template <typename Function>
+static double NanosecondsPer(size_t count, size_t rounds, Function&& function)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t round = 0; round < rounds; round++)
+	{
+		function();
+	}
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+	return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / static_cast<double>(count * rounds);
+}
+
+static void BenchmarkDecode(const std::vector<TraceRecord>& records)
+{
+	const size_t rounds = 16;
+
+	// The per-event path: the wParam/lParam macros applied to each record in
+	// place, as the log and the contact tracker do.
+	PointerParamColumns expected{};
+	expected.Resize(records.size());
+	const double perEvent = NanosecondsPer(records.size(), rounds, [&]
+	{
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			const TraceRecord& record = records[i];
+			expected.pointerId[i] = static_cast<uint16_t>(GET_POINTERID_WPARAM(record.wParam));
+			expected.flags[i] = HIWORD(record.wParam);
+			expected.x[i] = GET_X_LPARAM(record.lParam);
+			expected.y[i] = GET_Y_LPARAM(record.lParam);
+		}
+	});
+	fmt::print("decode per event: {:.2f} ns/msg\n", perEvent);
+
+	std::vector<uint64_t> wParam;
+	std::vector<int64_t> lParam;
+	const double gather = NanosecondsPer(records.size(), rounds, [&] { GatherParams(records.data(), records.size(), wParam, lParam); });
+	fmt::print("decode gather: {:.2f} ns/msg\n", gather);
+
+	std::vector<DecodeKernel> kernels{ DecodeKernel::Scalar };
+#ifdef BATCH_DECODE_X86
+	kernels.push_back(DecodeKernel::SSE2);
+	if (BestDecodeKernel() == DecodeKernel::AVX2)
+	{
+		kernels.push_back(DecodeKernel::AVX2);
+	}
+#endif
+	for (const DecodeKernel kernel : kernels)
+	{
+		PointerParamColumns columns{};
+		const double batch = NanosecondsPer(records.size(), rounds, [&] { DecodeParams(wParam.data(), lParam.data(), wParam.size(), columns, kernel); });
+		const bool match = columns.pointerId == expected.pointerId && columns.flags == expected.flags && columns.x == expected.x && columns.y == expected.y;
+		fmt::print("decode batch {}: {:.2f} ns/msg, {}\n", DecodeKernelName(kernel), batch, match ? "matches" : "MISMATCH");
+	}
+}
+
+// The Logger interface LogMessage writes through, into one buffer that is
+// cleared for every message, so that only formatting is measured.
+struct BufferLogger
+{
+	fmt::memory_buffer buffer;
+
+	void Log(std::string_view line)
+	{
+		buffer.append(line);
+		buffer.push_back('\n');
+	}
+
+	template <typename... T>
+	void Log(fmt::format_string<T...> format, T&&... args)
+	{
+		fmt::format_to(fmt::appender(buffer), format, std::forward<T>(args)...);
+		buffer.push_back('\n');
+	}
+};
+
+// Every Format* path and the full decode, each after one pass that lets fmt
+// set itself up; the formatted text goes to a stack buffer.
+static void BenchmarkFormat(const std::vector<TraceRecord>& records)
+{
+	const size_t rounds = 16;
+	std::vector<TraceRecord> messages = records;
+	for (const MessageInfo& info : g_Messages)
+	{
+		for (const WPARAM wParam : { WPARAM{ 0 }, WPARAM{ 0xFFFF0001 }, WPARAM{ PDC_MAPPING_CHANGE }, WPARAM{ 0x7777 } })
+		{
+			TraceRecord record{};
+			record.message = info.id;
+			record.wParam = wParam;
+			record.lParam = MAKELONG(-12, 345);
+			messages.push_back(record);
+		}
+	}
+
+	const auto measure = [&](std::string_view name, auto&& format)
+	{
+		size_t bytes = 0;
+		format(bytes);
+		const uint64_t allocations = AllocationCount();
+		bytes = 0;
+		const double nanoseconds = NanosecondsPer(messages.size(), rounds, [&] { format(bytes); });
+		const double allocated = static_cast<double>(AllocationCount() - allocations) / static_cast<double>(messages.size() * rounds);
+		fmt::print("format {}: {:.2f} ns/event, {:.3f} allocs/event, {} bytes\n", name, nanoseconds, allocated, bytes / rounds);
+	};
+
+	measure("pointer state", [&](size_t& bytes)
+	{
+		for (const TraceRecord& record : messages)
+		{
+			fmt::memory_buffer text;
+			FormatPointerState(fmt::appender(text), static_cast<WPARAM>(record.wParam));
+			bytes += text.size();
+		}
+	});
+	measure("mouse state", [&](size_t& bytes)
+	{
+		for (const TraceRecord& record : messages)
+		{
+			fmt::memory_buffer text;
+			FormatMouseState(fmt::appender(text), static_cast<WPARAM>(record.wParam));
+			bytes += text.size();
+		}
+	});
+	// Named and unnamed device changes alike.
+	measure("device change", [&](size_t& bytes)
+	{
+		for (const TraceRecord& record : messages)
+		{
+			fmt::memory_buffer text;
+			FormatPDC(fmt::appender(text), static_cast<int>(record.wParam & 0xFFF));
+			bytes += text.size();
+		}
+	});
+	// The string-returning helpers, for comparison.
+	measure("PointerState()", [&](size_t& bytes)
+	{
+		for (const TraceRecord& record : messages)
+		{
+			bytes += PointerState(static_cast<WPARAM>(record.wParam)).size();
+		}
+	});
+	measure("decoded message", [&](size_t& bytes)
+	{
+		BufferLogger log;
+		for (const TraceRecord& record : messages)
+		{
+			log.buffer.clear();
+			LogMessage(log, record, false, 1);
+			bytes += log.buffer.size();
+		}
+	});
+}
+
+// Recording is what the event path pays per logged message; rendering is what
+// a text sink pays later, when the arena is drained.
+static void BenchmarkEventLog(const std::vector<TraceRecord>& records)
+{
+	const size_t rounds = 16;
+	using Arena = EventArena<>;
+	auto arena = std::make_unique<Arena>();
+
+	size_t drained = 0;
+	const auto ignore = [&](const EventRecord&, std::string_view) { drained++; };
+	const double record = NanosecondsPer(records.size(), rounds, [&]
+	{
+		for (const TraceRecord& message : records)
+		{
+			if (arena->Full())
+			{
+				arena->Drain(ignore);
+			}
+			arena->Push(MessageEvent(message, true));
+		}
+		arena->Drain(ignore);
+	});
+	fmt::print("event record: {:.2f} ns/msg, {} drained\n", record, drained);
+
+	for (const bool terse : { true, false })
+	{
+		CountingLogSink sink{};
+		TextEventSink text{ sink };
+		const double render = NanosecondsPer(records.size(), rounds, [&]
+		{
+			for (size_t i = 0; i < records.size(); i++)
+			{
+				if (arena->Full())
+				{
+					arena->Drain([&](const EventRecord& event, std::string_view line) { text.Append(event, line); });
+					text.Flush();
+				}
+				arena->Push(MessageEvent(records[i], terse));
+			}
+			arena->Drain([&](const EventRecord& event, std::string_view line) { text.Append(event, line); });
+			text.Flush();
+		});
+		fmt::print("event record and render terse={:d}: {:.2f} ns/msg, {} bytes\n", terse, render, sink.Bytes() / rounds);
+	}
+}
+
+// The writer is given whole drains the way the pipeline hands them over; the
+// queue is sized so that nothing is dropped and the reader can check every
+// event.
+static void BenchmarkEventFile(const std::vector<TraceRecord>& records)
+{
+	const std::filesystem::path directory = std::filesystem::temp_directory_path();
+	for (const BlockCodec codec : { BlockCodec::Stored, BlockCodec::Delta, BlockCodec::LZ4, BlockCodec::Zstd })
+	{
+		if (!BlockCodecAvailable(codec))
+		{
+			continue;
+		}
+		EventFileConfig config{};
+		config.directory = directory;
+		config.baseName = fmt::format("WmPointerBenchmark-{}", BlockCodecName(codec));
+		config.codec = codec;
+		config.maxFiles = 0;
+		config.queueBlocks = records.size() / config.blockEvents + 1;
+
+		EventFileStats stats{};
+		const auto start = std::chrono::steady_clock::now();
+		double append = 0.0;
+		{
+			EventFileWriter writer{ config };
+			append = NanosecondsPer(records.size(), 1, [&]
+			{
+				for (size_t i = 0; i < records.size(); i++)
+				{
+					writer.Append(MessageEvent(records[i], true), {});
+					if (i % 4096 == 4095)
+					{
+						writer.Flush();
+					}
+				}
+			});
+			writer.Sync();
+			stats = writer.Stats();
+		}
+		const double total = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+		size_t matched = 0;
+		const std::vector<std::filesystem::path> files = EventFiles(directory, config.baseName);
+		const double read = NanosecondsPer(records.size(), 1, [&]
+		{
+			for (const std::filesystem::path& path : files)
+			{
+				EventFileReader reader{};
+				EventRecord event{};
+				std::string_view text;
+				if (!reader.Open(path))
+				{
+					continue;
+				}
+				while (reader.Next(event, text))
+				{
+					matched += matched < records.size() && event.timestamp == records[matched].timestamp && event.lParam == records[matched].lParam;
+				}
+			}
+		});
+		for (const std::filesystem::path& path : files)
+		{
+			std::error_code error;
+			std::filesystem::remove(path, error);
+		}
+		fmt::print(
+			"event file {}: {:.2f} ns/msg appending, {:.0f} MB/s written, {:.2f}x, {} files, read {:.2f} ns/msg, {}\n",
+			BlockCodecName(codec),
+			append,
+			static_cast<double>(stats.rawBytes) * 1e3 / total,
+			stats.CompressionRatio(),
+			stats.files,
+			read,
+			matched == records.size() && stats.droppedEvents == 0 ? "matches" : "MISMATCH"
+		);
+	}
+}
+
+static bool SameAnalysis(const TraceAnalysis& a, const TraceAnalysis& b)
+{
+	if (a.records != b.records || a.unattributedMouse != b.unattributedMouse || a.messages != b.messages || a.throttled != b.throttled)
+	{
+		return false;
+	}
+	for (size_t kind = 0; kind < POINTER_KIND_COUNT; kind++)
+	{
+		const DeviceStats& x = a.devices[kind];
+		const DeviceStats& y = b.devices[kind];
+		if (x.pointerMessages != y.pointerMessages
+			|| x.promotedMessages != y.promotedMessages
+			|| x.intervals.Count() != y.intervals.Count()
+			|| x.intervals.Percentile(99) != y.intervals.Percentile(99)
+			|| x.intervalSquares != y.intervalSquares)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void BenchmarkTransform(const std::vector<TraceRecord>& records)
+{
+	const size_t rounds = 16;
+	std::vector<uint64_t> wParam;
+	std::vector<int64_t> lParam;
+	GatherParams(records.data(), records.size(), wParam, lParam);
+	PointerParamColumns decoded{};
+	DecodeParams(wParam.data(), lParam.data(), wParam.size(), decoded);
+
+	// Screen pixels onto a pen's himetric extent, into a client area and down
+	// from 144 DPI; each step rounds on its own, as it would one point at a
+	// time. The steps are kept out of the compiler's sight, as device
+	// rectangles would be, so that it cannot fold the divisions into constants.
+	const RECT himetric{ 0, 0, 29376, 16524 };
+	const RECT pixels{ 0, 0, 2560, 1440 };
+	const std::vector<CoordinateTransform> steps{ PixelsToHimetric(himetric, pixels), ScreenToClient({ 100, 50 }), DpiScale(144, DEFAULT_DPI) };
+
+	PointerParamColumns expected = decoded;
+	const double perPoint = NanosecondsPer(records.size(), rounds, [&]
+	{
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			POINT point{ decoded.x[i], decoded.y[i] };
+			for (const CoordinateTransform& step : steps)
+			{
+				point = step.Apply(point);
+			}
+			expected.x[i] = point.x;
+			expected.y[i] = point.y;
+		}
+	});
+	fmt::print("transform per point: {:.2f} ns/point\n", perPoint);
+
+	// The chain is built once for the device, monitor and DPI and looked up
+	// for every batch.
+	TransformCache cache([&](const TransformKey&)
+	{
+		TransformChain chain{};
+		for (const CoordinateTransform& step : steps)
+		{
+			chain.Append(step);
+		}
+		return chain;
+	});
+	const TransformKey key{ reinterpret_cast<HANDLE>(1), nullptr, DEFAULT_DPI };
+
+	std::vector<DecodeKernel> kernels{ DecodeKernel::Scalar };
+#ifdef BATCH_DECODE_X86
+	kernels.push_back(DecodeKernel::SSE2);
+	if (BestDecodeKernel() == DecodeKernel::AVX2)
+	{
+		kernels.push_back(DecodeKernel::AVX2);
+	}
+#endif
+	for (const DecodeKernel kernel : kernels)
+	{
+		PointerParamColumns columns = decoded;
+		const double batch = NanosecondsPer(records.size(), rounds, [&]
+		{
+			TransformPoints(cache.Get(key), decoded.x.data(), decoded.y.data(), records.size(), columns.x.data(), columns.y.data(), kernel);
+		});
+		const bool match = columns.x == expected.x && columns.y == expected.y;
+		fmt::print("transform batch {}: {:.2f} ns/point, {:.2f}x, {}\n", DecodeKernelName(kernel), batch, perPoint / batch, match ? "matches" : "MISMATCH");
+	}
+}
+
+static void BenchmarkAnalysis(const std::vector<TraceRecord>& records)
+{
+	const size_t rounds = 8;
+	AnalysisOptions options{};
+	options.chunkRecords = 16 * 1024;
+
+	options.threads = 1;
+	const TraceAnalysis expected = AnalyzeTrace(records.data(), records.size(), 1000000000, options);
+	double single = 0.0;
+	const size_t hardware = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	for (size_t threads = 1;; threads = std::min<size_t>(threads * 2, hardware))
+	{
+		options.threads = threads;
+		TraceAnalysis analysis{};
+		const double perMessage = NanosecondsPer(records.size(), rounds, [&] { analysis = AnalyzeTrace(records.data(), records.size(), 1000000000, options); });
+		single = threads == 1 ? perMessage : single;
+		fmt::print(
+			"analysis threads={}: {:.2f} ns/msg, {:.2f}x, {}\n",
+			threads,
+			perMessage,
+			single / perMessage,
+			SameAnalysis(analysis, expected) ? "matches" : "MISMATCH"
+		);
+		if (threads == hardware)
+		{
+			break;
+		}
+	}
+}
+
+// Gestures alternate between a pen and a ten-finger touch device, each ending
+// with its contacts still down so that every return has to reset the device.
+static void BenchmarkDevicePool()
+{
+	const size_t gestures = 10000;
+	std::array<InjectPlan, 2> plans{};
+	plans[0].pointerType = PT_PEN;
+	plans[1].pointerType = PT_TOUCH;
+	plans[1].maxContacts = 10;
+	for (InjectPlan& plan : plans)
+	{
+		for (uint32_t frame = 0; frame < 4; frame++)
+		{
+			plan.frames.push_back({ std::chrono::nanoseconds(0), static_cast<uint32_t>(plan.contacts.size()), plan.maxContacts });
+			for (uint32_t i = 0; i < plan.maxContacts; i++)
+			{
+				InjectContact contact{};
+				contact.pointerId = i;
+				SetContactState(contact, plan.pointerType, i == 0, true, frame != 0);
+				plan.contacts.push_back(contact);
+			}
+		}
+	}
+
+	for (const size_t maxIdle : { size_t{ 0 }, DevicePool::MAX_IDLE })
+	{
+		DevicePool pool{ []() { return std::make_unique<RecordingInjectionBackend>(); }, maxIdle };
+		const double perGesture = NanosecondsPer(gestures, 1, [&]
+		{
+			for (size_t i = 0; i < gestures; i++)
+			{
+				const InjectPlan& plan = plans[i % plans.size()];
+				DeviceLease lease = pool.Acquire(PlanDeviceKey(plan));
+				PlayPlan(plan, lease.Backend());
+			}
+		});
+		const DevicePoolStats stats = pool.Stats();
+		fmt::print(
+			"device pool idle={}: {:.0f} ns/gesture, {} created, {} reused, acquire p50 {} ns, p99 {} ns\n",
+			maxIdle,
+			perGesture,
+			stats.created,
+			stats.reused,
+			stats.acquire.Percentile(50),
+			stats.acquire.Percentile(99)
+		);
+	}
+}
+
+// Looking up the device of every pointer event in the inventory against
+// listing the devices again for each one, then what an arrival and a mapping
+// change cost in queries.
+static void BenchmarkDeviceInventory()
+{
+	const size_t lookups = 1000000;
+	const size_t deviceCount = 8;
+	auto scripted = std::make_unique<ScriptedDeviceSource>();
+	ScriptedDeviceSource& source = *scripted;
+	const PointerDeviceRects rects{ { 0, 0, 29376, 16524 }, { 0, 0, 2560, 1440 } };
+	const std::vector<PointerDeviceProperty> properties(6);
+	for (uintptr_t i = 1; i <= deviceCount; i++)
+	{
+		source.Attach({ reinterpret_cast<HANDLE>(i), i % 2 ? PointerDeviceType::IntegratedPen : PointerDeviceType::Touch, 10, 0, 0 }, rects, properties);
+	}
+	DeviceInventory inventory{ std::move(scripted) };
+	inventory.Refresh();
+
+	int64_t checksum = 0;
+	const double cached = NanosecondsPer(lookups, 1, [&]
+	{
+		for (size_t i = 0; i < lookups; i++)
+		{
+			const PointerDeviceEntry* entry = inventory.Find(reinterpret_cast<HANDLE>(i % deviceCount + 1));
+			checksum += entry ? entry->transform.Apply({ static_cast<LONG>(i % 29376), 8000 }).x : 0;
+		}
+	});
+	std::vector<PointerDeviceDescription> listed;
+	const double listing = NanosecondsPer(lookups, 1, [&]
+	{
+		for (size_t i = 0; i < lookups; i++)
+		{
+			const HANDLE device = reinterpret_cast<HANDLE>(i % deviceCount + 1);
+			source.Devices(listed);
+			PointerDeviceRects found{};
+			if (std::any_of(listed.begin(), listed.end(), [device](const PointerDeviceDescription& d) { return d.device == device; }) && source.Rects(device, found))
+			{
+				checksum += HimetricToPixels(found.himetric, found.pixels).Apply({ static_cast<LONG>(i % 29376), 8000 }).x;
+			}
+		}
+	});
+	fmt::print("device lookup: {:.1f} ns/event cached, {:.1f} ns/event listing devices (checksum {})\n", cached, listing, checksum);
+
+	const auto logUpdate = [&](std::string_view name, WPARAM change)
+	{
+		const uint64_t enumerations = source.Enumerations();
+		const uint64_t rectQueries = source.RectQueries();
+		const uint64_t propertyQueries = source.PropertyQueries();
+		const DeviceInventoryChange result = inventory.Update(change);
+		fmt::print(
+			"device {}: {} added, {} removed, {} remapped with {} listing, {} rect and {} property queries\n",
+			name,
+			result.added,
+			result.removed,
+			result.remapped,
+			source.Enumerations() - enumerations,
+			source.RectQueries() - rectQueries,
+			source.PropertyQueries() - propertyQueries
+		);
+	};
+	source.Attach({ reinterpret_cast<HANDLE>(deviceCount + 1), PointerDeviceType::ExternalPen, 1, 0, 0 }, rects, properties);
+	logUpdate("arrival", PDC_ARRIVAL);
+	source.Detach(reinterpret_cast<HANDLE>(1));
+	logUpdate("removal", PDC_REMOVAL);
+	source.Remap(reinterpret_cast<HANDLE>(2), { { 0, 0, 29376, 16524 }, { 2560, 0, 5120, 1440 } });
+	logUpdate("mapping change", PDC_MAPPING_CHANGE);
+}
+
+// Threads stand in for the UI threads of capture windows, each pushing its
+// share of the messages as fast as it can while this thread merges them. Every
+// merged event is checked against the one before it: timestamps must not go
+// backwards, ties must be in source order and each source must come out in the
+// order it pushed. The delay is from stamping to leaving the merge.
+static void BenchmarkCollector(const std::vector<TraceRecord>& records)
+{
+	const size_t count = std::min<size_t>(records.size(), 1000000);
+	LARGE_INTEGER frequency{};
+	QueryPerformanceFrequency(&frequency);
+	for (const size_t sources : { size_t{ 1 }, size_t{ 2 }, size_t{ 4 }, size_t{ 8 } })
+	{
+		EventCollector<> collector{ sources };
+		std::atomic<size_t> running{ sources };
+		std::vector<std::thread> producers;
+		const auto start = std::chrono::steady_clock::now();
+		for (size_t source = 0; source < sources; source++)
+		{
+			producers.emplace_back([&, source]()
+			{
+				for (size_t i = source; i < count; i += sources)
+				{
+					TraceRecord record = records[i];
+					record.lParam = static_cast<int64_t>(i);
+					while (!collector.Push(source, record))
+					{
+						std::this_thread::yield();
+					}
+				}
+				running.fetch_sub(1, std::memory_order_release);
+			});
+		}
+
+		size_t merged = 0;
+		size_t violations = 0;
+		CollectedEvent last{};
+		std::vector<int64_t> lastSequence(sources, -1);
+		LatencyHistogram delay{};
+		const auto check = [&](const CollectedEvent& event)
+		{
+			delay.Record(TicksToNanoseconds(QpcClock::Now() - event.record.timestamp, frequency.QuadPart));
+			if (merged > 0 && (event.record.timestamp < last.record.timestamp || (event.record.timestamp == last.record.timestamp && event.source < last.source)))
+			{
+				violations++;
+			}
+			if (event.record.lParam <= lastSequence[event.source])
+			{
+				violations++;
+			}
+			lastSequence[event.source] = event.record.lParam;
+			last = event;
+			merged++;
+		};
+		for (;;)
+		{
+			const bool stopped = running.load(std::memory_order_acquire) == 0;
+			if (collector.Drain(check) == 0)
+			{
+				if (stopped)
+				{
+					break;
+				}
+				std::this_thread::yield();
+			}
+		}
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+		for (std::thread& producer : producers)
+		{
+			producer.join();
+		}
+
+		fmt::print(
+			"collector sources={}: {:.1f} ns/event, {} of {} merged, {} out of order, delay p50 {} ns, p99 {} ns\n",
+			sources,
+			static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / static_cast<double>(count ? count : 1),
+			merged,
+			count,
+			violations,
+			delay.Percentile(50),
+			delay.Percentile(99)
+		);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<TraceRecord> records;
+	// Synthetic messages are stamped in HeadlessPlatform ticks.
+	int64_t frequency = 1000000000;
+	if (argc > 1)
+	{
+		TraceReader reader{};
+		if (!reader.Open(argv[1]))
+		{
+			fmt::print(stderr, "Unable to open trace {}\n", argv[1]);
+			return 1;
+		}
+		records.assign(reader.begin(), reader.end());
+		frequency = reader.Header().timestampFrequency;
+	}
+	else
+	{
+		records = SyntheticMessages(1000000);
+	}
+
+	fmt::print("{} messages\n", records.size());
+	for (const bool terse : { true, false })
+	{
+		const std::tuple<bool, ThrottlePolicy, bool> options[] = {
+			{ false, ThrottlePolicy::FixedWindow, false },
+			{ true, ThrottlePolicy::FixedWindow, false },
+			{ true, ThrottlePolicy::Adaptive, false },
+			{ false, ThrottlePolicy::FixedWindow, true },
+		};
+		for (const auto& [throttle, policy, summarize] : options)
+		{
+			CountingLogSink sink{};
+			HeadlessPlatform platform{ sink };
+			EventPipeline pipeline{ platform };
+			pipeline.SetTerse(terse);
+			pipeline.SetThrottling(throttle);
+			pipeline.SetSummarizing(summarize);
+			ThrottleConfig config{};
+			config.policy = policy;
+			pipeline.GetThrottler().Configure(config);
+
+			size_t logged = 0;
+			const auto start = std::chrono::steady_clock::now();
+			for (const TraceRecord& record : records)
+			{
+				platform.SetReplayTime(record.timestamp, frequency);
+				logged += pipeline.Process(record);
+			}
+			pipeline.Tick();
+			const auto elapsed = std::chrono::steady_clock::now() - start;
+
+			fmt::print(
+				"terse={:d} throttle={} summarize={:d}: {:.1f} ns/msg, {} logged, {} bytes in {} batches\n",
+				terse,
+				throttle ? ThrottlePolicyName(policy) : "off",
+				summarize,
+				static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / static_cast<double>(records.size()),
+				logged,
+				sink.Bytes(),
+				sink.Batches()
+			);
+		}
+	}
+
+	// The history is fed whole batches the way the window receives them, and
+	// read back the way the view draws a screenful of lines.
+	StringLogSink text{};
+	HeadlessPlatform platform{ text };
+	EventPipeline pipeline{ platform };
+	pipeline.SetTerse(false);
+	for (size_t i = 0; i < std::min<size_t>(records.size(), 100000); i++)
+	{
+		pipeline.Process(records[i]);
+		if (text.Text().size() > (1 << 16))
+		{
+			pipeline.Flush();
+		}
+	}
+	pipeline.Flush();
+
+	auto history = std::make_unique<LogHistory<>>();
+	const std::string& log = text.Text();
+	const size_t rounds = 16;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t round = 0; round < rounds; round++)
+	{
+		for (size_t offset = 0; offset < log.size();)
+		{
+			const size_t end = std::min<size_t>(log.find('\n', offset + (1 << 14)), log.size() - 1) + 1;
+			history->Append(std::string_view(log).substr(offset, end - offset));
+			offset = end;
+		}
+	}
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	fmt::print(
+		"history append: {:.1f} ns/line, {} of {} lines retained\n",
+		static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / static_cast<double>(history->Total()),
+		history->Size(),
+		history->Total()
+	);
+
+	const size_t screen = 50;
+	size_t bytes = 0;
+	start = std::chrono::steady_clock::now();
+	for (size_t top = 0; top + screen <= history->Size(); top += screen)
+	{
+		for (size_t i = top; i < top + screen; i++)
+		{
+			bytes += history->Line(i).size();
+		}
+	}
+	elapsed = std::chrono::steady_clock::now() - start;
+	fmt::print(
+		"history read: {:.1f} ns/line, {} bytes\n",
+		static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / static_cast<double>(history->Size()),
+		bytes
+	);
+
+	BenchmarkFormat(records);
+	BenchmarkEventLog(records);
+	BenchmarkEventFile(records);
+	BenchmarkDecode(records);
+	BenchmarkTransform(records);
+	BenchmarkAnalysis(records);
+	BenchmarkDevicePool();
+	BenchmarkDeviceInventory();
+	BenchmarkCollector(records);
+	return 0;
+}
@@ -0,0 +1,437 @@
+#pragma once
+
+#include "BatchDecode.h"
+#include "DpiLayout.h"
+#include "WinCompat.h"
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+// One axis of a coordinate conversion:
+//
+//     out = offset + MulDivRound(in - origin, numerator, denominator)
+//
+// which covers himetric to pixels, screen to client and one DPI to another.
+// Every step rounds like MulDiv and gives -1 where MulDiv fails, so
+// conversions are kept separate rather than folded into one matrix; a
+// TransformChain runs them in turn and gives the same result as converting one
+// point at a time. The subtraction and addition wrap around in 32 bits, as
+// they do in the batch kernels.
+struct AxisTransform
+{
+	int32_t origin = 0;
+	int32_t numerator = 1;
+	int32_t denominator = 1;
+	int32_t offset = 0;
+
+	// The batch kernels work in doubles, which are exact up to this
+	// numerator; a chain with anything larger, or a zero denominator, is
+	// converted one point at a time.
+	static constexpr int32_t VECTOR_NUMERATOR_LIMIT = 1 << 19;
+
+	constexpr int32_t Apply(int32_t value) const
+	{
+		const int32_t relative = static_cast<int32_t>(static_cast<uint32_t>(value) - static_cast<uint32_t>(origin));
+		return static_cast<int32_t>(static_cast<uint32_t>(offset) + static_cast<uint32_t>(MulDivRound(relative, numerator, denominator)));
+	}
+
+	constexpr bool Vectorizable() const
+	{
+		return denominator != 0 && numerator <= VECTOR_NUMERATOR_LIMIT && numerator >= -VECTOR_NUMERATOR_LIMIT;
+	}
+};
+
+struct CoordinateTransform
+{
+	AxisTransform x{};
+	AxisTransform y{};
+
+	POINT Apply(POINT point) const { return { x.Apply(point.x), y.Apply(point.y) }; }
+};
+
+// Himetric device coordinates onto the part of the screen the device maps to,
+// as GetPointerDeviceRects describes it.
+inline CoordinateTransform HimetricToPixels(const RECT& himetric, const RECT& pixels)
+{
+	return {
+		{ himetric.left, pixels.right - pixels.left, himetric.right - himetric.left, pixels.left },
+		{ himetric.top, pixels.bottom - pixels.top, himetric.bottom - himetric.top, pixels.top },
+	};
+}
+
+inline CoordinateTransform PixelsToHimetric(const RECT& himetric, const RECT& pixels)
+{
+	return HimetricToPixels(pixels, himetric);
+}
+
+// Screen pixels into the client area whose top left corner is at `clientOrigin`.
+inline CoordinateTransform ScreenToClient(POINT clientOrigin)
+{
+	return { { clientOrigin.x, 1, 1, 0 }, { clientOrigin.y, 1, 1, 0 } };
+}
+
+// Pixels at one DPI to pixels at another, as MulDiv(value, toDpi, fromDpi).
+inline CoordinateTransform DpiScale(uint32_t fromDpi, uint32_t toDpi)
+{
+	const AxisTransform axis{ 0, static_cast<int32_t>(toDpi), static_cast<int32_t>(fromDpi), 0 };
+	return { axis, axis };
+}
+
+namespace BatchDecodeDetail
+{
+	// MulDivRound with the denominator's sign moved onto the numerator, so
+	// that the quotient of magnitudes is all that is left to round. The
+	// reciprocal is rounded up, never down.
+	struct AxisConstants
+	{
+		double numerator = 1.0;
+		double half = 0.0;
+		double reciprocal = 1.0;
+	};
+
+	inline AxisConstants MakeAxisConstants(const AxisTransform& axis)
+	{
+		const int64_t divisor = axis.denominator < 0 ? -static_cast<int64_t>(axis.denominator) : axis.denominator;
+		const double numerator = static_cast<double>(axis.denominator < 0 ? -static_cast<int64_t>(axis.numerator) : axis.numerator);
+		return { numerator, static_cast<double>(divisor / 2), std::nextafter(1.0 / static_cast<double>(divisor), 2.0) };
+	}
+
+	// The truncations of these are the ends of the 32-bit range.
+	constexpr double INT32_BELOW = -2147483649.0;
+	constexpr double INT32_ABOVE = 2147483648.0;
+
+	// value * numerator / divisor, rounded half away from zero. The product
+	// and the rounding offset are exact below 2^51, and with the reciprocal
+	// rounded up their quotient is at least the exact one but never reaches
+	// the next integer, so truncating it after giving it the product's sign
+	// rounds exactly. A result outside the 32-bit range becomes -1, as in
+	// MulDivRound. The vector kernels do the same lane by lane.
+	inline int32_t MulDivRound1(int32_t value, const AxisConstants& constants)
+	{
+		const double product = static_cast<double>(value) * constants.numerator;
+		const double quotient = std::copysign((std::fabs(product) + constants.half) * constants.reciprocal, product);
+		return quotient <= INT32_BELOW || quotient >= INT32_ABOVE ? -1 : static_cast<int32_t>(quotient);
+	}
+}
+
+// Up to MAX_STEPS conversions applied one after another, each rounding on its
+// own. Everything the batch kernels need from the steps is worked out once,
+// when the chain is built, so chains are meant to be kept: TransformCache
+// keeps one per device, monitor and DPI.
+class TransformChain
+{
+public:
+	constexpr static size_t MAX_STEPS = 4;
+
+	// One axis as the batch kernels see it: `scales` scalings, with shift[i]
+	// added to the value before scaling i and shift[scales] after the last.
+	// Each shift folds an offset and the next origin into one 32-bit
+	// addition, and steps that scale by exactly one, such as ScreenToClient,
+	// are folded into the shifts altogether.
+	struct Axis
+	{
+		std::array<int32_t, MAX_STEPS + 1> shift{};
+		std::array<BatchDecodeDetail::AxisConstants, MAX_STEPS> constants{};
+		size_t scales = 0;
+	};
+
+	TransformChain() = default;
+
+	TransformChain(std::initializer_list<CoordinateTransform> steps)
+	{
+		for (const CoordinateTransform& step : steps)
+		{
+			Append(step);
+		}
+	}
+
+	// False, leaving the chain as it was, once it holds MAX_STEPS.
+	bool Append(const CoordinateTransform& step)
+	{
+		if (m_count == MAX_STEPS)
+		{
+			return false;
+		}
+		m_steps[m_count] = step;
+		const bool vectorizable = AppendAxis(m_x, step.x) & AppendAxis(m_y, step.y);
+		m_vectorizable = m_vectorizable && vectorizable;
+		m_count++;
+		return true;
+	}
+
+	POINT Apply(POINT point) const
+	{
+		for (size_t i = 0; i < m_count; i++)
+		{
+			point = m_steps[i].Apply(point);
+		}
+		return point;
+	}
+
+	size_t Steps() const { return m_count; }
+	bool Vectorizable() const { return m_vectorizable; }
+	const Axis& X() const { return m_x; }
+	const Axis& Y() const { return m_y; }
+
+private:
+	// False if the kernels cannot take the step exactly.
+	static bool AppendAxis(Axis& chain, const AxisTransform& axis)
+	{
+		const uint32_t shift = static_cast<uint32_t>(chain.shift[chain.scales]) - static_cast<uint32_t>(axis.origin);
+		if (axis.numerator == axis.denominator && axis.denominator != 0)
+		{
+			chain.shift[chain.scales] = static_cast<int32_t>(shift + static_cast<uint32_t>(axis.offset));
+			return true;
+		}
+		chain.shift[chain.scales] = static_cast<int32_t>(shift);
+		chain.constants[chain.scales] = BatchDecodeDetail::MakeAxisConstants(axis);
+		chain.scales++;
+		chain.shift[chain.scales] = axis.offset;
+		return axis.Vectorizable();
+	}
+
+	std::array<CoordinateTransform, MAX_STEPS> m_steps{};
+	Axis m_x{};
+	Axis m_y{};
+	size_t m_count = 0;
+	bool m_vectorizable = true;
+};
+
+namespace BatchDecodeDetail
+{
+	inline int32_t TransformAxis1(int32_t value, const TransformChain::Axis& axis)
+	{
+		for (size_t i = 0; i < axis.scales; i++)
+		{
+			value = MulDivRound1(static_cast<int32_t>(static_cast<uint32_t>(value) + static_cast<uint32_t>(axis.shift[i])), axis.constants[i]);
+		}
+		return static_cast<int32_t>(static_cast<uint32_t>(value) + static_cast<uint32_t>(axis.shift[axis.scales]));
+	}
+}
+
+inline void TransformPointsScalar(const TransformChain& chain, const int32_t* inX, const int32_t* inY, size_t count, int32_t* outX, int32_t* outY)
+{
+	using namespace BatchDecodeDetail;
+	if (chain.Vectorizable())
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			outX[i] = TransformAxis1(inX[i], chain.X());
+			outY[i] = TransformAxis1(inY[i], chain.Y());
+		}
+		return;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		const POINT point = chain.Apply({ inX[i], inY[i] });
+		outX[i] = point.x;
+		outY[i] = point.y;
+	}
+}
+
+#ifdef BATCH_DECODE_X86
+
+namespace BatchDecodeDetail
+{
+	// MulDivRound1 for two values, as doubles that truncate to the results.
+	inline __m128d MulDivRound2(__m128d value, const AxisConstants& constants)
+	{
+		const __m128d sign = _mm_set1_pd(-0.0);
+		const __m128d product = _mm_mul_pd(value, _mm_set1_pd(constants.numerator));
+		const __m128d dividend = _mm_add_pd(_mm_andnot_pd(sign, product), _mm_set1_pd(constants.half));
+		const __m128d quotient = _mm_or_pd(_mm_mul_pd(dividend, _mm_set1_pd(constants.reciprocal)), _mm_and_pd(sign, product));
+		const __m128d overflow = _mm_or_pd(_mm_cmple_pd(quotient, _mm_set1_pd(INT32_BELOW)), _mm_cmpge_pd(quotient, _mm_set1_pd(INT32_ABOVE)));
+		return _mm_or_pd(_mm_andnot_pd(overflow, quotient), _mm_and_pd(overflow, _mm_set1_pd(-1.0)));
+	}
+
+	BATCH_DECODE_AVX2 inline __m256d MulDivRound4(__m256d value, const AxisConstants& constants)
+	{
+		const __m256d sign = _mm256_set1_pd(-0.0);
+		const __m256d product = _mm256_mul_pd(value, _mm256_set1_pd(constants.numerator));
+		const __m256d dividend = _mm256_add_pd(_mm256_andnot_pd(sign, product), _mm256_set1_pd(constants.half));
+		const __m256d quotient = _mm256_or_pd(_mm256_mul_pd(dividend, _mm256_set1_pd(constants.reciprocal)), _mm256_and_pd(sign, product));
+		const __m256d overflow = _mm256_or_pd(_mm256_cmp_pd(quotient, _mm256_set1_pd(INT32_BELOW), _CMP_LE_OQ), _mm256_cmp_pd(quotient, _mm256_set1_pd(INT32_ABOVE), _CMP_GE_OQ));
+		return _mm256_blendv_pd(quotient, _mm256_set1_pd(-1.0), overflow);
+	}
+
+	// Every step of one axis of the chain on four values, which stay in
+	// registers from the load to the store.
+	inline __m128i TransformAxis4(__m128i value, const TransformChain::Axis& axis)
+	{
+		for (size_t i = 0; i < axis.scales; i++)
+		{
+			value = _mm_add_epi32(value, _mm_set1_epi32(axis.shift[i]));
+			const __m128i low = _mm_cvttpd_epi32(MulDivRound2(_mm_cvtepi32_pd(value), axis.constants[i]));
+			const __m128i high = _mm_cvttpd_epi32(MulDivRound2(_mm_cvtepi32_pd(_mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2))), axis.constants[i]));
+			value = _mm_unpacklo_epi64(low, high);
+		}
+		return _mm_add_epi32(value, _mm_set1_epi32(axis.shift[axis.scales]));
+	}
+
+	BATCH_DECODE_AVX2 inline __m256i TransformAxis8(__m256i value, const TransformChain::Axis& axis)
+	{
+		for (size_t i = 0; i < axis.scales; i++)
+		{
+			value = _mm256_add_epi32(value, _mm256_set1_epi32(axis.shift[i]));
+			const __m128i low = _mm256_cvttpd_epi32(MulDivRound4(_mm256_cvtepi32_pd(_mm256_castsi256_si128(value)), axis.constants[i]));
+			const __m128i high = _mm256_cvttpd_epi32(MulDivRound4(_mm256_cvtepi32_pd(_mm256_extracti128_si256(value, 1)), axis.constants[i]));
+			value = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+		}
+		return _mm256_add_epi32(value, _mm256_set1_epi32(axis.shift[axis.scales]));
+	}
+}
+
+inline void TransformPointsSSE2(const TransformChain& chain, const int32_t* inX, const int32_t* inY, size_t count, int32_t* outX, int32_t* outY)
+{
+	using namespace BatchDecodeDetail;
+	size_t i = 0;
+	if (chain.Vectorizable())
+	{
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inX + i));
+			const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inY + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(outX + i), TransformAxis4(x, chain.X()));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(outY + i), TransformAxis4(y, chain.Y()));
+		}
+	}
+	TransformPointsScalar(chain, inX + i, inY + i, count - i, outX + i, outY + i);
+}
+
+BATCH_DECODE_AVX2 inline void TransformPointsAVX2(const TransformChain& chain, const int32_t* inX, const int32_t* inY, size_t count, int32_t* outX, int32_t* outY)
+{
+	using namespace BatchDecodeDetail;
+	size_t i = 0;
+	if (chain.Vectorizable())
+	{
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(inX + i));
+			const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(inY + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(outX + i), TransformAxis8(x, chain.X()));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(outY + i), TransformAxis8(y, chain.Y()));
+		}
+	}
+	TransformPointsSSE2(chain, inX + i, inY + i, count - i, outX + i, outY + i);
+}
+
+#endif
+
+// Converts `count` points held as x and y columns in one pass over them; the
+// output columns may be the input ones. Every kernel gives exactly
+// TransformChain::Apply for every point, including the -1 where MulDiv would
+// fail; chains the vector kernels cannot handle exactly are converted one
+// point at a time.
+inline void TransformPoints(const TransformChain& chain, const int32_t* inX, const int32_t* inY, size_t count, int32_t* outX, int32_t* outY, DecodeKernel kernel = BestDecodeKernel())
+{
+	switch (kernel)
+	{
+#ifdef BATCH_DECODE_X86
+	case DecodeKernel::AVX2:
+		TransformPointsAVX2(chain, inX, inY, count, outX, outY);
+		break;
+	case DecodeKernel::SSE2:
+		TransformPointsSSE2(chain, inX, inY, count, outX, outY);
+		break;
+#endif
+	default:
+		TransformPointsScalar(chain, inX, inY, count, outX, outY);
+		break;
+	}
+}
+
+// Converts the decoded coordinates in place.
+inline void TransformPoints(const TransformChain& chain, PointerParamColumns& columns, DecodeKernel kernel = BestDecodeKernel())
+{
+	TransformPoints(chain, columns.x.data(), columns.y.data(), columns.x.size(), columns.x.data(), columns.y.data(), kernel);
+}
+
+// What a chain is built for: the device whose rectangles map its points onto
+// the screen, the monitor they land on and the DPI they are converted to.
+struct TransformKey
+{
+	HANDLE device = nullptr;
+	HMONITOR monitor = nullptr;
+	uint32_t dpi = DEFAULT_DPI;
+
+	bool operator==(const TransformKey&) const = default;
+};
+
+// The chains for the most recently used keys, built on a miss, least recently
+// used first out, in the manner of DpiCache. A device's chains go stale when
+// it is remapped; Invalidate drops them. A chain returned by Get stays valid
+// until the next Get, Invalidate or Clear.
+class TransformCache
+{
+public:
+	constexpr static size_t CAPACITY = 8;
+
+	using Factory = std::function<TransformChain(const TransformKey& key)>;
+
+	explicit TransformCache(Factory create, size_t capacity = CAPACITY) : m_create(std::move(create)), m_capacity(capacity < 2 ? 2 : capacity)
+	{
+		m_entries.reserve(m_capacity);
+	}
+
+	const TransformChain& Get(const TransformKey& key)
+	{
+		m_tick++;
+		Entry* oldest = nullptr;
+		for (Entry& entry : m_entries)
+		{
+			if (entry.key == key)
+			{
+				entry.lastUse = m_tick;
+				m_hits++;
+				return entry.chain;
+			}
+			if (!oldest || entry.lastUse < oldest->lastUse)
+			{
+				oldest = &entry;
+			}
+		}
+
+		m_misses++;
+		if (m_entries.size() < m_capacity)
+		{
+			m_entries.push_back({ key, m_tick, m_create(key) });
+			return m_entries.back().chain;
+		}
+		*oldest = { key, m_tick, m_create(key) };
+		m_evictions++;
+		return oldest->chain;
+	}
+
+	void Invalidate(HANDLE device)
+	{
+		std::erase_if(m_entries, [device](const Entry& entry) { return entry.key.device == device; });
+	}
+
+	void Clear() { m_entries.clear(); }
+
+	size_t Size() const { return m_entries.size(); }
+	uint64_t Hits() const { return m_hits; }
+	uint64_t Misses() const { return m_misses; }
+	uint64_t Evictions() const { return m_evictions; }
+
+private:
+	struct Entry
+	{
+		TransformKey key;
+		uint64_t lastUse;
+		TransformChain chain;
+	};
+
+	Factory m_create;
+	size_t m_capacity;
+	std::vector<Entry> m_entries;
+	uint64_t m_tick = 0;
+	uint64_t m_hits = 0;
+	uint64_t m_misses = 0;
+	uint64_t m_evictions = 0;
+};
@@ -0,0 +1,231 @@
+#pragma once
+
+#include "Print.h"
+#include "Trace.h"
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+
+// Values derived from a message's parameters. Each one maps to a single
+// extractor in LogField and to the expression/description pair in
+// g_FieldInfo that is shown in the log.
+enum class Field : uint8_t
+{
+	PointerId,
+	HitTestValue,
+	PointerState,
+	MouseState,
+	X,
+	Y,
+	WheelDelta,
+	MouseWheelDelta,
+	XButton,
+	ActivatedWindow,
+	CapturingWindow,
+	TopLevelWindow,
+	DeviceChange,
+	HitTestPointerId,
+	HitTestX,
+	HitTestY,
+	HitTestOrientation,
+	Count,
+};
+
+struct FieldInfo
+{
+	std::string_view expression;
+	std::string_view description;
+};
+
+constexpr std::array<FieldInfo, static_cast<size_t>(Field::Count)> g_FieldInfo{ {
+	{ "GET_POINTERID_WPARAM(wParam)", "pointer identifier" },
+	{ "HIWORD(wParam)", "hit test value" },
+	{ "PointerState(wParam)", "pointer state" },
+	{ "MouseState(wParam)", "pointer state" },
+	{ "GET_X_LPARAM(lParam)", "x coordinate" },
+	{ "GET_Y_LPARAM(lParam)", "y coordinate" },
+	{ "GET_WHEEL_DELTA_WPARAM(wParam)", "wheel delta" },
+	{ "static_cast<SHORT> HIWORD(wParam)", "wheel delta" },
+	{ "HIWORD(wParam)", "x button" },
+	{ "lParam", "window being activated" },
+	{ "lParam", "window capturing pointer" },
+	{ "wParam", "top level window" },
+	{ "PDC_STR(wParam)", "pointer identifier" },
+	{ "info->pointerId", "pointer identifier" },
+	{ "info->x", "x coordinate" },
+	{ "info->y", "y coordinate" },
+	{ "info->orientation", "orientation" },
+} };
+
+struct MessageInfo
+{
+	UINT id;
+	std::string_view name;
+	uint8_t fieldCount;
+	std::array<Field, 4> fields;
+};
+
+#define MESSAGE_INFO(prefix, message, ...) \
+	MessageInfo{ prefix##_##message, #prefix "_" #message, static_cast<uint8_t>(std::initializer_list<Field>{ __VA_ARGS__ }.size()), { __VA_ARGS__ } }
+
+#define MESSAGE_INFO_BUTTONEVENTS(btn) \
+	MESSAGE_INFO(WM, btn##BUTTONDBLCLK, Field::MouseState, Field::XButton, Field::X, Field::Y), \
+	MESSAGE_INFO(WM, btn##BUTTONDOWN, Field::MouseState, Field::XButton, Field::X, Field::Y), \
+	MESSAGE_INFO(WM, btn##BUTTONUP, Field::MouseState, Field::XButton, Field::X, Field::Y)
+
+// Every message the demo knows how to decode, in log order of derived fields.
+constexpr MessageInfo g_Messages[] = {
+	MESSAGE_INFO(DM, POINTERHITTEST),
+	MESSAGE_INFO(WM, NCPOINTERDOWN, Field::PointerId, Field::HitTestValue, Field::X, Field::Y),
+	MESSAGE_INFO(WM, NCPOINTERUP, Field::PointerId, Field::HitTestValue, Field::X, Field::Y),
+	MESSAGE_INFO(WM, NCPOINTERUPDATE, Field::PointerId, Field::HitTestValue, Field::X, Field::Y),
+	MESSAGE_INFO(WM, POINTERACTIVATE, Field::PointerId, Field::HitTestValue, Field::ActivatedWindow),
+	MESSAGE_INFO(WM, POINTERCAPTURECHANGED, Field::PointerId, Field::CapturingWindow),
+	MESSAGE_INFO(WM, POINTERDEVICECHANGE, Field::DeviceChange),
+	MESSAGE_INFO(WM, POINTERDEVICEINRANGE),
+	MESSAGE_INFO(WM, POINTERDEVICEOUTOFRANGE),
+	MESSAGE_INFO(WM, POINTERDOWN, Field::PointerId, Field::PointerState, Field::X, Field::Y),
+	MESSAGE_INFO(WM, POINTERENTER),
+	MESSAGE_INFO(WM, POINTERLEAVE),
+	MESSAGE_INFO(WM, POINTERROUTEDAWAY),
+	MESSAGE_INFO(WM, POINTERROUTEDRELEASED),
+	MESSAGE_INFO(WM, POINTERROUTEDTO),
+	MESSAGE_INFO(WM, POINTERUP, Field::PointerId, Field::PointerState, Field::X, Field::Y),
+	MESSAGE_INFO(WM, POINTERUPDATE, Field::PointerId, Field::PointerState, Field::X, Field::Y),
+	MESSAGE_INFO(WM, POINTERWHEEL, Field::PointerId, Field::WheelDelta, Field::X, Field::Y),
+	MESSAGE_INFO(WM, POINTERHWHEEL, Field::PointerId, Field::WheelDelta, Field::X, Field::Y),
+	MESSAGE_INFO(WM, TOUCHHITTESTING, Field::HitTestPointerId, Field::HitTestX, Field::HitTestY, Field::HitTestOrientation),
+	MESSAGE_INFO(WM, MOUSEMOVE, Field::MouseState, Field::X, Field::Y),
+	MESSAGE_INFO(WM, MOUSEWHEEL, Field::MouseState, Field::MouseWheelDelta, Field::X, Field::Y),
+	MESSAGE_INFO(WM, MOUSELEAVE),
+	MESSAGE_INFO(WM, MOUSEACTIVATE, Field::TopLevelWindow, Field::X, Field::Y),
+	MESSAGE_INFO_BUTTONEVENTS(R),
+	MESSAGE_INFO_BUTTONEVENTS(L),
+	MESSAGE_INFO_BUTTONEVENTS(M),
+	MESSAGE_INFO_BUTTONEVENTS(X),
+};
+
+#undef MESSAGE_INFO_BUTTONEVENTS
+#undef MESSAGE_INFO
+
+constexpr size_t g_MessageCount = sizeof(g_Messages) / sizeof(g_Messages[0]);
+constexpr UINT g_MessageIndexSize = WM_MOUSELEAVE + 1;
+constexpr uint8_t g_NoMessage = 0xFF;
+
+static_assert(g_MessageCount < g_NoMessage);
+
+// Dense message id -> g_Messages index map, built at compile time.
+constexpr auto g_MessageIndex = []()
+{
+	std::array<uint8_t, g_MessageIndexSize> index{};
+	for (auto& entry : index)
+	{
+		entry = g_NoMessage;
+	}
+	for (size_t i = 0; i < g_MessageCount; i++)
+	{
+		index[g_Messages[i].id] = static_cast<uint8_t>(i);
+	}
+	return index;
+}();
+
+constexpr const MessageInfo* FindMessage(UINT uMsg)
+{
+	if (uMsg >= g_MessageIndexSize || g_MessageIndex[uMsg] == g_NoMessage)
+	{
+		return nullptr;
+	}
+	return &g_Messages[g_MessageIndex[uMsg]];
+}
+
+template <typename Logger>
+void LogField(Logger& log, Field field, const TraceRecord& record)
+{
+	const WPARAM wParam = static_cast<WPARAM>(record.wParam);
+	const LPARAM lParam = static_cast<LPARAM>(record.lParam);
+	const FieldInfo& info = g_FieldInfo[static_cast<size_t>(field)];
+	const auto emit = [&](const auto& value)
+	{
+		log.Log(FMT_STRING("; - {} = {}  {}"), info.expression, value, info.description);
+	};
+
+	// Text-valued fields are rendered into inline storage rather than a
+	// temporary std::string.
+	fmt::memory_buffer text;
+	const auto emitText = [&]()
+	{
+		emit(std::string_view(text.data(), text.size()));
+	};
+
+	switch (field)
+	{
+	case Field::PointerId: emit(GET_POINTERID_WPARAM(wParam)); break;
+	case Field::HitTestValue: emit(HIWORD(wParam)); break;
+	case Field::PointerState: FormatPointerState(fmt::appender(text), wParam); emitText(); break;
+	case Field::MouseState: FormatMouseState(fmt::appender(text), wParam); emitText(); break;
+	case Field::X: emit(GET_X_LPARAM(lParam)); break;
+	case Field::Y: emit(GET_Y_LPARAM(lParam)); break;
+	case Field::WheelDelta: emit(GET_WHEEL_DELTA_WPARAM(wParam)); break;
+	case Field::MouseWheelDelta: emit(static_cast<SHORT>(HIWORD(wParam))); break;
+	case Field::XButton: emit(HIWORD(wParam)); break;
+	case Field::ActivatedWindow: emit(lParam); break;
+	case Field::CapturingWindow: emit(lParam); break;
+	case Field::TopLevelWindow: emit(wParam); break;
+	case Field::DeviceChange: FormatPDC(fmt::appender(text), static_cast<int>(wParam)); emitText(); break;
+	// The hit test input is only available while WM_TOUCHHITTESTING is being
+	// handled, so it is read from the decoded copy in the record.
+	case Field::HitTestPointerId: if (record.flags & TRACE_HAS_HITTEST) emit(record.hitTest.pointerId); break;
+	case Field::HitTestX: if (record.flags & TRACE_HAS_HITTEST) emit(record.hitTest.x); break;
+	case Field::HitTestY: if (record.flags & TRACE_HAS_HITTEST) emit(record.hitTest.y); break;
+	case Field::HitTestOrientation: if (record.flags & TRACE_HAS_HITTEST) emit(record.hitTest.orientation); break;
+	case Field::Count: break;
+	}
+}
+
+// Writes the textual description of a captured message through `log`, which
+// must provide Log(std::string_view) and Log(format, args...). This is used
+// both live from MainWindow::HandleMessage and offline when replaying a trace.
+// Returns false for messages that have no decoder.
+template <typename Logger>
+bool LogMessage(Logger& log, const TraceRecord& record, bool terse, uint32_t throttled = 0)
+{
+	const MessageInfo* info = FindMessage(record.message);
+	if (!info)
+	{
+		return false;
+	}
+
+	if (!terse)
+	{
+		log.Log("");
+	}
+	log.Log(FMT_STRING("{}(wParam: {:#010x}, lParam: {:#010x})"), info->name, static_cast<WPARAM>(record.wParam), static_cast<LPARAM>(record.lParam));
+	if (throttled > 0)
+	{
+		log.Log(FMT_STRING("; (throttled {} previous {} messages)"), throttled, info->name);
+	}
+	if (!terse)
+	{
+		for (uint8_t i = 0; i < info->fieldCount; i++)
+		{
+			LogField(log, info->fields[i], record);
+		}
+	}
+	return true;
+}
+
+// Feeds every record of a trace back through the decoder.
+template <typename Logger>
+size_t ReplayTrace(const TraceReader& reader, Logger& log, bool terse)
+{
+	size_t decoded = 0;
+	for (const TraceRecord& record : reader)
+	{
+		if (LogMessage(log, record, terse))
+		{
+			decoded++;
+		}
+	}
+	return decoded;
+}
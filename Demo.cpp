@@ -1,20 +1,373 @@
 #include "Base.h"
 #include "Print.h"
-#include <unordered_map>
+#include "LogSink.h"
+#include "LogHistory.h"
+#include "Decode.h"
+#include "DeviceInventory.h"
+#include "DevicePool.h"
+#include "DpiLayout.h"
+#include "EventCollector.h"
+#include "EventFile.h"
+#include "Gesture.h"
+#include "Injection.h"
+#include "InjectionWorker.h"
+#include "Latency.h"
+#include "MessageHandler.h"
+#include "Pipeline.h"
+#include "Platform.h"
+#include "PointerHistory.h"
+#include "Stress.h"
+#include "Syscalls.h"
+#include "Throttle.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <iterator>
+#include <memory>
+#include <string_view>
 #include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+// Pen stroke injected with the '1' key: hover in, press, draw a diagonal while
+// pressure ramps up and back down, then lift.
+static const Gesture g_PenStrokeGesture{
+	PT_PEN, 0, 10.0, true, PEN_MASK_PRESSURE, {
+		{ 0ms, 10, 10, 0x000, 0, 0, false },
+		{ 100ms, 20, 20, 0x000, 0, 0, false },
+		{ 200ms, 50, 50, 0x080, 0, 0, true },
+		{ 300ms, 55, 55, 0x100, 0, 0, true },
+		{ 400ms, 58, 58, 0x180, 0, 0, true },
+		{ 500ms, 60, 60, 0x200, 0, 0, true },
+		{ 600ms, 70, 70, 0x280, 0, 0, true },
+		{ 700ms, 80, 80, 0x300, 0, 0, true },
+		{ 800ms, 90, 90, 0x380, 0, 0, true },
+		{ 900ms, 100, 100, 0x400, 0, 0, true },
+		{ 1000ms, 110, 110, 0x380, 0, 0, true },
+		{ 1100ms, 120, 120, 0x300, 0, 0, true },
+		{ 1200ms, 130, 130, 0x280, 0, 0, true },
+		{ 1300ms, 140, 140, 0x200, 0, 0, true },
+		{ 1400ms, 150, 150, 0x180, 0, 0, true },
+		{ 1500ms, 160, 160, 0x100, 0, 0, true },
+		{ 1600ms, 170, 170, 0x080, 0, 0, true },
+		{ 1700ms, 180, 180, 0x000, 0, 0, false },
+	}
+};
+
+// Hovering, tilted pen moving diagonally; injected with the Inject button.
+static const Gesture g_HoverGesture{
+	PT_PEN, 0, 100.0, false, PEN_MASK_PRESSURE | PEN_MASK_TILT_X | PEN_MASK_TILT_Y, {
+		{ 0ms, 100, 100, 0, 15, -26, false },
+		{ 490ms, 345, 345, 0, 15, -26, false },
+	}
+};
+
+// Injects through the documented user32 synthetic pointer API.
+class SyntheticPointerBackend final : public InjectionBackend
+{
+public:
+	~SyntheticPointerBackend() { Close(); }
+
+	bool Open(POINTER_INPUT_TYPE pointerType, uint32_t maxContacts, POINTER_FEEDBACK_MODE feedback) override
+	{
+		Close();
+		m_pointerType = pointerType;
+		m_buffer.resize(maxContacts);
+		m_device = CreateSyntheticPointerDevice(pointerType, maxContacts, feedback);
+		return m_device != nullptr;
+	}
+
+	bool Inject(const InjectContact* contacts, uint32_t count) override
+	{
+		if (!m_device || count > m_buffer.size())
+		{
+			return false;
+		}
+		LARGE_INTEGER now{};
+		QueryPerformanceCounter(&now);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			m_buffer[i] = ToPointerTypeInfo(m_pointerType, contacts[i], now.QuadPart);
+		}
+		return InjectSyntheticPointerInput(m_device, m_buffer.data(), count);
+	}
+
+	void Close() override
+	{
+		if (m_device)
+		{
+			DestroySyntheticPointerDevice(m_device);
+			m_device = nullptr;
+		}
+	}
+
+private:
+	POINTER_INPUT_TYPE m_pointerType = PT_PEN;
+	HSYNTHETICPOINTERDEVICE m_device = nullptr;
+	std::vector<POINTER_TYPE_INFO> m_buffer;
+};
+
+// Pointer devices as the documented user32 API reports them.
+class User32DeviceSource final : public PointerDeviceSource
+{
+public:
+	bool Devices(std::vector<PointerDeviceDescription>& devices) override
+	{
+		devices.clear();
+		UINT32 count = 0;
+		if (!GetPointerDevices(&count, nullptr))
+		{
+			return false;
+		}
+		m_devices.resize(count);
+		if (!GetPointerDevices(&count, m_devices.data()))
+		{
+			return false;
+		}
+		for (UINT32 i = 0; i < count; i++)
+		{
+			const POINTER_DEVICE_INFO& info = m_devices[i];
+			devices.push_back({
+				info.device,
+				static_cast<PointerDeviceType>(info.pointerDeviceType),
+				info.maxActiveContacts,
+				info.startingCursorId,
+				info.displayOrientation,
+			});
+		}
+		return true;
+	}
+
+	bool Rects(HANDLE device, PointerDeviceRects& rects) override
+	{
+		return GetPointerDeviceRects(device, &rects.himetric, &rects.pixels);
+	}
+
+	bool Properties(HANDLE device, std::vector<PointerDeviceProperty>& properties) override
+	{
+		properties.clear();
+		UINT32 count = 0;
+		if (!GetPointerDeviceProperties(device, &count, nullptr))
+		{
+			return false;
+		}
+		m_properties.resize(count);
+		if (count > 0 && !GetPointerDeviceProperties(device, &count, m_properties.data()))
+		{
+			return false;
+		}
+		for (UINT32 i = 0; i < count; i++)
+		{
+			const POINTER_DEVICE_PROPERTY& property = m_properties[i];
+			properties.push_back({
+				property.logicalMin,
+				property.logicalMax,
+				property.physicalMin,
+				property.physicalMax,
+				property.unit,
+				property.unitExponent,
+				property.usagePageId,
+				property.usageId,
+			});
+		}
+		return true;
+	}
 
-class MainWindow final : public BaseWindow<MainWindow>
+private:
+	std::vector<POINTER_DEVICE_INFO> m_devices;
+	std::vector<POINTER_DEVICE_PROPERTY> m_properties;
+};
+
+struct FontDeleter
+{
+	void operator()(HFONT font) const { DeleteFont(font); }
+};
+
+using UniqueFont = std::unique_ptr<std::remove_pointer_t<HFONT>, FontDeleter>;
+
+struct DpiResources
+{
+	UniqueFont logFont;
+	UniqueFont uiFont;
+	int logLineHeight = 16;
+};
+
+// A window that only records the traced messages it receives, for watching
+// pointer input being routed between windows of different threads. Each one
+// runs on its own thread and pushes to the collector shared by all of them and
+// the main window, which the main window drains into its log.
+class CaptureWindow final : public BaseWindow<CaptureWindow>
+{
+public:
+	CaptureWindow(EventCollector<>& collector, Platform& platform, size_t source)
+		: m_collector(collector), m_platform(platform), m_source(source)
+	{
+	}
+
+	PCTSTR ClassName() const { return TEXT("WmPointerCapture"); }
+
+	LRESULT HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
+	{
+		if (IsTracedMessage(uMsg))
+		{
+			TraceRecord record{};
+			record.message = uMsg;
+			record.wParam = wParam;
+			record.lParam = lParam;
+			// Pointer state can only be queried on the thread the message
+			// was sent to; the collector stamps the record.
+			m_platform.CaptureDetails(record, true);
+			m_collector.Push(m_source, record);
+		}
+		if (uMsg == WM_DESTROY)
+		{
+			PostQuitMessage(0);
+			return 0;
+		}
+		return DefWindowProc(m_hwnd, uMsg, wParam, lParam);
+	}
+
+private:
+	EventCollector<>& m_collector;
+	Platform& m_platform;
+	size_t m_source;
+};
+
+// Capture windows, each created on and pumped by a thread of its own. The
+// collector has a source for every window, numbered from 1, and source 0 for
+// the main window's own messages.
+class CaptureThreads
+{
+public:
+	constexpr static size_t WINDOW_COUNT = 3;
+	constexpr static size_t MAIN_SOURCE = 0;
+
+	CaptureThreads(Platform& platform, size_t count = WINDOW_COUNT) : m_collector(count + 1), m_threadIds(count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			m_threads.emplace_back([this, &platform, i]() { Run(platform, i); });
+		}
+	}
+
+	CaptureThreads(const CaptureThreads&) = delete;
+	CaptureThreads& operator=(const CaptureThreads&) = delete;
+
+	~CaptureThreads() { Stop(); }
+
+	// Closes the windows and waits for their threads; whatever they captured
+	// can still be drained.
+	void Stop()
+	{
+		for (size_t i = 0; i < m_threads.size(); i++)
+		{
+			DWORD threadId = 0;
+			while ((threadId = m_threadIds[i].load(std::memory_order_acquire)) == 0)
+			{
+				std::this_thread::yield();
+			}
+			PostThreadMessage(threadId, WM_QUIT, 0, 0);
+		}
+		for (std::thread& thread : m_threads)
+		{
+			thread.join();
+		}
+		m_threads.clear();
+	}
+
+	template <typename Consumer>
+	size_t Drain(Consumer&& consume)
+	{
+		return m_collector.Drain(std::forward<Consumer>(consume));
+	}
+
+	EventCollector<>& Collector() { return m_collector; }
+	size_t Count() const { return m_threadIds.size(); }
+	uint64_t Dropped() const { return m_collector.Dropped(); }
+
+private:
+	void Run(Platform& platform, size_t index)
+	{
+		MSG msg{};
+		// Makes sure the thread has a message queue before Stop can post to it.
+		PeekMessage(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+		m_threadIds[index].store(GetCurrentThreadId(), std::memory_order_release);
+
+		const size_t source = MAIN_SOURCE + 1 + index;
+		CaptureWindow window{ m_collector, platform, source };
+		const auto title = ToWinString(fmt::format(FMT_STRING("WmPointer Capture {}"), source));
+		if (!window.Create(title.c_str(), WS_OVERLAPPEDWINDOW | WS_VISIBLE, 0, CW_USEDEFAULT, CW_USEDEFAULT, 400, 300))
+		{
+			return;
+		}
+		while (GetMessage(&msg, nullptr, 0, 0) > 0)
+		{
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
+		}
+		if (IsWindow(window.Window()))
+		{
+			DestroyWindow(window.Window());
+		}
+	}
+
+	EventCollector<> m_collector;
+	std::vector<std::atomic<DWORD>> m_threadIds;
+	// Started last.
+	std::vector<std::thread> m_threads;
+};
+
+class MainWindow final : public BaseWindow<MainWindow>, public LogSink, public Platform
 {
 public:
 	PCTSTR ClassName() const { return TEXT("WmPointerDemo"); }
 	LRESULT HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam);
-	void InjectEvents() const;
-	void Log(std::string_view Line) const;
-	bool Throttle(UINT uMsg);
+	void InjectEvents();
+	void InjectPenStroke();
+	void LogDevicePools();
+	void UpdateDeviceInventory(WPARAM change);
+	void LogDeviceInventory();
+	void OnInjectionDone(const InjectCompletion& completion);
+	void StartStress();
+	bool OnStressStepDone(const InjectCompletion& completion);
+	void LogStressStep(const StressStepReport& step);
+	void MeasureLatency(UINT uMsg, WPARAM wParam, LPARAM lParam);
+	void ToggleLatency();
+	void CaptureHistory(UINT uMsg, WPARAM wParam);
+	void LogLatency();
+	void Log(std::string_view Line) { m_pipeline.Log(Line); }
+	void Append(std::string_view batch) override;
+	void DrawLogLine(const DRAWITEMSTRUCT& item) const;
+	void ToggleTrace();
+	void ToggleExport();
+	void ToggleCaptureWindows();
+	void DrainCaptureWindows();
+	void LogSyscalls();
+
+	template <typename... T>
+	void Log(fmt::format_string<T...> format, T&&... args)
+	{
+		m_pipeline.Log(format, std::forward<T>(args)...);
+	}
+
+	int64_t Timestamp() override;
+	int64_t TimestampFrequency() override { return m_qpcFrequency; }
+	void CaptureDetails(TraceRecord& record, bool detailed) override;
+	LogSink& Output() override { return *this; }
+	std::unique_ptr<InjectionBackend> CreateInjectionBackend() override;
+
+	void CycleThrottlePolicy();
+	void ScaleThrottleWindow(bool longer);
+	void LogThrottlePolicy();
+	DpiResources CreateDpiResources(uint32_t dpi) const;
 	void UpdateDPIDependentResources();
+	void LayoutChildren(int width, int height);
 
 protected:
-	HWND m_hwndEdit = nullptr;
+	HWND m_hwndLog = nullptr;
 	HWND m_hwndTerse = nullptr;
 	HWND m_hwndThrottle = nullptr;
 	HWND m_hwndMotionEnabled = nullptr;
@@ -23,13 +376,44 @@ protected:
 	HWND m_hwndInject = nullptr;
 
 	int m_dpi = 96;
-	bool m_terse = true;
-	bool m_throttle = false;
-	bool m_motionEnabled = false;
-	bool m_returnZeroOnWMPointer = true;
-	bool m_callPromoteMouseInPointer = false;
-	std::unordered_map<UINT, ULONGLONG> m_msgTickMap{};
-	std::unordered_map<UINT, int> m_throttleCount{};
+	std::atomic<bool> m_stressActive = false;
+	// Stress steps queued on the injection worker, in the order they run.
+	struct StressStep
+	{
+		uint64_t id = 0;
+		StressStepReport report{};
+	};
+	std::vector<StressStep> m_stressSteps;
+	bool m_measureLatency = false;
+	LONGLONG m_qpcFrequency = 1;
+	LatencyTracker m_latency{};
+	bool m_captureHistory = false;
+	PointerHistory m_pointerHistory{};
+	std::vector<POINTER_INFO> m_frameHistory;
+	std::vector<POINTER_PEN_INFO> m_penHistory;
+	std::vector<PointerSample> m_samples;
+	int m_logLineHeight = 16;
+	DpiCache<DpiResources> m_dpiResources{ [this](uint32_t dpi) { return CreateDpiResources(dpi); } };
+	uint32_t m_appliedDpi = 0;
+	LogHistory<> m_history{};
+	EventPipeline m_pipeline{ *this };
+	MessageHandler m_handler{ m_pipeline };
+	TraceWriter m_trace{};
+	std::unique_ptr<EventFileWriter> m_export;
+	std::unique_ptr<CaptureThreads> m_captures;
+	// Capture window of the last message logged from them.
+	uint32_t m_captureSource = UINT32_MAX;
+	// Devices for the '1' key, on the documented user32 API, and for every
+	// other plan on the injection worker, on the platform backend.
+	DevicePool m_syntheticDevices{ []() { return std::make_unique<SyntheticPointerBackend>(); } };
+	DevicePool m_injectionDevices{ [this]() { return CreateInjectionBackend(); } };
+	DeviceInventory m_deviceInventory{ std::make_unique<User32DeviceSource>() };
+	// Declared last so that the worker is stopped before anything it reports
+	// to is torn down.
+	InjectionWorker<> m_injector{
+		m_injectionDevices,
+		[this](const InjectCompletion& completion) { OnInjectionDone(completion); },
+	};
 
 	constexpr static int IDC_TEXTLOG = 100;
 	constexpr static int IDC_TERSE = 101;
@@ -38,6 +422,11 @@ protected:
 	constexpr static int IDC_RETZPTR = 104;
 	constexpr static int IDC_CALLPROMOTE = 105;
 	constexpr static int IDC_INJECT = 106;
+
+	constexpr static UINT_PTR IDT_LOGFLUSH = 1;
+	constexpr static UINT LOG_FLUSH_MILLISECONDS = 16;
+
+	constexpr static UINT WM_APP_INJECTDONE = WM_APP + 1;
 };
 
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR pCmdLine, int nCmdShow)
@@ -45,6 +434,8 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR pCmdLine, int nCmdShow
 	UNREFERENCED_PARAMETER(hInstance);
 	UNREFERENCED_PARAMETER(pCmdLine);
 
+	// Resolve the win32u entry points before any message arrives.
+	Syscalls();
 	EnableMouseInPointer(TRUE);
 	
 	MainWindow win{};
@@ -67,53 +458,52 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR pCmdLine, int nCmdShow
 
 LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
-#define MESSAGE_CASE(prefix, message) \
-	case prefix##_##message: \
-		if (this->m_throttle && this->Throttle(prefix##_##message)) { break; } \
-		if (!this->m_terse) this->Log(""); \
-		this->Log(fmt::format(FMT_STRING(#prefix "_" #message "(wParam: {:#010x}, lParam: {:#010x})"), wParam, lParam)); \
-		if (this->m_throttleCount[prefix##_##message] > 0) \
-		{ \
-			this->Log(fmt::format(FMT_STRING("; (throttled {} previous " #prefix "_" #message " messages)"), this->m_throttleCount[prefix##_##message])); \
-			this->m_throttleCount.erase(prefix##_##message); \
-		}
+	if (m_trace.IsOpen() && IsTracedMessage(uMsg))
+	{
+		m_trace.Append(m_pipeline.Capture(uMsg, wParam, lParam, true));
+	}
 
-#define LOG_DERIVED(derived, desc) \
-	if (!this->m_terse) this->Log(fmt::format(FMT_STRING("; - " #derived " = {}  " desc), derived))
+	if (m_measureLatency || m_stressActive)
+	{
+		MeasureLatency(uMsg, wParam, lParam);
+	}
 
-	if (m_callPromoteMouseInPointer)
+	if (m_captureHistory && (uMsg == WM_POINTERDOWN || uMsg == WM_POINTERUPDATE || uMsg == WM_POINTERUP || uMsg == WM_POINTERLEAVE || uMsg == WM_POINTERCAPTURECHANGED))
 	{
-		reinterpret_cast<int(__stdcall*)(int)>(GetProcAddress(GetModuleHandle(TEXT("win32u")), "NtUserPromoteMouseInPointer"))(0);
-		reinterpret_cast<int(__stdcall*)(int, int)>(GetProcAddress(GetModuleHandle(TEXT("win32u")), "NtUserPromotePointer"))(GET_POINTERID_WPARAM(wParam), MAKELONG(0, 0));
-		reinterpret_cast<int(__stdcall*)(int, int)>(GetProcAddress(GetModuleHandle(TEXT("win32u")), "NtUserPromotePointer"))(GET_POINTERID_WPARAM(wParam), MAKELONG(1, 1));
+		CaptureHistory(uMsg, wParam);
 	}
 
-	if (!m_motionEnabled)
+	if (uMsg == WM_POINTERDEVICECHANGE)
 	{
-		switch (uMsg)
-		{
-		case WM_POINTERUPDATE:
-			if (m_returnZeroOnWMPointer)
-			{
-				return 0;
-			}
-			// fallthrough
-		case WM_NCPOINTERUPDATE:
-		case WM_MOUSEMOVE:
-			return DefWindowProc(m_hwnd, uMsg, wParam, lParam);
-		}
+		UpdateDeviceInventory(wParam);
 	}
-	
+
+	const MessageResult handled = m_handler.Handle(uMsg, wParam, lParam);
+	switch (handled.action)
+	{
+	case MessageAction::Return:
+		return handled.result;
+	case MessageAction::Default:
+		return DefWindowProc(m_hwnd, uMsg, wParam, lParam);
+	case MessageAction::Continue:
+		break;
+	}
+
 	switch (uMsg)
 	{
 	case WM_CREATE:
 		{
 			RegisterPointerDeviceNotifications(m_hwnd, TRUE);
+			m_deviceInventory.Refresh();
 			RegisterTouchWindow(m_hwnd, 0);
 			RegisterTouchHitTestingWindow(m_hwnd, TOUCH_HIT_TESTING_CLIENT);
 
 			m_dpi = GetDpiForWindow(m_hwnd);
 
+			LARGE_INTEGER frequency{};
+			QueryPerformanceFrequency(&frequency);
+			m_qpcFrequency = frequency.QuadPart;
+
 			RECT wndRect;
 			GetWindowRect(m_hwnd, &wndRect);
 			MoveWindow(
@@ -125,11 +515,11 @@ LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
 				TRUE
 			);
 			
-			m_hwndEdit = CreateWindowEx(
+			m_hwndLog = CreateWindowEx(
 				0, 
-				TEXT("EDIT"),
+				TEXT("LISTBOX"),
 				nullptr,
-				WS_CHILD | WS_VISIBLE | WS_VSCROLL | ES_LEFT | ES_MULTILINE | ES_READONLY | WS_DISABLED | ES_AUTOVSCROLL,
+				WS_CHILD | WS_VISIBLE | WS_VSCROLL | WS_DISABLED | LBS_NODATA | LBS_OWNERDRAWFIXED | LBS_NOINTEGRALHEIGHT | LBS_NOSEL,
 				0, 
 				0, 
 				0, 
@@ -140,7 +530,8 @@ LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
 				nullptr
 			);
 
-			SendMessage(m_hwndEdit, EM_SETLIMITTEXT, 0, 0);
+			SetTimer(m_hwnd, IDT_LOGFLUSH, LOG_FLUSH_MILLISECONDS, nullptr);
+			LogSyscalls();
 
 			m_hwndTerse = CreateWindowEx(
 				0,
@@ -156,7 +547,7 @@ LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
 				reinterpret_cast<HINSTANCE>(GetWindowLongPtr(m_hwnd, GWLP_HINSTANCE)),
 				nullptr
 			);
-			Button_SetCheck(m_hwndTerse, m_terse);
+			Button_SetCheck(m_hwndTerse, m_pipeline.Terse());
 
 			m_hwndThrottle = CreateWindowEx(
 				0,
@@ -172,7 +563,7 @@ LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
 				reinterpret_cast<HINSTANCE>(GetWindowLongPtr(m_hwnd, GWLP_HINSTANCE)),
 				nullptr
 			);
-			Button_SetCheck(m_hwndThrottle, m_throttle);
+			Button_SetCheck(m_hwndThrottle, m_pipeline.Throttling());
 
 			m_hwndMotionEnabled = CreateWindowEx(
 				0, 
@@ -188,7 +579,7 @@ LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
 				reinterpret_cast<HINSTANCE>(GetWindowLongPtr(m_hwnd, GWLP_HINSTANCE)), 
 				nullptr
 			);
-			Button_SetCheck(m_hwndMotionEnabled, m_motionEnabled);
+			Button_SetCheck(m_hwndMotionEnabled, m_handler.Options().motionEnabled);
 
 			m_hwndRetZeroOnWMPointer = CreateWindowEx(
 				0,
@@ -204,7 +595,7 @@ LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
 				reinterpret_cast<HINSTANCE>(GetWindowLongPtr(m_hwnd, GWLP_HINSTANCE)),
 				nullptr
 			);
-			Button_SetCheck(m_hwndRetZeroOnWMPointer, m_returnZeroOnWMPointer);
+			Button_SetCheck(m_hwndRetZeroOnWMPointer, m_handler.Options().returnZeroOnWMPointer);
 
 			m_hwndCallPromoteMouseInPointer = CreateWindowEx(
 				0,
@@ -220,7 +611,7 @@ LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
 				reinterpret_cast<HINSTANCE>(GetWindowLongPtr(m_hwnd, GWLP_HINSTANCE)),
 				nullptr
 			);
-			Button_SetCheck(m_hwndCallPromoteMouseInPointer, m_callPromoteMouseInPointer);
+			Button_SetCheck(m_hwndCallPromoteMouseInPointer, m_handler.Options().callPromoteMouseInPointer);
 
 			m_hwndInject = CreateWindowEx(
 				0,
@@ -242,22 +633,7 @@ LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
 		return 0;
 
 	case WM_SIZE:
-		{
-			const auto w = LOWORD(lParam), h = HIWORD(lParam);
-			const auto logH = h / 2;
-			
-			MoveWindow(m_hwndEdit, 0, 0, w, logH, TRUE);
-
-			const auto numChecks = 6;
-			const auto checkW = w / numChecks;
-			const auto checkH = MulDiv(40, m_dpi, USER_DEFAULT_SCREEN_DPI);
-			MoveWindow(m_hwndTerse, checkW * 0, logH, checkW, checkH, TRUE);
-			MoveWindow(m_hwndThrottle, checkW * 1, logH, checkW, checkH, TRUE);
-			MoveWindow(m_hwndMotionEnabled, checkW * 2, logH, checkW, checkH, TRUE);
-			MoveWindow(m_hwndRetZeroOnWMPointer, checkW * 3, logH, checkW, checkH, TRUE);
-			MoveWindow(m_hwndCallPromoteMouseInPointer, checkW * 4, logH, w - checkW * (numChecks - 1), checkH, TRUE);
-			MoveWindow(m_hwndInject, checkW * 5, logH, w - checkW * (numChecks - 1), checkH, TRUE);
-	}
+		LayoutChildren(LOWORD(lParam), HIWORD(lParam));
 		return 0;
 
 	case WM_DPICHANGED:
@@ -278,8 +654,70 @@ LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
 			break;
 		}
 
+	case WM_APP_INJECTDONE:
+		{
+			const std::unique_ptr<InjectCompletion> completion{ reinterpret_cast<InjectCompletion*>(lParam) };
+			if (OnStressStepDone(*completion))
+			{
+				return 0;
+			}
+			switch (completion->status)
+			{
+			case InjectStatus::Completed:
+				Log(FMT_STRING("Injection {} finished: {} frames, {} failed, worst lateness {:.3f} ms{}"),
+					completion->id,
+					completion->stats.played,
+					completion->stats.failed,
+					std::chrono::duration<double, std::milli>(completion->stats.maxLateness).count(),
+					completion->reusedDevice ? ", reused device" : ""
+				);
+				break;
+			case InjectStatus::Cancelled:
+				Log(FMT_STRING("Injection {} cancelled after {} frames"), completion->id, completion->stats.played);
+				break;
+			case InjectStatus::DeviceFailed:
+				Log(FMT_STRING("Injection {}: unable to create injection device"), completion->id);
+				break;
+			}
+		}
+		return 0;
+
+	case WM_MEASUREITEM:
+		if (wParam == IDC_TEXTLOG)
+		{
+			reinterpret_cast<MEASUREITEMSTRUCT*>(lParam)->itemHeight = m_logLineHeight;
+			return TRUE;
+		}
+		break;
+
+	case WM_DRAWITEM:
+		if (wParam == IDC_TEXTLOG)
+		{
+			DrawLogLine(*reinterpret_cast<const DRAWITEMSTRUCT*>(lParam));
+			return TRUE;
+		}
+		break;
+
+	case WM_TIMER:
+		if (wParam == IDT_LOGFLUSH)
+		{
+			if (m_captures)
+			{
+				DrainCaptureWindows();
+			}
+			m_pipeline.Tick();
+			return 0;
+		}
+		break;
+
 	case WM_DESTROY:
 		{
+			KillTimer(m_hwnd, IDT_LOGFLUSH);
+			m_trace.Close();
+			m_pipeline.SetEventSink(nullptr);
+			m_export.reset();
+			m_handler.SetCollector(nullptr, 0);
+			m_captures.reset();
 			PostQuitMessage(0);
 		}
 		return 0;
@@ -297,169 +735,64 @@ LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
 		switch (wParam)
 		{
 		case '1':
+			InjectPenStroke();
+			break;
+
+		case 'C':
+			m_pipeline.SetSummarizing(!m_pipeline.Summarizing());
+			Log(m_pipeline.Summarizing() ? "Logging one summary per contact" : "Logging every pointer message");
+			break;
+
+		case 'D':
+			LogDeviceInventory();
+			break;
+
+		case 'E':
+			ToggleExport();
+			break;
+
+		case 'H':
+			m_captureHistory = !m_captureHistory;
+			if (!m_captureHistory)
 			{
-				HSYNTHETICPOINTERDEVICE d = CreateSyntheticPointerDevice(PT_PEN, 1, POINTER_FEEDBACK_DEFAULT);
-				Log(fmt::format(FMT_STRING("Created synthetic pointer {}"), reinterpret_cast<void*>(d)));
-
-				POINTER_TYPE_INFO t{};
-				t.type = PT_PEN;
-				t.penInfo.pointerInfo.pointerType = PT_PEN;
-				t.penInfo.pointerInfo.pointerFlags = POINTER_FLAG_INRANGE | POINTER_FLAG_PRIMARY;
-				t.penInfo.pointerInfo.ptPixelLocation.x = 10;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 10;
-				t.penInfo.penFlags = PEN_FLAG_NONE;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
-
-				t.penInfo.pointerInfo.pointerFlags = POINTER_FLAG_INRANGE | POINTER_FLAG_PRIMARY;
-				t.penInfo.pointerInfo.ptPixelLocation.x = 20;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 20;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
-
-				t.penInfo.pointerInfo.pointerFlags = POINTER_FLAG_INRANGE | POINTER_FLAG_INCONTACT | POINTER_FLAG_FIRSTBUTTON | POINTER_FLAG_PRIMARY;
-				t.penInfo.pointerInfo.ButtonChangeType = POINTER_CHANGE_FIRSTBUTTON_DOWN;
-				t.penInfo.pointerInfo.ptPixelLocation.x = 50;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 50;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0x080;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
-
-				t.penInfo.pointerInfo.ptPixelLocation.x = 55;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 55;
-				t.penInfo.pointerInfo.ButtonChangeType = POINTER_CHANGE_NONE;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0x100;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
-
-				t.penInfo.pointerInfo.ptPixelLocation.x = 58;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 58;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0x180;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
-
-				t.penInfo.pointerInfo.ptPixelLocation.x = 60;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 60;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0x200;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
-
-				t.penInfo.pointerInfo.ptPixelLocation.x = 70;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 70;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0x280;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
-
-				t.penInfo.pointerInfo.ptPixelLocation.x = 80;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 80;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0x300;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
-
-				t.penInfo.pointerInfo.ptPixelLocation.x = 90;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 90;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0x380;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
-
-				t.penInfo.pointerInfo.ptPixelLocation.x = 100;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 100;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0x400;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
-
-				t.penInfo.pointerInfo.ptPixelLocation.x = 110;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 110;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0x380;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
-
-				t.penInfo.pointerInfo.ptPixelLocation.x = 120;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 120;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0x300;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
-
-				t.penInfo.pointerInfo.ptPixelLocation.x = 130;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 130;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0x280;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
-
-				t.penInfo.pointerInfo.ptPixelLocation.x = 140;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 140;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0x200;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
-
-				t.penInfo.pointerInfo.ptPixelLocation.x = 150;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 150;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0x180;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
+				m_pointerHistory.Clear();
+			}
+			Log(m_captureHistory ? "Capturing coalesced pointer history" : "Stopped capturing pointer history");
+			break;
 
-				t.penInfo.pointerInfo.ptPixelLocation.x = 160;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 160;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0x100;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
+		case 'L':
+			ToggleLatency();
+			break;
 
-				t.penInfo.pointerInfo.ptPixelLocation.x = 170;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 170;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0x080;
-				InjectSyntheticPointerInput(d, &t, 1);
-
-				Sleep(100);
+		case 'P':
+			LogDevicePools();
+			break;
 
-				t.penInfo.pointerInfo.pointerFlags = POINTER_FLAG_INRANGE | POINTER_FLAG_PRIMARY;
-				t.penInfo.pointerInfo.ButtonChangeType = POINTER_CHANGE_FIRSTBUTTON_UP;
-				t.penInfo.pointerInfo.ptPixelLocation.x = 180;
-				t.penInfo.pointerInfo.ptPixelLocation.y = 180;
-				t.penInfo.penFlags = PEN_FLAG_NONE;
-				t.penInfo.penMask = PEN_MASK_PRESSURE;
-				t.penInfo.pressure = 0;
-				InjectSyntheticPointerInput(d, &t, 1);
+		case 'R':
+			ToggleTrace();
+			break;
 
-				Sleep(100);
+		case 'S':
+			StartStress();
+			break;
 
-				DestroySyntheticPointerDevice(d);
-				Log(fmt::format(FMT_STRING("Destroyed synthetic pointer {}"), reinterpret_cast<void*>(d)));
-			}
+		case 'T':
+			CycleThrottlePolicy();
+			break;
+
+		case 'W':
+			ToggleCaptureWindows();
+			break;
+
+		case VK_OEM_4:
+		case VK_OEM_6:
+			ScaleThrottleWindow(wParam == VK_OEM_6);
+			break;
+
+		case VK_ESCAPE:
+			m_injector.CancelAll();
+			Log(m_stressSteps.empty() ? "Cancelled pending injections" : "Cancelled pending injections and the stress run");
+			break;
 		}
 		break;
 
@@ -467,24 +800,24 @@ LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
 		switch (wParam)
 		{
 		case IDC_TERSE:
-			m_terse = !m_terse;
-			Button_SetCheck(m_hwndTerse, m_terse);
+			m_pipeline.SetTerse(!m_pipeline.Terse());
+			Button_SetCheck(m_hwndTerse, m_pipeline.Terse());
 			break;
 		case IDC_THROTTLE:
-			m_throttle = !m_throttle;
-			Button_SetCheck(m_hwndThrottle, m_throttle);
+			m_pipeline.SetThrottling(!m_pipeline.Throttling());
+			Button_SetCheck(m_hwndThrottle, m_pipeline.Throttling());
 			break;
 		case IDC_MOTIONENABLE:
-			m_motionEnabled = !m_motionEnabled;
-			Button_SetCheck(m_hwndMotionEnabled, m_motionEnabled);
+			m_handler.Options().motionEnabled = !m_handler.Options().motionEnabled;
+			Button_SetCheck(m_hwndMotionEnabled, m_handler.Options().motionEnabled);
 			break;
 		case IDC_RETZPTR:
-			m_returnZeroOnWMPointer = !m_returnZeroOnWMPointer;
-			Button_SetCheck(m_hwndRetZeroOnWMPointer, m_returnZeroOnWMPointer);
+			m_handler.Options().returnZeroOnWMPointer = !m_handler.Options().returnZeroOnWMPointer;
+			Button_SetCheck(m_hwndRetZeroOnWMPointer, m_handler.Options().returnZeroOnWMPointer);
 			break;
 		case IDC_CALLPROMOTE:
-			m_callPromoteMouseInPointer = !m_callPromoteMouseInPointer;
-			Button_SetCheck(m_hwndCallPromoteMouseInPointer, m_callPromoteMouseInPointer);
+			m_handler.Options().callPromoteMouseInPointer = !m_handler.Options().callPromoteMouseInPointer;
+			Button_SetCheck(m_hwndCallPromoteMouseInPointer, m_handler.Options().callPromoteMouseInPointer);
 			break;
 		case IDC_INJECT:
 			InjectEvents();
@@ -492,299 +825,711 @@ LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
 		}
 		return 0;
 
-	MESSAGE_CASE(DM, POINTERHITTEST)
+	default:
 		break;
+	}
 
-	MESSAGE_CASE(WM, NCPOINTERDOWN)
-		{
-			LOG_DERIVED(GET_POINTERID_WPARAM(wParam), "pointer identifier");
-			LOG_DERIVED(HIWORD(wParam), "hit test value");
-			LOG_DERIVED(GET_X_LPARAM(lParam), "x coordinate");
-			LOG_DERIVED(GET_Y_LPARAM(lParam), "y coordinate");
-		}
-		break;
+	return DefWindowProc(m_hwnd, uMsg, wParam, lParam);
+}
 
-	MESSAGE_CASE(WM, NCPOINTERUP)
-		{
-			LOG_DERIVED(GET_POINTERID_WPARAM(wParam), "pointer identifier");
-			LOG_DERIVED(HIWORD(wParam), "hit test value");
-			LOG_DERIVED(GET_X_LPARAM(lParam), "x coordinate");
-			LOG_DERIVED(GET_Y_LPARAM(lParam), "y coordinate");
-		}
-		break;
+void MainWindow::InjectEvents()
+{
+	const uint64_t id = m_injector.Submit(CompileGesture(g_HoverGesture));
+	if (id == 0)
+	{
+		Log(FMT_STRING("Injection queue full ({} pending), press Esc to cancel"), m_injector.Capacity());
+		return;
+	}
+	Log(FMT_STRING("Queued injection {}"), id);
+}
 
-	MESSAGE_CASE(WM, NCPOINTERUPDATE)
-		{
-			LOG_DERIVED(GET_POINTERID_WPARAM(wParam), "pointer identifier");
-			LOG_DERIVED(HIWORD(wParam), "hit test value");
-			LOG_DERIVED(GET_X_LPARAM(lParam), "x coordinate");
-			LOG_DERIVED(GET_Y_LPARAM(lParam), "y coordinate");
-		}
-		break;
+// The stroke plays on the injection worker, on a device from the synthetic
+// pool, so the window keeps pumping the messages it produces.
+void MainWindow::InjectPenStroke()
+{
+	InjectPlan plan = CompileGesture(g_PenStrokeGesture);
+	DeviceLease lease = m_syntheticDevices.Acquire(PlanDeviceKey(plan));
+	if (!lease)
+	{
+		Log("Unable to create synthetic pointer");
+		return;
+	}
+	const bool reused = lease.Reused();
+	const uint64_t id = m_injector.Submit(std::move(plan), std::move(lease));
+	if (id == 0)
+	{
+		Log(FMT_STRING("Injection queue full ({} pending), press Esc to cancel"), m_injector.Capacity());
+		return;
+	}
+	Log(FMT_STRING("Queued pen stroke {} on {} synthetic pen"), id, reused ? "a reused" : "a new");
+}
 
-	MESSAGE_CASE(WM, POINTERACTIVATE)
+void MainWindow::LogDevicePools()
+{
+	const auto logPool = [this](std::string_view name, const DevicePool& pool)
+	{
+		const DevicePoolStats stats = pool.Stats();
+		Log(FMT_STRING("{} devices: {} created, {} reused, {} idle, {} evicted, {} discarded, {} failed"),
+			name,
+			stats.created,
+			stats.reused,
+			pool.Idle(),
+			stats.evicted,
+			stats.discarded,
+			stats.failed
+		);
+		if (stats.acquire.Count() > 0)
 		{
-			LOG_DERIVED(GET_POINTERID_WPARAM(wParam), "pointer identifier");
-			LOG_DERIVED(HIWORD(wParam), "hit test value");
-			LOG_DERIVED(lParam, "window being activated");
+			Log(FMT_STRING(";   acquire p50 {:.3f} ms, max {:.3f} ms; create mean {:.3f} ms"),
+				static_cast<double>(stats.acquire.Percentile(50)) / 1e6,
+				static_cast<double>(stats.acquire.Max()) / 1e6,
+				static_cast<double>(stats.creation.Mean()) / 1e6
+			);
 		}
-		break;
+	};
+	logPool("Synthetic", m_syntheticDevices);
+	logPool("Injection", m_injectionDevices);
+}
 
-	MESSAGE_CASE(WM, POINTERCAPTURECHANGED)
-		{
-			LOG_DERIVED(GET_POINTERID_WPARAM(wParam), "pointer identifier");
-			LOG_DERIVED(lParam, "window capturing pointer");
-		}
-		break;
+void MainWindow::UpdateDeviceInventory(WPARAM change)
+{
+	const DeviceInventoryChange result = m_deviceInventory.Update(change);
+	if (result.added || result.removed || result.remapped || result.failed)
+	{
+		Log(FMT_STRING("Pointer devices: {} added, {} removed, {} remapped, {} attached{}"),
+			result.added,
+			result.removed,
+			result.remapped,
+			m_deviceInventory.Size(),
+			result.failed ? ", query failed" : ""
+		);
+	}
+}
 
-	MESSAGE_CASE(WM, POINTERDEVICECHANGE)
-		{
-			LOG_DERIVED(PDC_STR(wParam), "pointer identifier");
-		}
-		break;
+void MainWindow::LogDeviceInventory()
+{
+	Log(FMT_STRING("{} pointer devices"), m_deviceInventory.Size());
+	for (const PointerDeviceEntry& entry : m_deviceInventory.Devices())
+	{
+		const RECT& himetric = entry.rects.himetric;
+		const RECT& pixels = entry.rects.pixels;
+		Log(FMT_STRING(";   {} {}: {} contacts, {} properties, himetric ({}, {})-({}, {}) to pixels ({}, {})-({}, {})"),
+			fmt::ptr(entry.description.device),
+			PointerDeviceTypeName(entry.description.type),
+			entry.description.maxActiveContacts,
+			entry.properties.size(),
+			himetric.left,
+			himetric.top,
+			himetric.right,
+			himetric.bottom,
+			pixels.left,
+			pixels.top,
+			pixels.right,
+			pixels.bottom
+		);
+	}
+}
 
-	MESSAGE_CASE(WM, POINTERDEVICEINRANGE)
-		break;
+// Runs on the injection worker thread.
+void MainWindow::OnInjectionDone(const InjectCompletion& completion)
+{
+	auto* posted = new InjectCompletion(completion);
+	if (!PostMessage(m_hwnd, WM_APP_INJECTDONE, 0, reinterpret_cast<LPARAM>(posted)))
+	{
+		delete posted;
+	}
+}
 
-	MESSAGE_CASE(WM, POINTERDEVICEOUTOFRANGE)
-		break;
+// Each rate is its own plan on the injection worker, so the steps share a
+// pooled device and Esc cancels them along with everything else.
+void MainWindow::StartStress()
+{
+	if (m_stressActive.exchange(true))
+	{
+		return;
+	}
 
-	MESSAGE_CASE(WM, POINTERDOWN)
+	RECT client{};
+	GetClientRect(m_hwnd, &client);
+	POINT center{ (client.left + client.right) / 2, (client.top + client.bottom) / 2 };
+	ClientToScreen(m_hwnd, &center);
+
+	StressConfig config{};
+	config.centerX = center.x;
+	config.centerY = center.y;
+	config.radius = MulDiv(100, m_dpi, USER_DEFAULT_SCREEN_DPI);
+	m_latency.Reset();
+	Log(FMT_STRING("Stress run: {} contacts, {} to {} Hz"), config.contacts, config.rates.front(), config.rates.back());
+
+	for (const double rate : config.rates)
+	{
+		InjectPlan plan = CompileStressPlan(config, rate);
+		StressStep step{};
+		step.report.requestedRate = rate;
+		step.report.contacts = plan.maxContacts;
+		step.report.plannedFrames = plan.frames.size();
+		step.id = m_injector.Submit(std::move(plan));
+		if (step.id == 0)
 		{
-			LOG_DERIVED(GET_POINTERID_WPARAM(wParam), "pointer identifier");
-			LOG_DERIVED(PointerState(wParam), "pointer state");
-			LOG_DERIVED(GET_X_LPARAM(lParam), "x coordinate");
-			LOG_DERIVED(GET_Y_LPARAM(lParam), "y coordinate");
+			Log(FMT_STRING("; {} Hz: injection queue full"), rate);
+			continue;
 		}
-		break;
+		m_stressSteps.push_back(step);
+	}
+	if (m_stressSteps.empty())
+	{
+		m_stressActive = false;
+	}
+}
 
-	MESSAGE_CASE(WM, POINTERENTER)
-		break;
+// Returns false when the completion is not for a stress step.
+bool MainWindow::OnStressStepDone(const InjectCompletion& completion)
+{
+	const auto step = std::find_if(m_stressSteps.begin(), m_stressSteps.end(), [&](const StressStep& pending) { return pending.id == completion.id; });
+	if (step == m_stressSteps.end())
+	{
+		return false;
+	}
 
-	MESSAGE_CASE(WM, POINTERLEAVE)
+	switch (completion.status)
+	{
+	case InjectStatus::Completed:
+		step->report.stats = completion.stats;
+		LogStressStep(step->report);
 		break;
-
-	MESSAGE_CASE(WM, POINTERROUTEDAWAY)
+	case InjectStatus::Cancelled:
+		Log(FMT_STRING("; {} Hz x {} contacts: cancelled after {} frames"), step->report.requestedRate, step->report.contacts, completion.stats.played);
 		break;
-
-	MESSAGE_CASE(WM, POINTERROUTEDRELEASED)
+	case InjectStatus::DeviceFailed:
+		Log(FMT_STRING("; {} Hz x {} contacts: unable to create stress injection device"), step->report.requestedRate, step->report.contacts);
 		break;
+	}
+	m_stressSteps.erase(step);
+	if (m_stressSteps.empty())
+	{
+		m_stressActive = false;
+		Log("Stress run finished");
+	}
+	return true;
+}
 
-	MESSAGE_CASE(WM, POINTERROUTEDTO)
-		break;
+void MainWindow::LogStressStep(const StressStepReport& step)
+{
+	Log(FMT_STRING("; {} Hz x {} contacts: injected {}/{} frames at {:.1f} Hz, {} failed, worst lateness {:.3f} ms"),
+		step.requestedRate,
+		step.contacts,
+		step.stats.played,
+		step.plannedFrames,
+		step.stats.AchievedRate(),
+		step.stats.failed,
+		std::chrono::duration<double, std::milli>(step.stats.maxLateness).count()
+	);
+	LogLatency();
+	m_latency.Reset();
+}
 
-	MESSAGE_CASE(WM, POINTERUP)
+// Pointer frames carry their injection time in PerformanceCount. Promoted mouse
+// messages are recognised by the pen/touch signature in their extra info and
+// are attributed to the pending primary pointer frame at their position.
+void MainWindow::MeasureLatency(UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	constexpr LPARAM MI_WP_SIGNATURE = 0xFF515700;
+	constexpr LPARAM SIGNATURE_MASK = 0xFFFFFF00;
+
+	LARGE_INTEGER now{};
+	if (HasPointerIdWParam(uMsg))
+	{
+		POINTER_INFO info{};
+		if (!GetPointerInfo(GET_POINTERID_WPARAM(wParam), &info) || info.PerformanceCount == 0)
 		{
-			LOG_DERIVED(GET_POINTERID_WPARAM(wParam), "pointer identifier");
-			LOG_DERIVED(PointerState(wParam), "pointer state");
-			LOG_DERIVED(GET_X_LPARAM(lParam), "x coordinate");
-			LOG_DERIVED(GET_Y_LPARAM(lParam), "y coordinate");
+			return;
 		}
-		break;
+		QueryPerformanceCounter(&now);
+		POINT client = info.ptPixelLocation;
+		ScreenToClient(m_hwnd, &client);
+		m_latency.OnPointerMessage(
+			uMsg,
+			info.pointerId,
+			info.frameId,
+			(info.pointerFlags & POINTER_FLAG_PRIMARY) != 0,
+			client.x,
+			client.y,
+			TicksToNanoseconds(static_cast<LONGLONG>(info.PerformanceCount), m_qpcFrequency),
+			TicksToNanoseconds(now.QuadPart, m_qpcFrequency)
+		);
+	}
+	else if (uMsg >= WM_MOUSEFIRST && uMsg <= WM_MOUSELAST && (GetMessageExtraInfo() & SIGNATURE_MASK) == MI_WP_SIGNATURE)
+	{
+		QueryPerformanceCounter(&now);
+		m_latency.OnPromotedMouseMessage(uMsg, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam), TicksToNanoseconds(now.QuadPart, m_qpcFrequency));
+	}
+}
 
-	MESSAGE_CASE(WM, POINTERUPDATE)
+void MainWindow::LogSyscalls()
+{
+	const SyscallTable& table = Syscalls();
+	Log(FMT_STRING("Resolved {} of {} win32u entry points"), std::popcount(table.available), static_cast<size_t>(Syscall::Count));
+	for (size_t i = 0; i < static_cast<size_t>(Syscall::Count); i++)
+	{
+		const Syscall syscall = static_cast<Syscall>(i);
+		if (!table.IsAvailable(syscall))
 		{
-			LOG_DERIVED(GET_POINTERID_WPARAM(wParam), "pointer identifier");
-			LOG_DERIVED(PointerState(wParam), "pointer state");
-			LOG_DERIVED(GET_X_LPARAM(lParam), "x coordinate");
-			LOG_DERIVED(GET_Y_LPARAM(lParam), "y coordinate");
+			Log(FMT_STRING(";   {} missing{}"), g_SyscallNames[i], table.IsFallback(syscall) ? ", using user32" : "");
 		}
-		break;
+	}
+}
+
+// Windows coalesces the frames that arrive while the thread is busy into the
+// latest message; their samples are only reachable through the history APIs.
+// History comes newest first and overlaps between messages, which
+// PointerHistory sorts out by frame id.
+void MainWindow::CaptureHistory(UINT uMsg, WPARAM wParam)
+{
+	const UINT32 pointerId = GET_POINTERID_WPARAM(wParam);
+	// Hovering pointers never lift, and a pointer whose capture is taken away
+	// gets no WM_POINTERUP here, so their slots are freed when they go.
+	if (uMsg == WM_POINTERLEAVE || uMsg == WM_POINTERCAPTURECHANGED)
+	{
+		m_pointerHistory.Release(pointerId);
+		return;
+	}
 
-	MESSAGE_CASE(WM, POINTERWHEEL)
+	POINTER_INPUT_TYPE type{};
+	if (!GetPointerType(pointerId, &type))
+	{
+		return;
+	}
+
+	if (type == PT_PEN)
+	{
+		POINTER_PEN_INFO current{};
+		if (!GetPointerPenInfo(pointerId, &current))
 		{
-			LOG_DERIVED(GET_POINTERID_WPARAM(wParam), "pointer identifier");
-			LOG_DERIVED(GET_WHEEL_DELTA_WPARAM(wParam), "wheel delta");
-			LOG_DERIVED(GET_X_LPARAM(lParam), "x coordinate");
-			LOG_DERIVED(GET_Y_LPARAM(lParam), "y coordinate");
+			return;
 		}
-		break;
-
-	MESSAGE_CASE(WM, POINTERHWHEEL)
+		UINT32 entries = std::max<UINT32>(current.pointerInfo.historyCount, 1);
+		m_penHistory.resize(std::max<size_t>(m_penHistory.size(), entries));
+		if (!GetPointerPenInfoHistory(pointerId, &entries, m_penHistory.data()))
 		{
-			LOG_DERIVED(GET_POINTERID_WPARAM(wParam), "pointer identifier");
-			LOG_DERIVED(GET_WHEEL_DELTA_WPARAM(wParam), "wheel delta");
-			LOG_DERIVED(GET_X_LPARAM(lParam), "x coordinate");
-			LOG_DERIVED(GET_Y_LPARAM(lParam), "y coordinate");
+			return;
 		}
-		break;
-
-	MESSAGE_CASE(WM, TOUCHHITTESTING)
-		if (wParam != 0) {
-			const auto* info = reinterpret_cast<TOUCH_HIT_TESTING_INPUT*>(wParam);
-			LOG_DERIVED(info->pointerId, "pointer identifier");
-			LOG_DERIVED(info->point.x, "x coordinate");
-			LOG_DERIVED(info->point.y, "y coordinate");
-			LOG_DERIVED(info->orientation, "orientation");
+		m_samples.resize(std::max<size_t>(m_samples.size(), entries));
+		for (UINT32 i = 0; i < entries; i++)
+		{
+			const POINTER_PEN_INFO& pen = m_penHistory[i];
+			m_samples[i] = {
+				pen.pointerInfo.frameId,
+				pen.pointerInfo.ptPixelLocation.x,
+				pen.pointerInfo.ptPixelLocation.y,
+				pen.pressure,
+				pen.tiltX,
+				pen.tiltY,
+				pen.pointerInfo.PerformanceCount,
+			};
 		}
-		return 0;
+		m_pointerHistory.Append(pointerId, m_samples.data(), entries);
+	}
+	else
+	{
+		// Every pointer in the frame comes back at once; each column of the
+		// entries x pointers matrix is one pointer's history.
+		UINT32 entries = 0;
+		UINT32 pointers = 0;
+		if (!GetPointerFrameInfoHistory(pointerId, &entries, &pointers, nullptr) || entries == 0 || pointers == 0)
+		{
+			return;
+		}
+		m_frameHistory.resize(std::max<size_t>(m_frameHistory.size(), static_cast<size_t>(entries) * pointers));
+		if (!GetPointerFrameInfoHistory(pointerId, &entries, &pointers, m_frameHistory.data()))
+		{
+			return;
+		}
+		m_samples.resize(std::max<size_t>(m_samples.size(), entries));
+		for (UINT32 p = 0; p < pointers; p++)
+		{
+			for (UINT32 i = 0; i < entries; i++)
+			{
+				const POINTER_INFO& info = m_frameHistory[static_cast<size_t>(i) * pointers + p];
+				m_samples[i] = { info.frameId, info.ptPixelLocation.x, info.ptPixelLocation.y, 0, 0, 0, info.PerformanceCount };
+			}
+			m_pointerHistory.Append(m_frameHistory[p].pointerId, m_samples.data(), entries);
+		}
+	}
 
-	MESSAGE_CASE(WM, MOUSEMOVE)
+	if (uMsg == WM_POINTERUP)
+	{
+		if (const PointerHistory::Track* track = m_pointerHistory.Get(pointerId))
 		{
-			LOG_DERIVED(MouseState(wParam), "pointer state");
-			LOG_DERIVED(GET_X_LPARAM(lParam), "x coordinate");
-			LOG_DERIVED(GET_Y_LPARAM(lParam), "y coordinate");
+			const SampleSummary summary = SummarizeSamples(*track);
+			Log(FMT_STRING("; pointer {}: {} samples from {} messages over {:.1f} ms ({:.1f} Hz), pressure {}-{}"),
+				pointerId,
+				summary.samples,
+				summary.messages,
+				static_cast<double>(summary.duration) * 1000.0 / static_cast<double>(m_qpcFrequency),
+				summary.Rate(m_qpcFrequency),
+				summary.minPressure,
+				summary.maxPressure
+			);
 		}
-		return 0;
+		m_pointerHistory.Release(pointerId);
+	}
+}
 
-	MESSAGE_CASE(WM, MOUSEWHEEL)
+void MainWindow::ToggleLatency()
+{
+	m_measureLatency = !m_measureLatency;
+	if (m_measureLatency)
+	{
+		m_latency.Reset();
+		Log("Measuring input latency, press L again to report");
+		return;
+	}
+	Log("Input latency:");
+	LogLatency();
+}
+
+void MainWindow::LogLatency()
+{
+	const auto logHistogram = [this](std::string_view name, const LatencyHistogram& histogram)
+	{
+		Log(FMT_STRING(";   {}: {} samples, p50 {:.3f} ms, p90 {:.3f} ms, p99 {:.3f} ms, p99.9 {:.3f} ms, max {:.3f} ms"),
+			name,
+			histogram.Count(),
+			histogram.Percentile(50) / 1e6,
+			histogram.Percentile(90) / 1e6,
+			histogram.Percentile(99) / 1e6,
+			histogram.Percentile(99.9) / 1e6,
+			histogram.Max() / 1e6
+		);
+	};
+	m_latency.ForEach([&](const MessageInfo& info, const LatencyHistogram& histogram) { logHistogram(info.name, histogram); });
+	if (m_latency.Promotion().Count() > 0)
+	{
+		logHistogram("pointer to mouse promotion", m_latency.Promotion());
+	}
+	if (m_latency.Unmatched() > 0)
+	{
+		Log(FMT_STRING(";   {} promoted mouse messages matched no injected frame"), m_latency.Unmatched());
+	}
+}
+
+// The list box holds no data of its own; it only knows how many lines there
+// are and asks for the visible ones through WM_DRAWITEM.
+void MainWindow::Append(std::string_view batch)
+{
+	m_history.Append(batch);
+
+	RECT client{};
+	GetClientRect(m_hwndLog, &client);
+	const auto count = static_cast<int>(m_history.Size());
+	const int visible = m_logLineHeight > 0 ? (client.bottom - client.top) / m_logLineHeight : 0;
+	SendMessage(m_hwndLog, LB_SETCOUNT, count, 0);
+	SendMessage(m_hwndLog, LB_SETTOPINDEX, count > visible ? count - visible : 0, 0);
+	// Lines shift up once the history is full, so the count alone may not
+	// change even though every visible item did.
+	InvalidateRect(m_hwndLog, nullptr, FALSE);
+}
+
+void MainWindow::DrawLogLine(const DRAWITEMSTRUCT& item) const
+{
+	if (!(item.itemAction & ODA_DRAWENTIRE))
+	{
+		return;
+	}
+
+	// A UTF-8 byte never becomes more than one UTF-16 unit, so a line no
+	// longer than the buffer always fits. A longer one is cut between
+	// characters and ends in "...", like a line cut in the event arena.
+	constexpr std::wstring_view mark = L"...";
+	wchar_t text[512];
+	int length = 0;
+	if (item.itemID < m_history.Size())
+	{
+		std::string_view line = m_history.Line(item.itemID);
+		const bool cut = line.size() > std::size(text);
+		if (cut)
 		{
-			LOG_DERIVED(MouseState(wParam), "pointer state");
-			LOG_DERIVED(static_cast<SHORT> HIWORD(wParam), "wheel delta");
-			LOG_DERIVED(GET_X_LPARAM(lParam), "x coordinate");
-			LOG_DERIVED(GET_Y_LPARAM(lParam), "y coordinate");
+			line = Utf8Prefix(line, std::size(text) - mark.size());
 		}
-		return 0;
+		length = MultiByteToWideChar(CP_UTF8, 0, line.data(), static_cast<int>(line.size()), text, static_cast<int>(std::size(text)));
+		if (cut)
+		{
+			mark.copy(text + length, mark.size());
+			length += static_cast<int>(mark.size());
+		}
+	}
 
-	MESSAGE_CASE(WM, MOUSELEAVE)
-		return 0;
+	const HFONT oldFont = SelectFont(item.hDC, GetWindowFont(m_hwndLog));
+	SetTextColor(item.hDC, GetSysColor(COLOR_WINDOWTEXT));
+	SetBkColor(item.hDC, GetSysColor(COLOR_WINDOW));
+	ExtTextOutW(item.hDC, item.rcItem.left, item.rcItem.top, ETO_OPAQUE | ETO_CLIPPED, &item.rcItem, text, length, nullptr);
+	SelectFont(item.hDC, oldFont);
+}
 
-	MESSAGE_CASE(WM, MOUSEACTIVATE)
-		{
-			LOG_DERIVED(wParam, "top level window");
-			LOG_DERIVED(GET_X_LPARAM(lParam), "x coordinate");
-			LOG_DERIVED(GET_Y_LPARAM(lParam), "y coordinate");
-		}
-		// Do *not* eat the event, so we can see that too.
-		return MA_ACTIVATE;
-
-#define MESSAGE_CASE_BUTTONEVENT(EVENT) \
-	MESSAGE_CASE(WM, EVENT) \
-		{ \
-			LOG_DERIVED(MouseState(wParam), "pointer state"); \
-			LOG_DERIVED(HIWORD(wParam), "x button"); \
-			LOG_DERIVED(GET_X_LPARAM(lParam), "x coordinate"); \
-			LOG_DERIVED(GET_Y_LPARAM(lParam), "y coordinate"); \
-		} \
-		return 0
-
-#define MESSAGE_CASE_BUTTONEVENTS(btn) \
-	MESSAGE_CASE_BUTTONEVENT(btn##BUTTONDBLCLK); \
-	MESSAGE_CASE_BUTTONEVENT(btn##BUTTONDOWN); \
-	MESSAGE_CASE_BUTTONEVENT(btn##BUTTONUP) \
-
-	MESSAGE_CASE_BUTTONEVENTS(R);
-	MESSAGE_CASE_BUTTONEVENTS(L);
-	MESSAGE_CASE_BUTTONEVENTS(M);
-	MESSAGE_CASE_BUTTONEVENTS(X);
-		
-	default:
-		break;
+void MainWindow::ToggleTrace()
+{
+	if (m_trace.IsOpen())
+	{
+		const auto count = m_trace.Count();
+		m_trace.Close();
+		Log(FMT_STRING("Stopped recording trace ({} records)"), count);
+		return;
 	}
 
-#undef LOG_DERIVED
-#undef MESSAGE_CASE
-
-	if (m_returnZeroOnWMPointer)
-	{
-		switch (uMsg)
-		{
-		case WM_POINTERACTIVATE:
-		case WM_POINTERCAPTURECHANGED:
-		case WM_POINTERDEVICECHANGE:
-		case WM_POINTERDEVICEINRANGE:
-		case WM_POINTERDEVICEOUTOFRANGE:
-		case WM_POINTERDOWN:
-		case WM_POINTERENTER:
-		case WM_POINTERLEAVE:
-		case WM_POINTERROUTEDAWAY:
-		case WM_POINTERROUTEDRELEASED:
-		case WM_POINTERROUTEDTO:
-		case WM_POINTERUP:
-		case WM_POINTERUPDATE:
-		case WM_POINTERWHEEL:
-		case WM_POINTERHWHEEL:
-			return 0;
-		default:
-			break;
+	LARGE_INTEGER frequency{};
+	QueryPerformanceFrequency(&frequency);
+	SYSTEMTIME time{};
+	GetLocalTime(&time);
+	const auto path = fmt::format(
+		FMT_STRING("WmPointerDemo-{:04}{:02}{:02}-{:02}{:02}{:02}.wmpt"),
+		time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond
+	);
+	if (m_trace.Open(path, frequency.QuadPart))
+	{
+		Log(FMT_STRING("Recording trace to {}"), path);
+	}
+	else
+	{
+		Log(FMT_STRING("Unable to open trace file {}"), path);
+	}
+}
+
+void MainWindow::ToggleExport()
+{
+	if (m_export)
+	{
+		m_pipeline.Flush();
+		m_pipeline.SetEventSink(nullptr);
+		m_export->Sync();
+		const EventFileStats stats = m_export->Stats();
+		m_export.reset();
+		Log(FMT_STRING("Stopped exporting events ({} events in {} blocks, {} files, {:.1f}x compression)"), stats.events, stats.blocks, stats.files, stats.CompressionRatio());
+		if (stats.droppedEvents)
+		{
+			Log(FMT_STRING(";   {} events dropped, queue peaked at {} blocks, p99 wait {:.1f} ms"), stats.droppedEvents, stats.peakQueued, static_cast<double>(stats.queueWait.Percentile(99)) / 1e6);
 		}
+		return;
 	}
 
-	return DefWindowProc(m_hwnd, uMsg, wParam, lParam);
+	SYSTEMTIME time{};
+	GetLocalTime(&time);
+	EventFileConfig config{};
+	const std::string started = fmt::format(
+		FMT_STRING("WmPointerDemo-{:04}{:02}{:02}-{:02}{:02}{:02}"),
+		time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond
+	);
+	// Exports started within the same second get a counter rather than
+	// overwriting each other.
+	config.baseName = started;
+	for (int run = 2; !EventFiles(config.directory, config.baseName).empty(); run++)
+	{
+		config.baseName = fmt::format(FMT_STRING("{}-{}"), started, run);
+	}
+	config.timestampFrequency = m_qpcFrequency;
+	Log(FMT_STRING("Exporting events to {}-*.wmpe ({})"), config.baseName, BlockCodecName(config.codec));
+	m_export = std::make_unique<EventFileWriter>(std::move(config));
+	m_pipeline.SetEventSink(m_export.get());
 }
 
-typedef void (__stdcall * NtUserInitializePointerDeviceInjectionFn)(
-	POINTER_INPUT_TYPE       pointerType,
-	ULONG                    maxCount,
-	ULONG                    unknown,
-	POINTER_FEEDBACK_MODE    mode,
-	HSYNTHETICPOINTERDEVICE* out
-);
-
-typedef void(__stdcall* NtUserInjectPointerInputFn)(
-	HSYNTHETICPOINTERDEVICE  device,
-	const POINTER_TYPE_INFO* pointerInfo,
-	UINT32                   count
-);
-
-typedef void(__stdcall* NtUserRemoveInjectionDeviceFn)(
-	HSYNTHETICPOINTERDEVICE device
-);
-
-void MainWindow::InjectEvents() const
-{
-	std::thread t{ [&]() {
-		HSYNTHETICPOINTERDEVICE device{};
-		auto NtUserInitializePointerDeviceInjection = reinterpret_cast<NtUserInitializePointerDeviceInjectionFn>(GetProcAddress(GetModuleHandle(TEXT("win32u")), "NtUserInitializePointerDeviceInjection"));
-		auto NtUserInjectPointerInput = reinterpret_cast<NtUserInjectPointerInputFn>(GetProcAddress(GetModuleHandle(TEXT("win32u")), "NtUserInjectPointerInput"));
-		auto NtUserRemoveInjectionDevice = reinterpret_cast<NtUserRemoveInjectionDeviceFn>(GetProcAddress(GetModuleHandle(TEXT("win32u")), "NtUserRemoveInjectionDevice"));
-
-		NtUserInitializePointerDeviceInjection(PT_PEN, 1, 0, POINTER_FEEDBACK_DEFAULT, &device);
-		for (int i = 0; i < 50; i++) {
-			POINTER_TYPE_INFO inputInfo[1];
-			inputInfo[0].type = PT_PEN;
-			inputInfo[0].penInfo.pointerInfo.pointerType = PT_PEN;
-			inputInfo[0].penInfo.pointerInfo.pointerId = 0;
-			inputInfo[0].penInfo.pointerInfo.frameId = 0;
-			inputInfo[0].penInfo.pointerInfo.pointerFlags = POINTER_FLAG_INRANGE;
-			inputInfo[0].penInfo.penMask = PEN_MASK_PRESSURE | PEN_MASK_TILT_X | PEN_MASK_TILT_Y;
-			inputInfo[0].penInfo.pointerInfo.ptPixelLocation.x = 100 + i * 5;
-			inputInfo[0].penInfo.pointerInfo.ptPixelLocation.y = 100 + i * 5;
-			inputInfo[0].penInfo.pressure = 0;
-			inputInfo[0].penInfo.tiltX = 15;
-			inputInfo[0].penInfo.tiltY = -26;
-			inputInfo[0].penInfo.pointerInfo.dwTime = 0;
-			inputInfo[0].penInfo.pointerInfo.PerformanceCount = 0;
-			NtUserInjectPointerInput(device, inputInfo, 1);
-			Sleep(10);
-		}
-		NtUserRemoveInjectionDevice(device);
-
-		MessageBox(m_hwnd, TEXT("Done"), TEXT("Inject"), MB_OK | MB_ICONINFORMATION);
-	} };
-	t.detach();
+void MainWindow::ToggleCaptureWindows()
+{
+	if (m_captures)
+	{
+		m_captures->Stop();
+		m_handler.SetCollector(nullptr, 0);
+		DrainCaptureWindows();
+		Log(FMT_STRING("Closed {} capture windows ({} messages dropped)"), m_captures->Count(), m_captures->Dropped());
+		m_captures.reset();
+		return;
+	}
+
+	m_captures = std::make_unique<CaptureThreads>(*this);
+	m_handler.SetCollector(&m_captures->Collector(), CaptureThreads::MAIN_SOURCE);
+	m_captureSource = UINT32_MAX;
+	Log(FMT_STRING("Opened {} capture windows, each on its own thread"), m_captures->Count());
 }
 
-void MainWindow::Log(std::string_view Line) const
+// Messages from the main window and all capture windows are logged in the
+// order they were stamped, with a line naming the window whenever it changes.
+void MainWindow::DrainCaptureWindows()
 {
-	SendMessage(m_hwndEdit, EM_REPLACESEL, TRUE, reinterpret_cast<LPARAM>(ToWinString(Line).c_str()));
-	SendMessage(m_hwndEdit, EM_REPLACESEL, TRUE, reinterpret_cast<LPARAM>(TEXT("\r\n")));
+	m_captures->Drain([this](const CollectedEvent& event)
+	{
+		if (event.source != m_captureSource)
+		{
+			m_captureSource = event.source;
+			if (event.source == CaptureThreads::MAIN_SOURCE)
+			{
+				Log("Main window");
+			}
+			else
+			{
+				Log(FMT_STRING("Capture window {}"), event.source);
+			}
+		}
+		m_pipeline.Process(event.record);
+	});
+}
+
+int64_t MainWindow::Timestamp()
+{
+	LARGE_INTEGER now{};
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+std::unique_ptr<InjectionBackend> MainWindow::CreateInjectionBackend()
+{
+	return std::make_unique<NtUserInjectionBackend>();
 }
 
-bool MainWindow::Throttle(UINT uMsg)
+void MainWindow::CaptureDetails(TraceRecord& record, bool detailed)
 {
-	const auto currentTicks = GetTickCount64();
-	if (currentTicks - m_msgTickMap[uMsg] < g_ThrottleMilliseconds)
+	const UINT uMsg = record.message;
+	const WPARAM wParam = static_cast<WPARAM>(record.wParam);
+	if (uMsg == WM_TOUCHHITTESTING && wParam != 0)
 	{
-		this->m_throttleCount[uMsg]++;
-		return true;
+		const auto* info = reinterpret_cast<const TOUCH_HIT_TESTING_INPUT*>(wParam);
+		record.flags |= TRACE_HAS_HITTEST;
+		record.hitTest.pointerId = info->pointerId;
+		record.hitTest.x = info->point.x;
+		record.hitTest.y = info->point.y;
+		record.hitTest.orientation = info->orientation;
+	}
+	else if (detailed && HasPointerIdWParam(uMsg))
+	{
+		const UINT32 pointerId = GET_POINTERID_WPARAM(wParam);
+		POINTER_INPUT_TYPE type{};
+		POINTER_PEN_INFO penInfo{};
+		POINTER_INFO info{};
+		if (GetPointerType(pointerId, &type) && type == PT_PEN && GetPointerPenInfo(pointerId, &penInfo))
+		{
+			info = penInfo.pointerInfo;
+			record.flags |= TRACE_HAS_PEN;
+			record.pen.penFlags = penInfo.penFlags;
+			record.pen.penMask = penInfo.penMask;
+			record.pen.pressure = penInfo.pressure;
+			record.pen.rotation = penInfo.rotation;
+			record.pen.tiltX = penInfo.tiltX;
+			record.pen.tiltY = penInfo.tiltY;
+		}
+		else if (!GetPointerInfo(pointerId, &info))
+		{
+			return;
+		}
+		record.flags |= TRACE_HAS_POINTER;
+		record.pointer.pointerType = info.pointerType;
+		record.pointer.pointerId = info.pointerId;
+		record.pointer.frameId = info.frameId;
+		record.pointer.pointerFlags = info.pointerFlags;
+		record.pointer.pixelX = info.ptPixelLocation.x;
+		record.pointer.pixelY = info.ptPixelLocation.y;
+		record.pointer.himetricX = info.ptHimetricLocation.x;
+		record.pointer.himetricY = info.ptHimetricLocation.y;
+		record.pointer.time = info.dwTime;
+		record.pointer.buttonChangeType = info.ButtonChangeType;
+		record.pointer.performanceCount = info.PerformanceCount;
 	}
-	m_msgTickMap[uMsg] = currentTicks;
-	return false;
 }
 
+void MainWindow::CycleThrottlePolicy()
+{
+	Throttler& throttler = m_pipeline.GetThrottler();
+	ThrottleConfig config = throttler.Config();
+	config.policy = static_cast<ThrottlePolicy>((static_cast<int>(config.policy) + 1) % static_cast<int>(ThrottlePolicy::Count));
+	throttler.Configure(config);
+	LogThrottlePolicy();
+}
+
+// '[' halves and ']' doubles the throttle window.
+void MainWindow::ScaleThrottleWindow(bool longer)
+{
+	Throttler& throttler = m_pipeline.GetThrottler();
+	ThrottleConfig config = throttler.Config();
+	config.window = longer ? config.window * 2 : std::max<std::chrono::nanoseconds>(config.window / 2, std::chrono::milliseconds(1));
+	throttler.Configure(config);
+	LogThrottlePolicy();
+}
+
+void MainWindow::LogThrottlePolicy()
+{
+	const Throttler& throttler = m_pipeline.GetThrottler();
+	const ThrottleConfig config = throttler.Config();
+	const double window = static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(config.window).count()) / 1000.0;
+	if (config.policy == ThrottlePolicy::Adaptive)
+	{
+		Log(FMT_STRING("Throttle policy: {}, {:.0f} samples/s per message, bursts end after {:.1f} ms"), ThrottlePolicyName(config.policy), throttler.SampleRate(), window);
+		return;
+	}
+	Log(FMT_STRING("Throttle policy: {}, {:.1f} ms window"), ThrottlePolicyName(config.policy), window);
+}
+
+DpiResources MainWindow::CreateDpiResources(uint32_t dpi) const
+{
+	const int fontSize = ScaleForDpi(18, dpi);
+
+	DpiResources resources{};
+	resources.logFont.reset(CreateFont(fontSize, 0, 0, 0, FW_DONTCARE, FALSE, FALSE, FALSE, DEFAULT_CHARSET, OUT_OUTLINE_PRECIS, CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY, VARIABLE_PITCH, TEXT("Consolas")));
+	resources.uiFont.reset(CreateFont(fontSize, 0, 0, 0, FW_DONTCARE, FALSE, FALSE, FALSE, DEFAULT_CHARSET, OUT_OUTLINE_PRECIS, CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY, VARIABLE_PITCH, TEXT("Calibri")));
+
+	TEXTMETRIC metrics{};
+	const HDC dc = GetDC(m_hwndLog);
+	const HFONT oldFont = SelectFont(dc, resources.logFont.get());
+	GetTextMetrics(dc, &metrics);
+	SelectFont(dc, oldFont);
+	ReleaseDC(m_hwndLog, dc);
+	resources.logLineHeight = metrics.tmHeight;
+	return resources;
+}
+
+// Fonts come from the per-DPI cache, so moving back and forth between monitors
+// reuses them instead of creating new ones every time. The controls are
+// repainted once at the end rather than on every WM_SETFONT.
 void MainWindow::UpdateDPIDependentResources()
 {
-	const int fontSize = MulDiv(18, m_dpi, USER_DEFAULT_SCREEN_DPI);
+	const uint32_t dpi = static_cast<uint32_t>(m_dpi);
+	if (dpi == m_appliedDpi)
+	{
+		return;
+	}
+	const DpiResources& resources = m_dpiResources.Get(dpi);
+	m_appliedDpi = dpi;
+
+	SetWindowFont(m_hwndLog, resources.logFont.get(), FALSE);
+	m_logLineHeight = resources.logLineHeight;
+	ListBox_SetItemHeight(m_hwndLog, 0, m_logLineHeight);
 
-	HFONT hFontConsolas = CreateFont(fontSize, 0, 0, 0, FW_DONTCARE, FALSE, FALSE, FALSE, DEFAULT_CHARSET, OUT_OUTLINE_PRECIS, CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY, VARIABLE_PITCH, TEXT("Consolas"));
-	SendMessage(m_hwndEdit, WM_SETFONT, reinterpret_cast<WPARAM>(hFontConsolas), MAKELPARAM(TRUE, 0));
+	for (const HWND button : { m_hwndTerse, m_hwndThrottle, m_hwndMotionEnabled, m_hwndRetZeroOnWMPointer, m_hwndCallPromoteMouseInPointer, m_hwndInject })
+	{
+		SetWindowFont(button, resources.uiFont.get(), FALSE);
+	}
+	RedrawWindow(m_hwnd, nullptr, nullptr, RDW_INVALIDATE | RDW_ERASE | RDW_ALLCHILDREN);
+}
 
-	HFONT hFontCalibri = CreateFont(fontSize, 0, 0, 0, FW_DONTCARE, FALSE, FALSE, FALSE, DEFAULT_CHARSET, OUT_OUTLINE_PRECIS, CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY, VARIABLE_PITCH, TEXT("Calibri"));
-	SendMessage(m_hwndTerse, WM_SETFONT, reinterpret_cast<WPARAM>(hFontCalibri), MAKELPARAM(TRUE, 0));
-	SendMessage(m_hwndThrottle, WM_SETFONT, reinterpret_cast<WPARAM>(hFontCalibri), MAKELPARAM(TRUE, 0));
-	SendMessage(m_hwndMotionEnabled, WM_SETFONT, reinterpret_cast<WPARAM>(hFontCalibri), MAKELPARAM(TRUE, 0));
-	SendMessage(m_hwndRetZeroOnWMPointer, WM_SETFONT, reinterpret_cast<WPARAM>(hFontCalibri), MAKELPARAM(TRUE, 0));
-	SendMessage(m_hwndCallPromoteMouseInPointer, WM_SETFONT, reinterpret_cast<WPARAM>(hFontCalibri), MAKELPARAM(TRUE, 0));
-	SendMessage(m_hwndInject, WM_SETFONT, reinterpret_cast<WPARAM>(hFontCalibri), MAKELPARAM(TRUE, 0));
+// Moves every child in one DeferWindowPos batch, so they are repositioned and
+// repainted together.
+void MainWindow::LayoutChildren(int width, int height)
+{
+	const HWND buttons[] = { m_hwndTerse, m_hwndThrottle, m_hwndMotionEnabled, m_hwndRetZeroOnWMPointer, m_hwndCallPromoteMouseInPointer, m_hwndInject };
+	LayoutRect log{};
+	LayoutRect buttonRects[std::size(buttons)]{};
+	LayoutMainWindow(width, height, static_cast<uint32_t>(m_dpi), log, buttonRects);
+
+	HDWP defer = BeginDeferWindowPos(static_cast<int>(std::size(buttons) + 1));
+	const auto move = [&defer](HWND hwnd, const LayoutRect& rect)
+	{
+		if (defer)
+		{
+			defer = DeferWindowPos(defer, hwnd, nullptr, rect.x, rect.y, rect.width, rect.height, SWP_NOZORDER | SWP_NOACTIVATE);
+		}
+	};
+	move(m_hwndLog, log);
+	for (size_t i = 0; i < std::size(buttons); i++)
+	{
+		move(buttons[i], buttonRects[i]);
+	}
+	if (defer)
+	{
+		EndDeferWindowPos(defer);
+	}
 }
@@ -0,0 +1,297 @@
+#pragma once
+
+#include "CoordinateTransform.h"
+#include "WinCompat.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// POINTER_DEVICE_TYPE, which only Windows defines.
+enum class PointerDeviceType : uint32_t
+{
+	IntegratedPen = 1,
+	ExternalPen = 2,
+	Touch = 3,
+	TouchPad = 4,
+};
+
+constexpr std::string_view PointerDeviceTypeName(PointerDeviceType type)
+{
+	switch (type)
+	{
+	case PointerDeviceType::IntegratedPen: return "integrated pen";
+	case PointerDeviceType::ExternalPen: return "external pen";
+	case PointerDeviceType::Touch: return "touch";
+	case PointerDeviceType::TouchPad: return "touchpad";
+	}
+	return "unknown";
+}
+
+// The parts of POINTER_DEVICE_INFO that GetPointerDevices reports for every
+// device.
+struct PointerDeviceDescription
+{
+	HANDLE device = nullptr;
+	PointerDeviceType type = PointerDeviceType::Touch;
+	uint32_t maxActiveContacts = 0;
+	uint32_t startingCursorId = 0;
+	uint32_t displayOrientation = 0;
+};
+
+// POINTER_DEVICE_PROPERTY: the range and unit of one HID usage the device
+// reports, such as pressure or tilt.
+struct PointerDeviceProperty
+{
+	int32_t logicalMin = 0;
+	int32_t logicalMax = 0;
+	int32_t physicalMin = 0;
+	int32_t physicalMax = 0;
+	uint32_t unit = 0;
+	uint32_t unitExponent = 0;
+	uint16_t usagePageId = 0;
+	uint16_t usageId = 0;
+};
+
+// What GetPointerDeviceRects reports: the device's extent in himetric units
+// and the part of the screen it maps to, in pixels.
+struct PointerDeviceRects
+{
+	RECT himetric{};
+	RECT pixels{};
+};
+
+struct PointerDeviceEntry
+{
+	PointerDeviceDescription description{};
+	PointerDeviceRects rects{};
+	// Himetric to pixels.
+	CoordinateTransform transform{};
+	std::vector<PointerDeviceProperty> properties;
+};
+
+// Where the inventory gets its devices from: the user32 pointer device API on
+// Windows and ScriptedDeviceSource elsewhere.
+class PointerDeviceSource
+{
+public:
+	virtual ~PointerDeviceSource() = default;
+	// GetPointerDevices.
+	virtual bool Devices(std::vector<PointerDeviceDescription>& devices) = 0;
+	// GetPointerDeviceRects.
+	virtual bool Rects(HANDLE device, PointerDeviceRects& rects) = 0;
+	// GetPointerDeviceProperties.
+	virtual bool Properties(HANDLE device, std::vector<PointerDeviceProperty>& properties) = 0;
+};
+
+// Devices that are attached, detached and remapped on command, counting every
+// query made of them.
+class ScriptedDeviceSource final : public PointerDeviceSource
+{
+public:
+	void Attach(const PointerDeviceDescription& description, const PointerDeviceRects& rects, std::vector<PointerDeviceProperty> properties = {})
+	{
+		Detach(description.device);
+		m_devices.push_back({ description, rects, HimetricToPixels(rects.himetric, rects.pixels), std::move(properties) });
+	}
+
+	void Detach(HANDLE device)
+	{
+		std::erase_if(m_devices, [device](const PointerDeviceEntry& entry) { return entry.description.device == device; });
+	}
+
+	void Remap(HANDLE device, const PointerDeviceRects& rects)
+	{
+		for (PointerDeviceEntry& entry : m_devices)
+		{
+			if (entry.description.device == device)
+			{
+				entry.rects = rects;
+			}
+		}
+	}
+
+	// Makes every query fail until cleared, like a call made while the
+	// device stack is being torn down.
+	void SetFailing(bool failing) { m_failing = failing; }
+
+	bool Devices(std::vector<PointerDeviceDescription>& devices) override
+	{
+		m_enumerations++;
+		devices.clear();
+		for (const PointerDeviceEntry& entry : m_devices)
+		{
+			devices.push_back(entry.description);
+		}
+		return !m_failing;
+	}
+
+	bool Rects(HANDLE device, PointerDeviceRects& rects) override
+	{
+		m_rectQueries++;
+		const PointerDeviceEntry* entry = Find(device);
+		if (m_failing || !entry)
+		{
+			return false;
+		}
+		rects = entry->rects;
+		return true;
+	}
+
+	bool Properties(HANDLE device, std::vector<PointerDeviceProperty>& properties) override
+	{
+		m_propertyQueries++;
+		const PointerDeviceEntry* entry = Find(device);
+		if (m_failing || !entry)
+		{
+			return false;
+		}
+		properties = entry->properties;
+		return true;
+	}
+
+	uint64_t Enumerations() const { return m_enumerations; }
+	uint64_t RectQueries() const { return m_rectQueries; }
+	uint64_t PropertyQueries() const { return m_propertyQueries; }
+
+private:
+	const PointerDeviceEntry* Find(HANDLE device) const
+	{
+		const auto entry = std::find_if(m_devices.begin(), m_devices.end(), [device](const PointerDeviceEntry& e) { return e.description.device == device; });
+		return entry == m_devices.end() ? nullptr : &*entry;
+	}
+
+	std::vector<PointerDeviceEntry> m_devices;
+	bool m_failing = false;
+	uint64_t m_enumerations = 0;
+	uint64_t m_rectQueries = 0;
+	uint64_t m_propertyQueries = 0;
+};
+
+struct DeviceInventoryChange
+{
+	uint32_t added = 0;
+	uint32_t removed = 0;
+	uint32_t remapped = 0;
+	// A query failed; whatever it was for is retried on the next update.
+	bool failed = false;
+};
+
+// The PDC_* notifications after which device rectangles may have moved.
+constexpr WPARAM DEVICE_REMAP_CHANGES = PDC_ORIENTATION_0 | PDC_ORIENTATION_90 | PDC_ORIENTATION_180 | PDC_ORIENTATION_270
+	| PDC_MODE_DEFAULT | PDC_MODE_CENTERED | PDC_MAPPING_CHANGE | PDC_RESOLUTION | PDC_ORIGIN | PDC_MODE_ASPECTRATIOPRESERVED;
+
+// Pointer devices with their rectangles, properties and himetric-to-pixel
+// transform, looked up by the sourceDevice handle of POINTER_INFO in constant
+// time. Filled once with Refresh and then kept up to date by handing Update
+// the wParam of every WM_POINTERDEVICECHANGE. The notification does not say
+// which device changed, so Update lists the devices again, which is one call,
+// and only queries the rectangles and properties of devices it has not seen;
+// after a mapping change it queries the rectangles of all of them, but never
+// the properties again. Entries returned by Find are valid until the next
+// Refresh or Update.
+class DeviceInventory
+{
+public:
+	explicit DeviceInventory(std::unique_ptr<PointerDeviceSource> source) : m_source(std::move(source)) {}
+
+	DeviceInventoryChange Refresh()
+	{
+		m_entries.clear();
+		m_index.clear();
+		m_remapPending = false;
+		return Update(0);
+	}
+
+	DeviceInventoryChange Update(WPARAM change)
+	{
+		DeviceInventoryChange result{};
+		if ((change & DEVICE_REMAP_CHANGES) != 0)
+		{
+			m_remapPending = true;
+		}
+		if (!m_source->Devices(m_listed))
+		{
+			result.failed = true;
+			return result;
+		}
+
+		// Devices that are no longer listed go first; the last entry takes
+		// the place of each removed one.
+		for (size_t i = m_entries.size(); i-- > 0;)
+		{
+			const HANDLE device = m_entries[i].description.device;
+			if (std::none_of(m_listed.begin(), m_listed.end(), [device](const PointerDeviceDescription& listed) { return listed.device == device; }))
+			{
+				m_index.erase(device);
+				if (i + 1 != m_entries.size())
+				{
+					m_entries[i] = std::move(m_entries.back());
+					m_index[m_entries[i].description.device] = i;
+				}
+				m_entries.pop_back();
+				result.removed++;
+			}
+		}
+
+		const bool remap = m_remapPending;
+		m_remapPending = false;
+		for (const PointerDeviceDescription& listed : m_listed)
+		{
+			const auto found = m_index.find(listed.device);
+			if (found == m_index.end())
+			{
+				PointerDeviceEntry entry{};
+				entry.description = listed;
+				if (!m_source->Rects(listed.device, entry.rects) || !m_source->Properties(listed.device, entry.properties))
+				{
+					result.failed = true;
+					continue;
+				}
+				entry.transform = HimetricToPixels(entry.rects.himetric, entry.rects.pixels);
+				m_index.emplace(listed.device, m_entries.size());
+				m_entries.push_back(std::move(entry));
+				result.added++;
+				continue;
+			}
+
+			PointerDeviceEntry& entry = m_entries[found->second];
+			entry.description = listed;
+			if (remap)
+			{
+				PointerDeviceRects rects{};
+				if (!m_source->Rects(listed.device, rects))
+				{
+					result.failed = true;
+					m_remapPending = true;
+					continue;
+				}
+				entry.rects = rects;
+				entry.transform = HimetricToPixels(rects.himetric, rects.pixels);
+				result.remapped++;
+			}
+		}
+		return result;
+	}
+
+	const PointerDeviceEntry* Find(HANDLE device) const
+	{
+		const auto found = m_index.find(device);
+		return found == m_index.end() ? nullptr : &m_entries[found->second];
+	}
+
+	size_t Size() const { return m_entries.size(); }
+	const std::vector<PointerDeviceEntry>& Devices() const { return m_entries; }
+
+private:
+	std::unique_ptr<PointerDeviceSource> m_source;
+	std::vector<PointerDeviceEntry> m_entries;
+	std::unordered_map<HANDLE, size_t> m_index;
+	// Reused by every update.
+	std::vector<PointerDeviceDescription> m_listed;
+	bool m_remapPending = false;
+};
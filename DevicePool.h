@@ -0,0 +1,284 @@
+#pragma once
+
+#include "Gesture.h"
+#include "Injection.h"
+#include "Latency.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// What a synthetic device is created with; devices are only shared between
+// uses that agree on all of it.
+struct DeviceKey
+{
+	POINTER_INPUT_TYPE pointerType = PT_PEN;
+	uint32_t maxContacts = 1;
+	POINTER_FEEDBACK_MODE feedback = POINTER_FEEDBACK_DEFAULT;
+
+	bool operator==(const DeviceKey&) const = default;
+};
+
+inline DeviceKey PlanDeviceKey(const InjectPlan& plan)
+{
+	return { plan.pointerType, plan.maxContacts, plan.feedback };
+}
+
+// An open backend plus the contacts it last injected, so that it can be handed
+// back in a neutral state. A contact left out of a frame is taken to be gone,
+// which holds for plans that carry every active contact in every frame.
+class PooledDevice final : public InjectionBackend
+{
+public:
+	PooledDevice(const DeviceKey& key, std::unique_ptr<InjectionBackend> backend) : m_key(key), m_backend(std::move(backend)) {}
+	~PooledDevice() { Close(); }
+
+	bool Open(POINTER_INPUT_TYPE pointerType, uint32_t maxContacts, POINTER_FEEDBACK_MODE feedback) override
+	{
+		m_last.clear();
+		return m_backend->Open(pointerType, maxContacts, feedback);
+	}
+
+	bool Inject(const InjectContact* contacts, uint32_t count) override
+	{
+		if (!m_backend->Inject(contacts, count))
+		{
+			return false;
+		}
+		m_last.assign(contacts, contacts + count);
+		return true;
+	}
+
+	void Close() override
+	{
+		m_last.clear();
+		m_backend->Close();
+	}
+
+	// Lifts every contact still down and takes pens out of range. Touch
+	// contacts go away with the lift.
+	bool Reset()
+	{
+		std::vector<InjectContact> lift;
+		std::vector<InjectContact> leave;
+		for (const InjectContact& contact : m_last)
+		{
+			if (!(contact.pointerFlags & POINTER_FLAG_INRANGE))
+			{
+				continue;
+			}
+			const bool primary = (contact.pointerFlags & POINTER_FLAG_PRIMARY) != 0;
+			InjectContact released = contact;
+			if (contact.pointerFlags & POINTER_FLAG_INCONTACT)
+			{
+				SetContactState(released, m_key.pointerType, primary, false, true);
+				if (m_key.pointerType == PT_TOUCH)
+				{
+					released.pointerFlags &= ~POINTER_FLAG_INRANGE;
+				}
+				lift.push_back(released);
+			}
+			if (m_key.pointerType != PT_TOUCH)
+			{
+				released.pointerFlags = POINTER_FLAG_UPDATE | (primary ? POINTER_FLAG_PRIMARY : 0);
+				released.buttonChangeType = POINTER_CHANGE_NONE;
+				leave.push_back(released);
+			}
+		}
+		m_last.clear();
+		const bool lifted = lift.empty() || m_backend->Inject(lift.data(), static_cast<uint32_t>(lift.size()));
+		const bool left = leave.empty() || m_backend->Inject(leave.data(), static_cast<uint32_t>(leave.size()));
+		return lifted && left;
+	}
+
+	const DeviceKey& Key() const { return m_key; }
+
+private:
+	DeviceKey m_key;
+	std::unique_ptr<InjectionBackend> m_backend;
+	std::vector<InjectContact> m_last;
+};
+
+struct DevicePoolStats
+{
+	uint64_t created = 0;
+	uint64_t reused = 0;
+	// Backends that could not be created or opened.
+	uint64_t failed = 0;
+	// Idle devices closed to make room, and leases discarded by their holder
+	// or because the device could not be reset.
+	uint64_t evicted = 0;
+	uint64_t discarded = 0;
+	// Nanoseconds to create and open a device, and for Acquire as a whole.
+	LatencyHistogram creation{};
+	LatencyHistogram acquire{};
+};
+
+class DevicePool;
+
+// Exclusive use of a pooled device. The device goes back to the pool, reset,
+// when the lease ends.
+class DeviceLease
+{
+public:
+	DeviceLease() = default;
+	DeviceLease(DeviceLease&& other) noexcept { *this = std::move(other); }
+	DeviceLease& operator=(DeviceLease&& other) noexcept;
+	~DeviceLease() { Release(); }
+
+	explicit operator bool() const { return m_device != nullptr; }
+	InjectionBackend& Backend() { return *m_device; }
+	// The device was used before and not created for this lease.
+	bool Reused() const { return m_reused; }
+
+	// Closes the device instead of returning it, e.g. when it misbehaved.
+	void Discard() { m_discard = true; }
+	void Release();
+
+private:
+	friend class DevicePool;
+
+	DeviceLease(DevicePool& pool, std::unique_ptr<PooledDevice> device, bool reused) : m_pool(&pool), m_device(std::move(device)), m_reused(reused) {}
+
+	DevicePool* m_pool = nullptr;
+	std::unique_ptr<PooledDevice> m_device;
+	bool m_reused = false;
+	bool m_discard = false;
+};
+
+// Cache of open synthetic devices keyed by DeviceKey. Creating a device is
+// slow and announces itself to every window with WM_POINTERDEVICECHANGE, so
+// devices are kept after use, up to `maxIdle` of them, and the least recently
+// used one is closed when that is exceeded. Safe to use from any thread;
+// every lease must end before the pool is destroyed.
+class DevicePool
+{
+public:
+	constexpr static size_t MAX_IDLE = 4;
+
+	using BackendFactory = std::function<std::unique_ptr<InjectionBackend>()>;
+
+	explicit DevicePool(BackendFactory createBackend, size_t maxIdle = MAX_IDLE) : m_createBackend(std::move(createBackend)), m_maxIdle(maxIdle) {}
+
+	DevicePool(const DevicePool&) = delete;
+	DevicePool& operator=(const DevicePool&) = delete;
+
+	// Returns an empty lease when no device could be created.
+	DeviceLease Acquire(const DeviceKey& key)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		std::unique_ptr<PooledDevice> device;
+		{
+			std::lock_guard lock{ m_mutex };
+			for (size_t i = m_idle.size(); i-- > 0;)
+			{
+				if (m_idle[i]->Key() == key)
+				{
+					device = std::move(m_idle[i]);
+					m_idle.erase(m_idle.begin() + static_cast<ptrdiff_t>(i));
+					m_stats.reused++;
+					m_stats.acquire.Record(Elapsed(start));
+					return DeviceLease(*this, std::move(device), true);
+				}
+			}
+		}
+
+		// Created outside the lock; opening a device can take milliseconds.
+		std::unique_ptr<InjectionBackend> backend = m_createBackend();
+		const bool opened = backend && backend->Open(key.pointerType, key.maxContacts, key.feedback);
+		std::lock_guard lock{ m_mutex };
+		if (!opened)
+		{
+			m_stats.failed++;
+			return {};
+		}
+		m_stats.created++;
+		m_stats.creation.Record(Elapsed(start));
+		m_stats.acquire.Record(Elapsed(start));
+		return DeviceLease(*this, std::make_unique<PooledDevice>(key, std::move(backend)), false);
+	}
+
+	// Closes every idle device.
+	void Trim()
+	{
+		std::vector<std::unique_ptr<PooledDevice>> idle;
+		{
+			std::lock_guard lock{ m_mutex };
+			idle.swap(m_idle);
+			m_stats.evicted += idle.size();
+		}
+	}
+
+	size_t Idle() const
+	{
+		std::lock_guard lock{ m_mutex };
+		return m_idle.size();
+	}
+
+	DevicePoolStats Stats() const
+	{
+		std::lock_guard lock{ m_mutex };
+		return m_stats;
+	}
+
+private:
+	friend class DeviceLease;
+
+	static int64_t Elapsed(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void Return(std::unique_ptr<PooledDevice> device, bool discard)
+	{
+		const bool reset = !discard && device->Reset();
+		std::unique_ptr<PooledDevice> evicted;
+		std::lock_guard lock{ m_mutex };
+		if (!reset || m_maxIdle == 0)
+		{
+			m_stats.discarded++;
+			return;
+		}
+		if (m_idle.size() == m_maxIdle)
+		{
+			evicted = std::move(m_idle.front());
+			m_idle.erase(m_idle.begin());
+			m_stats.evicted++;
+		}
+		m_idle.push_back(std::move(device));
+	}
+
+	BackendFactory m_createBackend;
+	size_t m_maxIdle;
+	mutable std::mutex m_mutex;
+	// Least recently returned first.
+	std::vector<std::unique_ptr<PooledDevice>> m_idle;
+	DevicePoolStats m_stats{};
+};
+
+inline DeviceLease& DeviceLease::operator=(DeviceLease&& other) noexcept
+{
+	if (this != &other)
+	{
+		Release();
+		m_pool = std::exchange(other.m_pool, nullptr);
+		m_device = std::move(other.m_device);
+		m_reused = other.m_reused;
+		m_discard = other.m_discard;
+	}
+	return *this;
+}
+
+inline void DeviceLease::Release()
+{
+	if (m_device)
+	{
+		m_pool->Return(std::move(m_device), m_discard);
+	}
+	m_pool = nullptr;
+	m_discard = false;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <utility>
+#include <vector>
+
+constexpr uint32_t DEFAULT_DPI = 96;
+
+// a * b / c rounded half away from zero, like MulDiv, including its -1 when c
+// is zero or the result does not fit in 32 bits.
+constexpr int32_t MulDivRound(int32_t a, int32_t b, int32_t c)
+{
+	if (c == 0)
+	{
+		return -1;
+	}
+	const int64_t product = static_cast<int64_t>(a) * b;
+	const int64_t numerator = product < 0 ? -product : product;
+	const int64_t divisor = c < 0 ? -static_cast<int64_t>(c) : c;
+	const int64_t magnitude = (numerator + divisor / 2) / divisor;
+	const int64_t result = (product < 0) != (c < 0) ? -magnitude : magnitude;
+	return result < INT32_MIN || result > INT32_MAX ? -1 : static_cast<int32_t>(result);
+}
+
+// Scales a length given at 96 DPI to `dpi`.
+constexpr int32_t ScaleForDpi(int32_t value, uint32_t dpi)
+{
+	return MulDivRound(value, static_cast<int32_t>(dpi), DEFAULT_DPI);
+}
+
+struct LayoutRect
+{
+	int32_t x = 0;
+	int32_t y = 0;
+	int32_t width = 0;
+	int32_t height = 0;
+
+	bool operator==(const LayoutRect&) const = default;
+};
+
+// The demo window: the log fills the top half of the client area and the
+// buttons share one row below it, the last one taking whatever the division
+// leaves over.
+constexpr int32_t BUTTON_ROW_HEIGHT = 40;
+
+inline void LayoutMainWindow(int32_t width, int32_t height, uint32_t dpi, LayoutRect& log, std::span<LayoutRect> buttons)
+{
+	const int32_t logHeight = height / 2;
+	log = { 0, 0, width, logHeight };
+	if (buttons.empty())
+	{
+		return;
+	}
+	const int32_t count = static_cast<int32_t>(buttons.size());
+	const int32_t buttonWidth = width / count;
+	const int32_t buttonHeight = ScaleForDpi(BUTTON_ROW_HEIGHT, dpi);
+	for (int32_t i = 0; i < count; i++)
+	{
+		buttons[static_cast<size_t>(i)] = { buttonWidth * i, logHeight, i + 1 < count ? buttonWidth : width - buttonWidth * i, buttonHeight };
+	}
+}
+
+// Resources that depend on the DPI, such as fonts, created on first use for
+// each DPI and kept for when the window returns to it. Up to `capacity` DPIs
+// are kept; the least recently used one is destroyed when another is needed.
+// With a capacity of at least two the entry returned by the previous Get
+// survives the next one, so the old resources can stay selected until the new
+// ones are in place.
+template <typename Resources>
+class DpiCache
+{
+public:
+	constexpr static size_t CAPACITY = 4;
+
+	using Factory = std::function<Resources(uint32_t dpi)>;
+
+	explicit DpiCache(Factory create, size_t capacity = CAPACITY) : m_create(std::move(create)), m_capacity(capacity < 2 ? 2 : capacity)
+	{
+		m_entries.reserve(m_capacity);
+	}
+
+	const Resources& Get(uint32_t dpi)
+	{
+		m_tick++;
+		Entry* oldest = nullptr;
+		for (Entry& entry : m_entries)
+		{
+			if (entry.dpi == dpi)
+			{
+				entry.lastUse = m_tick;
+				m_hits++;
+				return entry.resources;
+			}
+			if (!oldest || entry.lastUse < oldest->lastUse)
+			{
+				oldest = &entry;
+			}
+		}
+
+		m_misses++;
+		if (m_entries.size() < m_capacity)
+		{
+			m_entries.push_back({ dpi, m_tick, m_create(dpi) });
+			return m_entries.back().resources;
+		}
+		// The old resources are released before the new ones are created.
+		oldest->resources = Resources{};
+		oldest->resources = m_create(dpi);
+		oldest->dpi = dpi;
+		oldest->lastUse = m_tick;
+		m_evictions++;
+		return oldest->resources;
+	}
+
+	size_t Size() const { return m_entries.size(); }
+	uint64_t Hits() const { return m_hits; }
+	uint64_t Misses() const { return m_misses; }
+	uint64_t Evictions() const { return m_evictions; }
+
+private:
+	struct Entry
+	{
+		uint32_t dpi;
+		uint64_t lastUse;
+		Resources resources;
+	};
+
+	Factory m_create;
+	size_t m_capacity;
+	std::vector<Entry> m_entries;
+	uint64_t m_tick = 0;
+	uint64_t m_hits = 0;
+	uint64_t m_misses = 0;
+	uint64_t m_evictions = 0;
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "Trace.h"
+#include "WinCompat.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+// Timestamps in QueryPerformanceCounter ticks, the same clock the demo window
+// stamps its own messages with.
+struct QpcClock
+{
+	static int64_t Now()
+	{
+		LARGE_INTEGER now{};
+		QueryPerformanceCounter(&now);
+		return now.QuadPart;
+	}
+};
+
+struct CollectedEvent
+{
+	TraceRecord record;
+	// Index of the thread, and so the window, the message was captured on.
+	uint32_t source;
+};
+
+// Gathers messages from a fixed number of threads, each pushing only to its
+// own source, and hands them to a single consumer in one global order: by
+// timestamp, then by source. Every source is a single-producer,
+// single-consumer ring allocated once, so neither side takes a lock or
+// allocates; a push to a full ring fails and is counted as dropped.
+//
+// Records are stamped inside Push, between raising and lowering a flag of the
+// source. A consumer that finds a source empty and not stamping therefore
+// knows that anything the source pushes later is stamped at or after the time
+// it looked, and only releases events stamped before that; while a source is
+// stamping, Drain stops at it and leaves the rest for the next call. Once the
+// producers have stopped, one Drain returns everything left.
+template <size_t Capacity = 1024, typename Clock = QpcClock>
+class EventCollector
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	explicit EventCollector(size_t sources) : m_sources(new Source[sources ? sources : 1]), m_count(sources ? sources : 1) {}
+
+	EventCollector(const EventCollector&) = delete;
+	EventCollector& operator=(const EventCollector&) = delete;
+
+	size_t Sources() const { return m_count; }
+
+	// Stamps `record` and queues it; only ever called from the thread that
+	// owns `source`. Returns false if the source's ring is full.
+	bool Push(size_t source, TraceRecord record)
+	{
+		Source& queue = m_sources[source];
+		const size_t head = queue.head.load(std::memory_order_relaxed);
+		if (head - queue.tail.load(std::memory_order_acquire) == Capacity)
+		{
+			queue.dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		queue.stamping.store(true, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		record.timestamp = Clock::Now();
+		queue.events[head & (Capacity - 1)] = { record, static_cast<uint32_t>(source) };
+		queue.head.store(head + 1, std::memory_order_release);
+		queue.stamping.store(false, std::memory_order_release);
+		return true;
+	}
+
+	// Hands every event that can no longer be preceded by another to
+	// `consume(event)` in order, from the consumer thread. Returns the number
+	// of events drained.
+	template <typename Consumer>
+	size_t Drain(Consumer&& consume)
+	{
+		size_t drained = 0;
+		for (;;)
+		{
+			const int64_t now = Clock::Now();
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t bound = std::numeric_limits<int64_t>::max();
+			Source* next = nullptr;
+			const CollectedEvent* event = nullptr;
+			for (size_t i = 0; i < m_count; i++)
+			{
+				Source& queue = m_sources[i];
+				const bool stamping = queue.stamping.load(std::memory_order_seq_cst);
+				const size_t tail = queue.tail.load(std::memory_order_relaxed);
+				if (tail == queue.head.load(std::memory_order_acquire))
+				{
+					if (stamping)
+					{
+						// Its next event is stamped but not visible yet.
+						return drained;
+					}
+					bound = now < bound ? now : bound;
+					continue;
+				}
+				// Sources are visited in order, so a tie keeps the lower one.
+				const CollectedEvent& head = queue.events[tail & (Capacity - 1)];
+				if (!event || head.record.timestamp < event->record.timestamp)
+				{
+					next = &queue;
+					event = &head;
+				}
+			}
+			if (!event || event->record.timestamp >= bound)
+			{
+				return drained;
+			}
+			consume(*event);
+			next->tail.store(next->tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+			drained++;
+		}
+	}
+
+	uint64_t Dropped(size_t source) const { return m_sources[source].dropped.load(std::memory_order_relaxed); }
+
+	uint64_t Dropped() const
+	{
+		uint64_t dropped = 0;
+		for (size_t i = 0; i < m_count; i++)
+		{
+			dropped += Dropped(i);
+		}
+		return dropped;
+	}
+
+private:
+	struct Source
+	{
+		std::unique_ptr<CollectedEvent[]> events{ new CollectedEvent[Capacity] };
+		alignas(64) std::atomic<size_t> head{ 0 };
+		std::atomic<bool> stamping{ false };
+		std::atomic<uint64_t> dropped{ 0 };
+		alignas(64) std::atomic<size_t> tail{ 0 };
+	};
+
+	std::unique_ptr<Source[]> m_sources;
+	size_t m_count;
+};
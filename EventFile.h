@@ -0,0 +1,843 @@
+#pragma once
+
+#include "EventLog.h"
+#include "Latency.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef EVENT_FILE_LZ4
+#include <lz4.h>
+#endif
+#ifdef EVENT_FILE_ZSTD
+#include <zstd.h>
+#endif
+
+// Exported event log format.
+//
+// A file is an EventFileHeader followed by blocks, each an EventBlockHeader and
+// a payload holding `eventCount` EventRecords and then the text of the block's
+// Text events, compressed as a whole. A closed file ends with an index of its
+// blocks and an EventFileFooter; a file cut short has no index, and a reader
+// rebuilds it from the block headers that were written completely.
+//
+// The index keeps the highest timestamp seen up to and including each block,
+// which never decreases, so finding where a time lies in the file is a binary
+// search followed by a scan of one block.
+
+enum class BlockCodec : uint8_t
+{
+	Stored,
+	// Each record XORed with the one before it, then runs of zero bytes
+	// collapsed. Consecutive events differ in a few bytes, so this gets most
+	// of what a general-purpose compressor would at a fraction of the cost.
+	Delta,
+	LZ4,
+	Zstd,
+};
+
+constexpr std::string_view BlockCodecName(BlockCodec codec)
+{
+	switch (codec)
+	{
+	case BlockCodec::Stored: return "stored";
+	case BlockCodec::Delta: return "delta";
+	case BlockCodec::LZ4: return "lz4";
+	case BlockCodec::Zstd: return "zstd";
+	default: return "unknown";
+	}
+}
+
+// LZ4 and zstd are only available when the build defines EVENT_FILE_LZ4 or
+// EVENT_FILE_ZSTD and links the library; see the CMake options.
+constexpr bool BlockCodecAvailable(BlockCodec codec)
+{
+	switch (codec)
+	{
+	case BlockCodec::Stored:
+	case BlockCodec::Delta:
+		return true;
+#ifdef EVENT_FILE_LZ4
+	case BlockCodec::LZ4:
+		return true;
+#endif
+#ifdef EVENT_FILE_ZSTD
+	case BlockCodec::Zstd:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+#if defined(EVENT_FILE_ZSTD)
+constexpr BlockCodec DEFAULT_BLOCK_CODEC = BlockCodec::Zstd;
+#elif defined(EVENT_FILE_LZ4)
+constexpr BlockCodec DEFAULT_BLOCK_CODEC = BlockCodec::LZ4;
+#else
+constexpr BlockCodec DEFAULT_BLOCK_CODEC = BlockCodec::Delta;
+#endif
+
+constexpr char g_EventFileMagic[4] = { 'W', 'M', 'P', 'E' };
+constexpr char g_EventBlockMagic[4] = { 'W', 'M', 'P', 'B' };
+constexpr char g_EventIndexMagic[4] = { 'W', 'M', 'P', 'I' };
+constexpr uint32_t g_EventFileVersion = 1;
+// Largest block a writer produces and a reader accepts, so that a damaged
+// header cannot make the reader allocate without bound.
+constexpr uint32_t g_EventBlockMaxEvents = 1u << 20;
+constexpr uint32_t g_EventBlockMaxText = 16u << 20;
+
+struct EventFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t recordSize;
+	uint32_t reserved;
+	int64_t timestampFrequency;
+	// Position of the file in a rotated series, starting at 1.
+	uint64_t sequence;
+};
+
+struct EventBlockHeader
+{
+	char magic[4];
+	BlockCodec codec;
+	uint8_t reserved[3];
+	uint32_t eventCount;
+	uint32_t textSize;
+	// Bytes of payload that follow the header.
+	uint32_t storedSize;
+	uint32_t reserved2;
+	int64_t firstTimestamp;
+	int64_t maxTimestamp;
+};
+
+struct EventIndexEntry
+{
+	uint64_t offset;
+	int64_t firstTimestamp;
+	// Highest timestamp in this block or any before it.
+	int64_t maxTimestamp;
+};
+
+struct EventFileFooter
+{
+	uint64_t indexOffset;
+	uint64_t blockCount;
+	char magic[4];
+	uint32_t reserved;
+};
+
+static_assert(std::is_trivially_copyable_v<EventBlockHeader>);
+static_assert(sizeof(EventFileHeader) % 8 == 0 && sizeof(EventBlockHeader) % 8 == 0);
+
+inline std::filesystem::path EventFilePath(const std::filesystem::path& directory, std::string_view baseName, uint64_t sequence)
+{
+	char suffix[32];
+	std::snprintf(suffix, sizeof(suffix), "-%06llu.wmpe", static_cast<unsigned long long>(sequence));
+	return directory / (std::string(baseName) + suffix);
+}
+
+// Files of a rotated series that are still on disk, oldest first.
+inline std::vector<std::filesystem::path> EventFiles(const std::filesystem::path& directory, std::string_view baseName)
+{
+	std::vector<std::pair<uint64_t, std::filesystem::path>> found;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+	{
+		const std::string name = entry.path().filename().string();
+		if (name.size() != baseName.size() + 12 || name.compare(0, baseName.size(), baseName) != 0 || name.compare(name.size() - 5, 5, ".wmpe") != 0 || name[baseName.size()] != '-')
+		{
+			continue;
+		}
+		found.emplace_back(std::strtoull(name.c_str() + baseName.size() + 1, nullptr, 10), entry.path());
+	}
+	std::sort(found.begin(), found.end());
+	std::vector<std::filesystem::path> paths;
+	for (auto& [sequence, path] : found)
+	{
+		paths.push_back(std::move(path));
+	}
+	return paths;
+}
+
+namespace EventFileDetail
+{
+	// Control byte of the Delta codec: below 0x80, a run of 1 + c literal
+	// bytes follows; from 0x80, a run of c - 0x7F zero bytes.
+	constexpr size_t MAX_RUN = 128;
+
+	inline void Delta(const uint8_t* raw, size_t recordBytes, size_t size, std::vector<uint8_t>& scratch, std::vector<uint8_t>& out)
+	{
+		scratch.assign(raw, raw + size);
+		for (size_t j = sizeof(EventRecord); j < recordBytes; j++)
+		{
+			scratch[j] ^= raw[j - sizeof(EventRecord)];
+		}
+
+		out.clear();
+		const uint8_t* in = scratch.data();
+		for (size_t i = 0; i < size;)
+		{
+			size_t zeros = 0;
+			while (i + zeros < size && in[i + zeros] == 0 && zeros < MAX_RUN)
+			{
+				zeros++;
+			}
+			if (zeros >= 2 || (zeros == 1 && i + 1 == size))
+			{
+				out.push_back(static_cast<uint8_t>(0x7F + zeros));
+				i += zeros;
+				continue;
+			}
+			const size_t start = i;
+			while (i < size && i - start < MAX_RUN && !(in[i] == 0 && (i + 1 == size || in[i + 1] == 0)))
+			{
+				i++;
+			}
+			out.push_back(static_cast<uint8_t>(i - start - 1));
+			out.insert(out.end(), in + start, in + i);
+		}
+	}
+
+	inline bool Undelta(const uint8_t* in, size_t size, size_t recordBytes, uint8_t* raw, size_t rawSize)
+	{
+		size_t written = 0;
+		for (size_t i = 0; i < size;)
+		{
+			const uint8_t control = in[i++];
+			const size_t run = control < 0x80 ? control + 1u : control - 0x7Fu;
+			if (written + run > rawSize || (control < 0x80 && i + run > size))
+			{
+				return false;
+			}
+			if (control < 0x80)
+			{
+				std::memcpy(raw + written, in + i, run);
+				i += run;
+			}
+			else
+			{
+				std::memset(raw + written, 0, run);
+			}
+			written += run;
+		}
+		if (written != rawSize)
+		{
+			return false;
+		}
+		for (size_t j = sizeof(EventRecord); j < recordBytes; j++)
+		{
+			raw[j] ^= raw[j - sizeof(EventRecord)];
+		}
+		return true;
+	}
+
+	// Returns false when the codec is not built in or the output does not
+	// fit; the caller then stores the block.
+	inline bool Compress(BlockCodec codec, const uint8_t* raw, size_t recordBytes, size_t size, std::vector<uint8_t>& scratch, std::vector<uint8_t>& out)
+	{
+		switch (codec)
+		{
+		case BlockCodec::Delta:
+			Delta(raw, recordBytes, size, scratch, out);
+			return out.size() < size;
+#ifdef EVENT_FILE_LZ4
+		case BlockCodec::LZ4:
+			{
+				out.resize(static_cast<size_t>(LZ4_compressBound(static_cast<int>(size))));
+				const int stored = LZ4_compress_default(reinterpret_cast<const char*>(raw), reinterpret_cast<char*>(out.data()), static_cast<int>(size), static_cast<int>(out.size()));
+				out.resize(stored > 0 ? static_cast<size_t>(stored) : 0);
+				return stored > 0 && out.size() < size;
+			}
+#endif
+#ifdef EVENT_FILE_ZSTD
+		case BlockCodec::Zstd:
+			{
+				out.resize(ZSTD_compressBound(size));
+				const size_t stored = ZSTD_compress(out.data(), out.size(), raw, size, 3);
+				out.resize(ZSTD_isError(stored) ? 0 : stored);
+				return !ZSTD_isError(stored) && out.size() < size;
+			}
+#endif
+		default:
+			return false;
+		}
+	}
+
+	inline bool Decompress(BlockCodec codec, const uint8_t* in, size_t size, size_t recordBytes, uint8_t* raw, size_t rawSize)
+	{
+		switch (codec)
+		{
+		case BlockCodec::Stored:
+			if (size != rawSize)
+			{
+				return false;
+			}
+			std::memcpy(raw, in, size);
+			return true;
+		case BlockCodec::Delta:
+			return Undelta(in, size, recordBytes, raw, rawSize);
+#ifdef EVENT_FILE_LZ4
+		case BlockCodec::LZ4:
+			return LZ4_decompress_safe(reinterpret_cast<const char*>(in), reinterpret_cast<char*>(raw), static_cast<int>(size), static_cast<int>(rawSize)) == static_cast<int>(rawSize);
+#endif
+#ifdef EVENT_FILE_ZSTD
+		case BlockCodec::Zstd:
+			return ZSTD_decompress(raw, rawSize, in, size) == rawSize;
+#endif
+		default:
+			return false;
+		}
+	}
+}
+
+struct EventFileConfig
+{
+	std::filesystem::path directory = ".";
+	std::string baseName = "events";
+	int64_t timestampFrequency = 1;
+	BlockCodec codec = DEFAULT_BLOCK_CODEC;
+	// A block is sealed and queued for writing when it holds this many events
+	// or this much text, or on the first flush after it has been open for
+	// `blockAge`. Both are capped at the format's block limits.
+	size_t blockEvents = 4096;
+	size_t blockText = 64 * 1024;
+	std::chrono::milliseconds blockAge{ 1000 };
+	// A new file is started once the current one reaches `maxFileBytes`, and
+	// the oldest ones are deleted to keep at most `maxFiles`; 0 keeps all.
+	uint64_t maxFileBytes = 64ull << 20;
+	size_t maxFiles = 8;
+	// Sealed blocks waiting for the writer thread. When it falls this far
+	// behind, further blocks are dropped rather than stalling the caller.
+	size_t queueBlocks = 8;
+};
+
+struct EventFileStats
+{
+	uint64_t events = 0;
+	uint64_t blocks = 0;
+	uint64_t files = 0;
+	uint64_t rawBytes = 0;
+	uint64_t storedBytes = 0;
+	// Backpressure: events in blocks dropped because the queue was full or
+	// the file could not be written, and the deepest the queue has been.
+	uint64_t droppedEvents = 0;
+	uint64_t droppedBlocks = 0;
+	size_t peakQueued = 0;
+	bool failed = false;
+	// Nanoseconds a block waited in the queue, and to compress and write it.
+	LatencyHistogram queueWait{};
+	LatencyHistogram write{};
+
+	double CompressionRatio() const { return storedBytes ? static_cast<double>(rawBytes) / static_cast<double>(storedBytes) : 0.0; }
+};
+
+// Event sink that exports everything it is given to a rotating series of
+// files. Events are gathered into blocks on the calling thread, which costs a
+// copy per event; compression and disk writes happen on a background thread.
+class EventFileWriter final : public EventSink
+{
+public:
+	explicit EventFileWriter(EventFileConfig config) : m_config(std::move(config))
+	{
+		m_config.queueBlocks = std::max<size_t>(m_config.queueBlocks, 1);
+		m_config.blockEvents = std::clamp<size_t>(m_config.blockEvents, 1, g_EventBlockMaxEvents);
+		// A line longer than a whole block still goes into one, so leave room
+		// for the longest an event can describe.
+		m_config.blockText = std::min<size_t>(m_config.blockText, g_EventBlockMaxText - std::numeric_limits<uint16_t>::max());
+		// One block being filled, one being written and a full queue.
+		for (size_t i = 0; i < m_config.queueBlocks + 2; i++)
+		{
+			m_free.push_back(std::make_unique<Block>());
+		}
+		m_block = TakeFree();
+		m_thread = std::thread([this]() { Run(); });
+	}
+
+	EventFileWriter(const EventFileWriter&) = delete;
+	EventFileWriter& operator=(const EventFileWriter&) = delete;
+
+	// Writes out everything appended so far and closes the file.
+	~EventFileWriter()
+	{
+		Seal(true);
+		{
+			std::lock_guard lock{ m_mutex };
+			m_stopping = true;
+		}
+		m_wake.notify_one();
+		m_thread.join();
+	}
+
+	void Append(const EventRecord& event, std::string_view text) override
+	{
+		if (m_block->events.size() == m_config.blockEvents || m_block->text.size() + text.size() > m_config.blockText)
+		{
+			Seal();
+		}
+		if (m_block->events.empty())
+		{
+			m_block->opened = std::chrono::steady_clock::now();
+		}
+		m_block->events.push_back(event);
+		if (event.kind == EventKind::Text)
+		{
+			m_block->events.back().textOffset = static_cast<uint32_t>(m_block->text.size());
+			m_block->text.append(text);
+		}
+	}
+
+	void Flush() override
+	{
+		if (!m_block->events.empty() && std::chrono::steady_clock::now() - m_block->opened >= m_config.blockAge)
+		{
+			Seal();
+		}
+	}
+
+	// Seals the current block and waits until everything is on disk.
+	void Sync()
+	{
+		Seal(true);
+		std::unique_lock lock{ m_mutex };
+		m_idle.wait(lock, [this]() { return m_queue.empty() && !m_writing; });
+		if (m_file.is_open())
+		{
+			m_file.flush();
+		}
+	}
+
+	EventFileStats Stats() const
+	{
+		std::lock_guard lock{ m_mutex };
+		return m_stats;
+	}
+
+	size_t Queued() const
+	{
+		std::lock_guard lock{ m_mutex };
+		return m_queue.size();
+	}
+
+	// The file being written, empty before the first block.
+	std::filesystem::path CurrentPath() const
+	{
+		std::lock_guard lock{ m_mutex };
+		return m_path;
+	}
+
+private:
+	struct Block
+	{
+		std::vector<EventRecord> events;
+		std::string text;
+		std::chrono::steady_clock::time_point opened;
+		std::chrono::steady_clock::time_point sealed;
+	};
+
+	std::unique_ptr<Block> TakeFree()
+	{
+		std::unique_ptr<Block> block = std::move(m_free.back());
+		m_free.pop_back();
+		block->events.clear();
+		block->text.clear();
+		return block;
+	}
+
+	// Queues the current block. When the writer is too far behind, the block
+	// is dropped, or with `wait` the caller waits for room.
+	void Seal(bool wait = false)
+	{
+		if (m_block->events.empty())
+		{
+			return;
+		}
+		{
+			std::unique_lock lock{ m_mutex };
+			if (wait)
+			{
+				m_idle.wait(lock, [this]() { return m_queue.size() < m_config.queueBlocks || m_stats.failed; });
+			}
+			if (m_queue.size() == m_config.queueBlocks || m_stats.failed)
+			{
+				m_stats.droppedEvents += m_block->events.size();
+				m_stats.droppedBlocks++;
+				m_block->events.clear();
+				m_block->text.clear();
+				return;
+			}
+			m_block->sealed = std::chrono::steady_clock::now();
+			m_queue.push_back(std::move(m_block));
+			m_stats.peakQueued = std::max<size_t>(m_stats.peakQueued, m_queue.size());
+			m_block = TakeFree();
+		}
+		m_wake.notify_one();
+	}
+
+	void Run()
+	{
+		for (;;)
+		{
+			std::unique_ptr<Block> block;
+			{
+				std::unique_lock lock{ m_mutex };
+				m_writing = false;
+				m_idle.notify_all();
+				m_wake.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+				if (m_queue.empty())
+				{
+					break;
+				}
+				block = std::move(m_queue.front());
+				m_queue.pop_front();
+				m_writing = true;
+				m_stats.queueWait.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - block->sealed).count());
+			}
+
+			const auto start = std::chrono::steady_clock::now();
+			const bool written = Write(*block);
+			const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+			std::lock_guard lock{ m_mutex };
+			if (written)
+			{
+				m_stats.events += block->events.size();
+				m_stats.blocks++;
+				m_stats.write.Record(elapsed);
+			}
+			else
+			{
+				m_stats.failed = true;
+				m_stats.droppedEvents += block->events.size();
+				m_stats.droppedBlocks++;
+			}
+			m_free.push_back(std::move(block));
+		}
+		CloseFile();
+	}
+
+	bool Write(const Block& block)
+	{
+		if ((!m_file.is_open() || m_fileBytes >= m_config.maxFileBytes) && !NextFile())
+		{
+			return false;
+		}
+
+		const size_t recordBytes = block.events.size() * sizeof(EventRecord);
+		m_raw.resize(recordBytes + block.text.size());
+		std::memcpy(m_raw.data(), block.events.data(), recordBytes);
+		std::memcpy(m_raw.data() + recordBytes, block.text.data(), block.text.size());
+
+		EventBlockHeader header{};
+		std::memcpy(header.magic, g_EventBlockMagic, sizeof(header.magic));
+		header.codec = m_config.codec;
+		if (!EventFileDetail::Compress(m_config.codec, m_raw.data(), recordBytes, m_raw.size(), m_scratch, m_stored))
+		{
+			header.codec = BlockCodec::Stored;
+			m_stored.assign(m_raw.begin(), m_raw.end());
+		}
+		header.eventCount = static_cast<uint32_t>(block.events.size());
+		header.textSize = static_cast<uint32_t>(block.text.size());
+		header.storedSize = static_cast<uint32_t>(m_stored.size());
+		header.firstTimestamp = block.events.front().timestamp;
+		header.maxTimestamp = header.firstTimestamp;
+		for (const EventRecord& event : block.events)
+		{
+			header.maxTimestamp = std::max<int64_t>(header.maxTimestamp, event.timestamp);
+		}
+		m_maxTimestamp = std::max<int64_t>(m_maxTimestamp, header.maxTimestamp);
+
+		m_index.push_back({ m_fileBytes, header.firstTimestamp, m_maxTimestamp });
+		m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		m_file.write(reinterpret_cast<const char*>(m_stored.data()), static_cast<std::streamsize>(m_stored.size()));
+		if (!m_file)
+		{
+			return false;
+		}
+		m_fileBytes += sizeof(header) + m_stored.size();
+
+		std::lock_guard lock{ m_mutex };
+		m_stats.rawBytes += m_raw.size();
+		m_stats.storedBytes += m_stored.size();
+		return true;
+	}
+
+	// Never replaces an existing file; a series that would is an error.
+	bool NextFile()
+	{
+		CloseFile();
+		const std::filesystem::path path = EventFilePath(m_config.directory, m_config.baseName, ++m_sequence);
+		std::error_code error;
+		if (std::filesystem::exists(path, error) || error)
+		{
+			return false;
+		}
+		m_file.open(path, std::ios::binary | std::ios::trunc);
+		EventFileHeader header{};
+		std::memcpy(header.magic, g_EventFileMagic, sizeof(header.magic));
+		header.version = g_EventFileVersion;
+		header.recordSize = sizeof(EventRecord);
+		header.timestampFrequency = m_config.timestampFrequency;
+		header.sequence = m_sequence;
+		m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		if (!m_file)
+		{
+			m_file.close();
+			return false;
+		}
+		m_fileBytes = sizeof(header);
+		m_maxTimestamp = std::numeric_limits<int64_t>::min();
+		m_index.clear();
+
+		m_files.push_back(path);
+		if (m_config.maxFiles && m_files.size() > m_config.maxFiles)
+		{
+			std::error_code error;
+			std::filesystem::remove(m_files.front(), error);
+			m_files.pop_front();
+		}
+		std::lock_guard lock{ m_mutex };
+		m_stats.files++;
+		m_path = path;
+		return true;
+	}
+
+	void CloseFile()
+	{
+		if (!m_file.is_open())
+		{
+			return;
+		}
+		EventFileFooter footer{};
+		footer.indexOffset = m_fileBytes;
+		footer.blockCount = m_index.size();
+		std::memcpy(footer.magic, g_EventIndexMagic, sizeof(footer.magic));
+		m_file.write(reinterpret_cast<const char*>(m_index.data()), static_cast<std::streamsize>(m_index.size() * sizeof(EventIndexEntry)));
+		m_file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+		m_file.close();
+	}
+
+	EventFileConfig m_config;
+	// Filled on the calling thread.
+	std::unique_ptr<Block> m_block;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_idle;
+	std::deque<std::unique_ptr<Block>> m_queue;
+	std::vector<std::unique_ptr<Block>> m_free;
+	bool m_writing = false;
+	bool m_stopping = false;
+	EventFileStats m_stats{};
+	std::filesystem::path m_path;
+
+	// Used only by the writer thread.
+	std::ofstream m_file;
+	uint64_t m_sequence = 0;
+	uint64_t m_fileBytes = 0;
+	int64_t m_maxTimestamp = std::numeric_limits<int64_t>::min();
+	std::vector<EventIndexEntry> m_index;
+	std::deque<std::filesystem::path> m_files;
+	std::vector<uint8_t> m_raw;
+	std::vector<uint8_t> m_scratch;
+	std::vector<uint8_t> m_stored;
+
+	// Started last, once everything it uses is constructed.
+	std::thread m_thread;
+};
+
+// Reads one file of an exported series, block by block. Seek positions the
+// reader at the first event at or after a timestamp; Next then returns events
+// in file order. Text views stay valid until the next block is loaded.
+class EventFileReader
+{
+public:
+	bool Open(const std::filesystem::path& path)
+	{
+		m_index.clear();
+		m_events.clear();
+		m_block = 0;
+		m_next = 0;
+		m_file.close();
+		m_file.clear();
+		m_file.open(path, std::ios::binary);
+		std::error_code error;
+		m_size = std::filesystem::file_size(path, error);
+		if (!m_file || error || !ReadAt(0, &m_header, sizeof(m_header))
+			|| std::memcmp(m_header.magic, g_EventFileMagic, sizeof(g_EventFileMagic)) != 0
+			|| m_header.version != g_EventFileVersion
+			|| m_header.recordSize != sizeof(EventRecord))
+		{
+			return false;
+		}
+		if (!ReadIndex())
+		{
+			RebuildIndex();
+		}
+		m_loaded = SIZE_MAX;
+		return true;
+	}
+
+	const EventFileHeader& Header() const { return m_header; }
+	size_t BlockCount() const { return m_index.size(); }
+	const std::vector<EventIndexEntry>& Index() const { return m_index; }
+
+	// Loads the block and returns its events; text offsets are into Text().
+	bool LoadBlock(size_t block)
+	{
+		if (block == m_loaded)
+		{
+			return true;
+		}
+		EventBlockHeader header{};
+		if (block >= m_index.size() || !ReadAt(m_index[block].offset, &header, sizeof(header)) || !ValidBlock(header, m_index[block].offset))
+		{
+			return false;
+		}
+		const size_t recordBytes = static_cast<size_t>(header.eventCount) * sizeof(EventRecord);
+		m_stored.resize(header.storedSize);
+		m_raw.resize(recordBytes + header.textSize);
+		if (!ReadAt(m_index[block].offset + sizeof(header), m_stored.data(), m_stored.size())
+			|| !EventFileDetail::Decompress(header.codec, m_stored.data(), m_stored.size(), recordBytes, m_raw.data(), m_raw.size()))
+		{
+			return false;
+		}
+		m_events.resize(header.eventCount);
+		std::memcpy(m_events.data(), m_raw.data(), recordBytes);
+		m_text.assign(reinterpret_cast<const char*>(m_raw.data()) + recordBytes, header.textSize);
+		m_loaded = block;
+		return true;
+	}
+
+	const std::vector<EventRecord>& Events() const { return m_events; }
+	std::string_view Text() const { return m_text; }
+
+	// Returns false when no event is at or after `timestamp`.
+	bool Seek(int64_t timestamp)
+	{
+		const auto found = std::lower_bound(m_index.begin(), m_index.end(), timestamp, [](const EventIndexEntry& entry, int64_t t) { return entry.maxTimestamp < t; });
+		m_block = static_cast<size_t>(found - m_index.begin());
+		m_next = 0;
+		if (m_block == m_index.size() || !LoadBlock(m_block))
+		{
+			return false;
+		}
+		while (m_next < m_events.size() && m_events[m_next].timestamp < timestamp)
+		{
+			m_next++;
+		}
+		return true;
+	}
+
+	void Rewind()
+	{
+		m_block = 0;
+		m_next = 0;
+	}
+
+	bool Next(EventRecord& event, std::string_view& text)
+	{
+		while (m_loaded != m_block || m_next == m_events.size())
+		{
+			if (m_loaded == m_block)
+			{
+				m_block++;
+				m_next = 0;
+			}
+			if (!LoadBlock(m_block))
+			{
+				return false;
+			}
+		}
+		event = m_events[m_next++];
+		text = event.kind == EventKind::Text && static_cast<size_t>(event.textOffset) + event.textLength <= m_text.size()
+			? std::string_view(m_text).substr(event.textOffset, event.textLength)
+			: std::string_view{};
+		return true;
+	}
+
+private:
+	bool ReadAt(uint64_t offset, void* data, size_t size)
+	{
+		if (offset + size > m_size)
+		{
+			return false;
+		}
+		m_file.clear();
+		m_file.seekg(static_cast<std::streamoff>(offset));
+		m_file.read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+		return static_cast<bool>(m_file);
+	}
+
+	// The header is of a block and fits the limits and what is left of the
+	// file, so that loading it allocates no more than that.
+	bool ValidBlock(const EventBlockHeader& header, uint64_t offset) const
+	{
+		return std::memcmp(header.magic, g_EventBlockMagic, sizeof(g_EventBlockMagic)) == 0
+			&& header.eventCount <= g_EventBlockMaxEvents
+			&& header.textSize <= g_EventBlockMaxText
+			&& offset <= m_size
+			&& sizeof(header) + static_cast<uint64_t>(header.storedSize) <= m_size - offset
+			&& (header.codec != BlockCodec::Stored || header.storedSize == static_cast<uint64_t>(header.eventCount) * sizeof(EventRecord) + header.textSize);
+	}
+
+	bool ReadIndex()
+	{
+		EventFileFooter footer{};
+		if (m_size < sizeof(m_header) + sizeof(footer)
+			|| !ReadAt(m_size - sizeof(footer), &footer, sizeof(footer))
+			|| std::memcmp(footer.magic, g_EventIndexMagic, sizeof(g_EventIndexMagic)) != 0
+			|| footer.indexOffset + footer.blockCount * sizeof(EventIndexEntry) + sizeof(footer) != m_size)
+		{
+			return false;
+		}
+		m_index.resize(static_cast<size_t>(footer.blockCount));
+		return ReadAt(footer.indexOffset, m_index.data(), m_index.size() * sizeof(EventIndexEntry));
+	}
+
+	// For a file whose writer did not get to close it: every complete block
+	// up to the first damaged one.
+	void RebuildIndex()
+	{
+		m_index.clear();
+		int64_t maxTimestamp = std::numeric_limits<int64_t>::min();
+		uint64_t offset = sizeof(m_header);
+		EventBlockHeader header{};
+		while (ReadAt(offset, &header, sizeof(header)) && ValidBlock(header, offset))
+		{
+			maxTimestamp = std::max<int64_t>(maxTimestamp, header.maxTimestamp);
+			m_index.push_back({ offset, header.firstTimestamp, maxTimestamp });
+			offset += sizeof(header) + header.storedSize;
+		}
+	}
+
+	std::ifstream m_file;
+	uint64_t m_size = 0;
+	EventFileHeader m_header{};
+	std::vector<EventIndexEntry> m_index;
+	size_t m_loaded = SIZE_MAX;
+	std::vector<EventRecord> m_events;
+	std::string m_text;
+	std::vector<uint8_t> m_stored;
+	std::vector<uint8_t> m_raw;
+	size_t m_block = 0;
+	size_t m_next = 0;
+};
@@ -0,0 +1,295 @@
+#pragma once
+
+#include "Decode.h"
+#include "LogSink.h"
+#include "Trace.h"
+#include "WinCompat.h"
+#include <fmt/core.h>
+#include <fmt/format.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+enum class EventKind : uint8_t
+{
+	// A decoded message, rendered the way LogMessage describes it.
+	Message,
+	// A line of text, rendered as is.
+	Text,
+};
+
+// What the pipeline keeps for each logged message or line. Recording one is a
+// handful of stores; turning it into text is left to the sinks that want text.
+struct EventRecord
+{
+	int64_t timestamp;
+	uint64_t wParam;
+	int64_t lParam;
+	uint32_t message;
+	// TraceRecordFlags; only TRACE_HAS_HITTEST is carried over.
+	uint32_t flags;
+	// Messages of the same kind the throttler dropped before this one.
+	uint32_t throttled;
+	// GET_POINTERID_WPARAM for messages that carry a pointer identifier and
+	// GET_X_LPARAM/GET_Y_LPARAM, so that sinks can filter without decoding.
+	uint32_t pointerId;
+	int32_t x;
+	int32_t y;
+	TraceHitTest hitTest;
+	// Where the line of a Text event is in the arena's text buffer.
+	uint32_t textOffset;
+	uint16_t textLength;
+	EventKind kind;
+	bool terse;
+};
+
+static_assert(std::is_trivially_copyable_v<EventRecord>);
+
+inline EventRecord MessageEvent(const TraceRecord& record, bool terse, uint32_t throttled = 0)
+{
+	EventRecord event{};
+	event.timestamp = record.timestamp;
+	event.wParam = record.wParam;
+	event.lParam = record.lParam;
+	event.message = record.message;
+	event.flags = record.flags & TRACE_HAS_HITTEST;
+	event.throttled = throttled;
+	event.pointerId = HasPointerIdWParam(record.message) ? GET_POINTERID_WPARAM(record.wParam) : 0;
+	event.x = GET_X_LPARAM(record.lParam);
+	event.y = GET_Y_LPARAM(record.lParam);
+	event.hitTest = record.hitTest;
+	event.kind = EventKind::Message;
+	event.terse = terse;
+	return event;
+}
+
+// The parts of the captured message that LogMessage reads.
+inline TraceRecord EventTraceRecord(const EventRecord& event)
+{
+	TraceRecord record{};
+	record.message = event.message;
+	record.flags = event.flags;
+	record.wParam = event.wParam;
+	record.lParam = event.lParam;
+	record.timestamp = event.timestamp;
+	record.hitTest = event.hitTest;
+	return record;
+}
+
+// Single-producer, single-consumer ring of EventRecords, with the text of Text
+// events in a circular byte buffer next to it. Both are allocated once, so
+// pushing never allocates; lines longer than LINE_LENGTH are cut to that
+// length and end in TRUNCATION_MARK instead of their last characters. When
+// either is full, pushing fails and the caller decides whether to drain or
+// drop.
+template <size_t Capacity = 4096, size_t TextCapacity = (1 << 18)>
+class EventArena
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+	static_assert((TextCapacity & (TextCapacity - 1)) == 0, "TextCapacity must be a power of two");
+
+public:
+	constexpr static size_t LINE_LENGTH = 248;
+	constexpr static std::string_view TRUNCATION_MARK = "...";
+
+	static_assert(TextCapacity >= 2 * LINE_LENGTH, "TextCapacity must hold the longest line");
+
+	bool Push(const EventRecord& event)
+	{
+		if (RecordsFull())
+		{
+			return false;
+		}
+		m_records[m_head.load(std::memory_order_relaxed) & (Capacity - 1)] = event;
+		Publish();
+		return true;
+	}
+
+	bool PushText(int64_t timestamp, std::string_view line)
+	{
+		const size_t length = line.size() < LINE_LENGTH ? line.size() : LINE_LENGTH;
+		char* text = AcquireText(length);
+		if (!text)
+		{
+			return false;
+		}
+		line.copy(text, length);
+		PublishText(timestamp, Truncate(text, line.size()));
+		return true;
+	}
+
+	template <typename... T>
+	bool PushText(int64_t timestamp, fmt::format_string<T...> format, T&&... args)
+	{
+		char* text = AcquireText(LINE_LENGTH);
+		if (!text)
+		{
+			return false;
+		}
+		const auto result = fmt::format_to_n(text, LINE_LENGTH, format, std::forward<T>(args)...);
+		PublishText(timestamp, Truncate(text, result.size));
+		return true;
+	}
+
+	// Hands every published event to `consume(event, text)` in order, where
+	// `text` is the line of a Text event and empty otherwise, then frees them.
+	// Returns the number of events drained.
+	template <typename Consumer>
+	size_t Drain(Consumer&& consume)
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		const size_t head = m_head.load(std::memory_order_acquire);
+		uint64_t textTail = m_textTail.load(std::memory_order_relaxed);
+		for (size_t i = tail; i != head; i++)
+		{
+			const EventRecord& event = m_records[i & (Capacity - 1)];
+			if (event.kind != EventKind::Text)
+			{
+				consume(event, std::string_view{});
+				continue;
+			}
+			consume(event, std::string_view(m_text.get() + event.textOffset, event.textLength));
+			// Lines do not wrap; one that started over at the beginning of
+			// the buffer also frees the unused end before it.
+			textTail += (event.textOffset - textTail % TextCapacity) % TextCapacity + event.textLength;
+		}
+		m_textTail.store(textTail, std::memory_order_release);
+		m_tail.store(head, std::memory_order_release);
+		return head - tail;
+	}
+
+	size_t Pending() const
+	{
+		return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+	}
+
+	bool Empty() const { return Pending() == 0; }
+	// No room for another event, whether a message or a line of any length.
+	bool Full() const { return RecordsFull() || TextStart(LINE_LENGTH) + LINE_LENGTH - m_textTail.load(std::memory_order_acquire) > TextCapacity; }
+
+private:
+	// Marks a line of `length` characters whose first LINE_LENGTH are at
+	// `text` as cut short. Returns the length kept.
+	static size_t Truncate(char* text, size_t length)
+	{
+		if (length <= LINE_LENGTH)
+		{
+			return length;
+		}
+		TRUNCATION_MARK.copy(text + LINE_LENGTH - TRUNCATION_MARK.size(), TRUNCATION_MARK.size());
+		return LINE_LENGTH;
+	}
+
+	bool RecordsFull() const
+	{
+		return m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_acquire) == Capacity;
+	}
+
+	// Where a line of `length` bytes goes; it starts over at the beginning of
+	// the buffer rather than wrap around the end.
+	uint64_t TextStart(size_t length) const
+	{
+		const uint64_t start = m_textHead;
+		return start % TextCapacity + length > TextCapacity ? start + TextCapacity - start % TextCapacity : start;
+	}
+
+	char* AcquireText(size_t length)
+	{
+		const uint64_t start = TextStart(length);
+		if (RecordsFull() || start + length - m_textTail.load(std::memory_order_acquire) > TextCapacity)
+		{
+			return nullptr;
+		}
+		m_textStart = start;
+		return m_text.get() + start % TextCapacity;
+	}
+
+	void PublishText(int64_t timestamp, size_t length)
+	{
+		EventRecord& event = m_records[m_head.load(std::memory_order_relaxed) & (Capacity - 1)];
+		event = {};
+		event.timestamp = timestamp;
+		event.kind = EventKind::Text;
+		event.textOffset = static_cast<uint32_t>(m_textStart % TextCapacity);
+		event.textLength = static_cast<uint16_t>(length);
+		m_textHead = m_textStart + length;
+		Publish();
+	}
+
+	void Publish()
+	{
+		m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	std::unique_ptr<EventRecord[]> m_records{ new EventRecord[Capacity] };
+	std::unique_ptr<char[]> m_text{ new char[TextCapacity] };
+	// Producer side of the text buffer.
+	uint64_t m_textHead = 0;
+	uint64_t m_textStart = 0;
+	alignas(64) std::atomic<size_t> m_head{ 0 };
+	alignas(64) std::atomic<size_t> m_tail{ 0 };
+	alignas(64) std::atomic<uint64_t> m_textTail{ 0 };
+};
+
+// Destination for drained events.
+class EventSink
+{
+public:
+	virtual ~EventSink() = default;
+	// Called for every event in order; `text` is the line of a Text event.
+	virtual void Append(const EventRecord& event, std::string_view text) = 0;
+	// Called after every drain.
+	virtual void Flush() {}
+};
+
+// Renders events to text lines and hands them to a LogSink in one batch per
+// flush. The batch is reused, so rendering only allocates while it grows.
+class TextEventSink final : public EventSink
+{
+public:
+	explicit TextEventSink(LogSink& output, std::string_view lineEnding = "\n") : m_output(output), m_lineEnding(lineEnding) {}
+
+	void Append(const EventRecord& event, std::string_view text) override
+	{
+		if (event.kind == EventKind::Text)
+		{
+			Log(text);
+			return;
+		}
+		LogMessage(*this, EventTraceRecord(event), event.terse, event.throttled);
+	}
+
+	void Flush() override
+	{
+		if (!m_batch.empty())
+		{
+			m_output.Append(m_batch);
+			m_batch.clear();
+		}
+	}
+
+	// The Logger interface LogMessage writes through.
+	void Log(std::string_view line)
+	{
+		m_batch.append(line);
+		m_batch.append(m_lineEnding);
+	}
+
+	template <typename... T>
+	void Log(fmt::format_string<T...> format, T&&... args)
+	{
+		fmt::format_to(std::back_inserter(m_batch), format, std::forward<T>(args)...);
+		m_batch.append(m_lineEnding);
+	}
+
+private:
+	LogSink& m_output;
+	std::string_view m_lineEnding;
+	std::string m_batch;
+};
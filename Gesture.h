@@ -0,0 +1,140 @@
+#pragma once
+
+#include "Injection.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// A point on a gesture's timeline. Position, pressure and tilt are linearly
+// interpolated between keyframes; contact is a step function that holds the
+// value of the most recent keyframe.
+struct GestureKeyframe
+{
+	std::chrono::nanoseconds time;
+	int32_t x;
+	int32_t y;
+	uint32_t pressure;
+	int32_t tiltX;
+	int32_t tiltY;
+	bool contact;
+};
+
+// Declarative description of a single-pointer gesture, sampled at a fixed
+// frame rate by CompileGesture.
+struct Gesture
+{
+	POINTER_INPUT_TYPE pointerType = PT_PEN;
+	uint32_t pointerId = 0;
+	double frameRate = 100.0;
+	bool primary = true;
+	uint32_t penMask = PEN_MASK_PRESSURE;
+	std::vector<GestureKeyframe> keyframes;
+};
+
+// Pointer flags and button transition for a contact, given whether it is
+// touching now and whether it was in the previous frame.
+inline void SetContactState(InjectContact& contact, POINTER_INPUT_TYPE pointerType, bool primary, bool inContact, bool wasInContact)
+{
+	contact.pointerFlags = POINTER_FLAG_INRANGE;
+	if (primary)
+	{
+		contact.pointerFlags |= POINTER_FLAG_PRIMARY;
+	}
+	if (inContact)
+	{
+		contact.pointerFlags |= POINTER_FLAG_INCONTACT | POINTER_FLAG_FIRSTBUTTON;
+	}
+
+	contact.buttonChangeType = POINTER_CHANGE_NONE;
+	if (inContact && !wasInContact)
+	{
+		contact.buttonChangeType = POINTER_CHANGE_FIRSTBUTTON_DOWN;
+	}
+	else if (!inContact && wasInContact)
+	{
+		contact.buttonChangeType = POINTER_CHANGE_FIRSTBUTTON_UP;
+	}
+
+	// Touch injection requires the transition flags; pen injection infers
+	// them from the button change.
+	if (pointerType == PT_TOUCH)
+	{
+		if (contact.buttonChangeType == POINTER_CHANGE_FIRSTBUTTON_DOWN)
+		{
+			contact.pointerFlags |= POINTER_FLAG_DOWN;
+		}
+		else if (contact.buttonChangeType == POINTER_CHANGE_FIRSTBUTTON_UP)
+		{
+			contact.pointerFlags |= POINTER_FLAG_UP;
+		}
+		else
+		{
+			contact.pointerFlags |= POINTER_FLAG_UPDATE;
+		}
+	}
+}
+
+inline InjectContact SampleGesture(const Gesture& gesture, std::chrono::nanoseconds time)
+{
+	const auto& keys = gesture.keyframes;
+	size_t next = 0;
+	while (next < keys.size() && keys[next].time <= time)
+	{
+		next++;
+	}
+	const GestureKeyframe& a = keys[next == 0 ? 0 : next - 1];
+	const GestureKeyframe& b = keys[next == keys.size() ? keys.size() - 1 : next];
+	const double span = static_cast<double>((b.time - a.time).count());
+	const double t = span > 0 ? static_cast<double>((time - a.time).count()) / span : 0.0;
+	const auto lerp = [t](auto from, auto to)
+	{
+		return static_cast<decltype(from)>(std::lround(from + (static_cast<double>(to) - from) * t));
+	};
+
+	InjectContact contact{};
+	contact.pointerId = gesture.pointerId;
+	contact.x = lerp(a.x, b.x);
+	contact.y = lerp(a.y, b.y);
+	contact.pressure = lerp(a.pressure, b.pressure);
+	contact.tiltX = lerp(a.tiltX, b.tiltX);
+	contact.tiltY = lerp(a.tiltY, b.tiltY);
+	contact.penMask = gesture.penMask;
+	contact.penFlags = PEN_FLAG_NONE;
+	// Carried to CompileGesture, which derives the full flag set.
+	contact.pointerFlags = a.contact ? POINTER_FLAG_INCONTACT : 0;
+	return contact;
+}
+
+// Samples a gesture at its frame rate into a plan of single-contact frames.
+inline InjectPlan CompileGesture(const Gesture& gesture)
+{
+	InjectPlan plan{};
+	plan.pointerType = gesture.pointerType;
+	plan.maxContacts = 1;
+	if (gesture.keyframes.empty() || gesture.frameRate <= 0)
+	{
+		return plan;
+	}
+
+	const double interval = 1e9 / gesture.frameRate;
+	const auto duration = gesture.keyframes.back().time - gesture.keyframes.front().time;
+	const size_t frameCount = static_cast<size_t>(std::floor(static_cast<double>(duration.count()) / interval + 1e-9)) + 1;
+	plan.settle = std::chrono::nanoseconds(std::llround(interval));
+	plan.frames.reserve(frameCount);
+	plan.contacts.reserve(frameCount);
+
+	bool wasInContact = false;
+	for (size_t i = 0; i < frameCount; i++)
+	{
+		const auto offset = std::chrono::nanoseconds(std::llround(static_cast<double>(i) * interval));
+		InjectContact contact = SampleGesture(gesture, gesture.keyframes.front().time + offset);
+		const bool inContact = (contact.pointerFlags & POINTER_FLAG_INCONTACT) != 0;
+		SetContactState(contact, gesture.pointerType, gesture.primary, inContact, wasInContact);
+		wasInContact = inContact;
+
+		plan.frames.push_back({ offset, static_cast<uint32_t>(plan.contacts.size()), 1 });
+		plan.contacts.push_back(contact);
+	}
+	return plan;
+}
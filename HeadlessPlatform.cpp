@@ -0,0 +1,57 @@
+#include "HeadlessPlatform.h"
+#include <chrono>
+
+int64_t HeadlessPlatform::Timestamp()
+{
+	if (m_replaying)
+	{
+		return m_replayTime;
+	}
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t HeadlessPlatform::TimestampFrequency()
+{
+	return m_replaying ? m_replayFrequency : 1000000000;
+}
+
+void HeadlessPlatform::CaptureDetails(TraceRecord&, bool)
+{
+}
+
+std::unique_ptr<InjectionBackend> HeadlessPlatform::CreateInjectionBackend()
+{
+	return std::make_unique<RecordingInjectionBackend>();
+}
+
+std::vector<TraceRecord> SyntheticMessages(size_t count)
+{
+	std::vector<TraceRecord> records;
+	records.reserve(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		TraceRecord record{};
+		const auto x = static_cast<WORD>(100 + i % 500);
+		const auto y = static_cast<WORD>(100 + (i / 500) % 400);
+		switch (i % 64)
+		{
+		case 0:
+			record.message = WM_POINTERDOWN;
+			record.wParam = MAKELONG(1, POINTER_MESSAGE_FLAG_INRANGE | POINTER_MESSAGE_FLAG_INCONTACT | POINTER_MESSAGE_FLAG_FIRSTBUTTON | POINTER_MESSAGE_FLAG_PRIMARY);
+			break;
+		case 63:
+			record.message = WM_POINTERUP;
+			record.wParam = MAKELONG(1, POINTER_MESSAGE_FLAG_INRANGE | POINTER_MESSAGE_FLAG_PRIMARY);
+			break;
+		default:
+			record.message = i % 2 ? WM_POINTERUPDATE : WM_MOUSEMOVE;
+			record.wParam = i % 2 ? MAKELONG(1, POINTER_MESSAGE_FLAG_INRANGE | POINTER_MESSAGE_FLAG_INCONTACT | POINTER_MESSAGE_FLAG_FIRSTBUTTON | POINTER_MESSAGE_FLAG_PRIMARY) : MK_LBUTTON;
+			break;
+		}
+		record.lParam = MAKELONG(x, y);
+		// 240 Hz, in HeadlessPlatform timestamp ticks.
+		record.timestamp = static_cast<int64_t>(i) * 4166667;
+		records.push_back(record);
+	}
+	return records;
+}
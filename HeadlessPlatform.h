@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Platform.h"
+#include "Trace.h"
+#include <cstddef>
+#include <vector>
+
+// Stand-in platform for builds without a window: timestamps come from the
+// monotonic clock, or from the messages being replayed, messages carry nothing
+// beyond wParam/lParam, log output goes to the given sink and injected frames
+// are only recorded.
+class HeadlessPlatform final : public Platform
+{
+public:
+	explicit HeadlessPlatform(LogSink& output) : m_output(output) {}
+
+	int64_t Timestamp() override;
+	int64_t TimestampFrequency() override;
+	void CaptureDetails(TraceRecord& record, bool detailed) override;
+	LogSink& Output() override { return m_output; }
+	std::unique_ptr<InjectionBackend> CreateInjectionBackend() override;
+
+	// From now on, Timestamp returns `timestamp` in ticks of `frequency`
+	// instead of reading the clock; called before every replayed message so
+	// that the pipeline runs on the time it was recorded at.
+	void SetReplayTime(int64_t timestamp, int64_t frequency)
+	{
+		m_replaying = true;
+		m_replayTime = timestamp;
+		m_replayFrequency = frequency;
+	}
+
+private:
+	LogSink& m_output;
+	bool m_replaying = false;
+	int64_t m_replayTime = 0;
+	int64_t m_replayFrequency = 0;
+};
+
+// `count` messages of back-to-back contacts, 64 messages each: pointer down,
+// pointer updates interleaved with the mouse moves they are promoted to, then
+// pointer up, at 240 Hz in HeadlessPlatform timestamp ticks.
+std::vector<TraceRecord> SyntheticMessages(size_t count);
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "WinCompat.h"
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// One pointer within an injected frame. Field names follow POINTER_INFO /
+// POINTER_PEN_INFO / POINTER_TOUCH_INFO; the backend decides which of them
+// apply for the device's pointer type.
+struct InjectContact
+{
+	uint32_t pointerId;
+	uint32_t pointerFlags;
+	uint32_t buttonChangeType;
+	int32_t x;
+	int32_t y;
+	uint32_t pressure;
+	uint32_t rotation;
+	int32_t tiltX;
+	int32_t tiltY;
+	uint32_t penMask;
+	uint32_t penFlags;
+};
+
+struct InjectFrame
+{
+	// Offset from the start of playback.
+	std::chrono::nanoseconds time;
+	uint32_t firstContact;
+	uint32_t contactCount;
+};
+
+// A compiled, ready-to-play sequence of frames. Contacts for all frames live in
+// one array so that a frame can be handed to the backend without copying.
+struct InjectPlan
+{
+	POINTER_INPUT_TYPE pointerType = PT_PEN;
+	uint32_t maxContacts = 1;
+	POINTER_FEEDBACK_MODE feedback = POINTER_FEEDBACK_DEFAULT;
+	// How long to wait after the last frame before the device may be released.
+	std::chrono::nanoseconds settle{ 0 };
+	std::vector<InjectFrame> frames;
+	std::vector<InjectContact> contacts;
+
+	const InjectContact* Contacts(const InjectFrame& frame) const { return contacts.data() + frame.firstContact; }
+};
+
+// Destination for injected frames; implemented on top of the user32 synthetic
+// pointer API or the win32u syscalls on Windows, and by stand-ins elsewhere.
+class InjectionBackend
+{
+public:
+	virtual ~InjectionBackend() = default;
+	virtual bool Open(POINTER_INPUT_TYPE pointerType, uint32_t maxContacts, POINTER_FEEDBACK_MODE feedback) = 0;
+	virtual bool Inject(const InjectContact* contacts, uint32_t count) = 0;
+	virtual void Close() = 0;
+};
+
+// Backend that keeps every frame it is given along with the time it arrived.
+class RecordingInjectionBackend final : public InjectionBackend
+{
+public:
+	struct Entry
+	{
+		std::chrono::steady_clock::time_point time;
+		uint32_t firstContact;
+		uint32_t contactCount;
+	};
+
+	bool Open(POINTER_INPUT_TYPE pointerType, uint32_t maxContacts, POINTER_FEEDBACK_MODE feedback) override
+	{
+		m_pointerType = pointerType;
+		m_maxContacts = maxContacts;
+		m_feedback = feedback;
+		m_open = true;
+		return true;
+	}
+
+	bool Inject(const InjectContact* contacts, uint32_t count) override
+	{
+		if (!m_open || count > m_maxContacts)
+		{
+			return false;
+		}
+		m_entries.push_back({ std::chrono::steady_clock::now(), static_cast<uint32_t>(m_contacts.size()), count });
+		m_contacts.insert(m_contacts.end(), contacts, contacts + count);
+		return true;
+	}
+
+	void Close() override { m_open = false; }
+
+	POINTER_INPUT_TYPE PointerType() const { return m_pointerType; }
+	POINTER_FEEDBACK_MODE Feedback() const { return m_feedback; }
+	const std::vector<Entry>& Entries() const { return m_entries; }
+	const std::vector<InjectContact>& Contacts() const { return m_contacts; }
+
+private:
+	POINTER_INPUT_TYPE m_pointerType = PT_PEN;
+	uint32_t m_maxContacts = 0;
+	POINTER_FEEDBACK_MODE m_feedback = POINTER_FEEDBACK_DEFAULT;
+	bool m_open = false;
+	std::vector<Entry> m_entries;
+	std::vector<InjectContact> m_contacts;
+};
+
+// Waits by sleeping until shortly before the deadline and then spinning, since
+// the OS sleep granularity is far coarser than a frame at high report rates.
+struct SteadyClock
+{
+	using time_point = std::chrono::steady_clock::time_point;
+
+	constexpr static std::chrono::microseconds SPIN_MARGIN{ 2000 };
+
+	static time_point Now() { return std::chrono::steady_clock::now(); }
+
+	static void SleepUntil(time_point deadline)
+	{
+		if (deadline - Now() > SPIN_MARGIN)
+		{
+			std::this_thread::sleep_until(deadline - SPIN_MARGIN);
+		}
+		while (Now() < deadline)
+		{
+			std::this_thread::yield();
+		}
+	}
+};
+
+struct PlayStats
+{
+	size_t played = 0;
+	size_t failed = 0;
+	// Time from the start of playback to the first and last injected frame.
+	std::chrono::nanoseconds firstFrame{ 0 };
+	std::chrono::nanoseconds lastFrame{ 0 };
+	// Worst delay between a frame's scheduled time and its injection.
+	std::chrono::nanoseconds maxLateness{ 0 };
+
+	// Frames per second actually achieved between the first and last frame.
+	double AchievedRate() const
+	{
+		const auto span = std::chrono::duration<double>(lastFrame - firstFrame).count();
+		return played > 1 && span > 0 ? static_cast<double>(played - 1) / span : 0.0;
+	}
+};
+
+// Plays a plan through an already opened backend. Every frame is scheduled
+// against the absolute start time, so late wake-ups do not accumulate into
+// drift the way chained Sleep calls do. `cancelled` is polled between frames.
+template <typename Clock = SteadyClock, typename CancelFn>
+PlayStats PlayPlan(const InjectPlan& plan, InjectionBackend& backend, CancelFn&& cancelled)
+{
+	PlayStats stats{};
+	const auto start = Clock::Now();
+	for (const InjectFrame& frame : plan.frames)
+	{
+		if (cancelled())
+		{
+			return stats;
+		}
+		Clock::SleepUntil(start + frame.time);
+		const auto injected = Clock::Now() - start;
+		if (!backend.Inject(plan.Contacts(frame), frame.contactCount))
+		{
+			stats.failed++;
+			continue;
+		}
+		if (stats.played++ == 0)
+		{
+			stats.firstFrame = injected;
+		}
+		stats.lastFrame = injected;
+		if (injected - frame.time > stats.maxLateness)
+		{
+			stats.maxLateness = injected - frame.time;
+		}
+	}
+	if (!plan.frames.empty())
+	{
+		Clock::SleepUntil(start + plan.frames.back().time + plan.settle);
+	}
+	return stats;
+}
+
+template <typename Clock = SteadyClock>
+PlayStats PlayPlan(const InjectPlan& plan, InjectionBackend& backend)
+{
+	return PlayPlan<Clock>(plan, backend, []() { return false; });
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "DevicePool.h"
+#include "Injection.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+enum class InjectStatus : uint8_t
+{
+	Completed,
+	Cancelled,
+	// The backend could not open a device for the plan.
+	DeviceFailed,
+};
+
+struct InjectCompletion
+{
+	uint64_t id = 0;
+	InjectStatus status = InjectStatus::Completed;
+	// Whether the plan ran on a pooled device rather than a new one.
+	bool reusedDevice = false;
+	PlayStats stats{};
+};
+
+// Plays injection plans one after another on a single long-lived thread.
+//
+// Commands wait in a bounded queue; Submit refuses new ones once it is full
+// rather than letting a burst of requests pile up. Devices are leased from
+// `devices` for each plan, so consecutive plans for the same kind of device
+// share one, unless the plan comes with a lease of its own from another pool. `done` is called on the worker thread for every command,
+// including cancelled ones, and must not call back into the worker.
+template <typename Clock = SteadyClock>
+class InjectionWorker
+{
+public:
+	constexpr static size_t QUEUE_CAPACITY = 8;
+
+	using CompletionFn = std::function<void(const InjectCompletion&)>;
+
+	InjectionWorker(DevicePool& devices, CompletionFn done, size_t capacity = QUEUE_CAPACITY)
+		: m_devices(devices), m_done(std::move(done)), m_queue(capacity ? capacity : 1)
+	{
+		m_thread = std::thread([this]() { Run(); });
+	}
+
+	InjectionWorker(const InjectionWorker&) = delete;
+	InjectionWorker& operator=(const InjectionWorker&) = delete;
+
+	// Cancels everything outstanding and waits for the worker to finish.
+	~InjectionWorker()
+	{
+		{
+			std::lock_guard lock{ m_mutex };
+			m_stopping = true;
+			m_cancelRunning.store(true, std::memory_order_relaxed);
+		}
+		m_wake.notify_one();
+		m_thread.join();
+	}
+
+	// Returns the command id, or 0 when the queue is full. A plan submitted
+	// with a lease is played on that device, which is released on the worker
+	// once the plan has finished or been cancelled.
+	uint64_t Submit(InjectPlan plan, DeviceLease lease = {})
+	{
+		uint64_t id = 0;
+		{
+			std::lock_guard lock{ m_mutex };
+			if (m_stopping || m_count == m_queue.size())
+			{
+				return 0;
+			}
+			id = ++m_lastId;
+			m_queue[(m_head + m_count) % m_queue.size()] = { id, std::move(plan), std::move(lease) };
+			m_count++;
+		}
+		m_wake.notify_one();
+		return id;
+	}
+
+	// Cancels a queued or running command. Returns false when it has already
+	// finished.
+	bool Cancel(uint64_t id)
+	{
+		std::lock_guard lock{ m_mutex };
+		if (id != 0 && id == m_running)
+		{
+			m_cancelRunning.store(true, std::memory_order_relaxed);
+			return true;
+		}
+		for (size_t i = 0; i < m_count; i++)
+		{
+			Command& command = m_queue[(m_head + i) % m_queue.size()];
+			if (command.id == id)
+			{
+				command.cancelled = true;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void CancelAll()
+	{
+		std::lock_guard lock{ m_mutex };
+		m_cancelRunning.store(m_running != 0, std::memory_order_relaxed);
+		for (size_t i = 0; i < m_count; i++)
+		{
+			m_queue[(m_head + i) % m_queue.size()].cancelled = true;
+		}
+	}
+
+	// Commands queued or running.
+	size_t Pending() const
+	{
+		std::lock_guard lock{ m_mutex };
+		return m_count + (m_running != 0);
+	}
+
+	size_t Capacity() const { return m_queue.size(); }
+
+private:
+	struct Command
+	{
+		uint64_t id = 0;
+		InjectPlan plan{};
+		DeviceLease lease{};
+		bool cancelled = false;
+	};
+
+	void Run()
+	{
+		for (;;)
+		{
+			Command command{};
+			{
+				std::unique_lock lock{ m_mutex };
+				m_running = 0;
+				m_wake.wait(lock, [this]() { return m_stopping || m_count > 0; });
+				if (m_count == 0)
+				{
+					break;
+				}
+				command = std::move(m_queue[m_head]);
+				m_queue[m_head] = {};
+				m_head = (m_head + 1) % m_queue.size();
+				m_count--;
+				m_cancelRunning.store(false, std::memory_order_relaxed);
+				if (!command.cancelled && !m_stopping)
+				{
+					m_running = command.id;
+				}
+			}
+
+			InjectCompletion completion{};
+			completion.id = command.id;
+			if (m_running == 0)
+			{
+				completion.status = InjectStatus::Cancelled;
+			}
+			else
+			{
+				Play(command, completion);
+			}
+			command.lease.Release();
+			m_done(completion);
+		}
+	}
+
+	void Play(Command& command, InjectCompletion& completion)
+	{
+		const InjectPlan& plan = command.plan;
+		DeviceLease lease = command.lease ? std::move(command.lease) : m_devices.Acquire(PlanDeviceKey(plan));
+		if (!lease)
+		{
+			completion.status = InjectStatus::DeviceFailed;
+			return;
+		}
+		completion.reusedDevice = lease.Reused();
+		completion.stats = PlayPlan<Clock>(plan, lease.Backend(), [this]() { return m_cancelRunning.load(std::memory_order_relaxed); });
+		if (m_cancelRunning.load(std::memory_order_relaxed))
+		{
+			completion.status = InjectStatus::Cancelled;
+		}
+	}
+
+	DevicePool& m_devices;
+	CompletionFn m_done;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::vector<Command> m_queue;
+	size_t m_head = 0;
+	size_t m_count = 0;
+	uint64_t m_lastId = 0;
+	// Id of the command being played, 0 when idle or skipping a cancelled one.
+	uint64_t m_running = 0;
+	bool m_stopping = false;
+	std::atomic<bool> m_cancelRunning{ false };
+
+	// Started last, once everything it uses is constructed.
+	std::thread m_thread;
+};
@@ -0,0 +1,240 @@
+#pragma once
+
+#include "Decode.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+// Converts a QueryPerformanceCounter-style tick count without overflowing for
+// large tick values.
+constexpr int64_t TicksToNanoseconds(int64_t ticks, int64_t frequency)
+{
+	return ticks / frequency * 1000000000 + ticks % frequency * 1000000000 / frequency;
+}
+
+// Log-linear histogram in the style of HdrHistogram. Values below 2^SUB_BITS
+// are counted exactly; above that every power of two is split into 2^SUB_BITS
+// buckets, giving a relative error of at most 1 / 2^SUB_BITS. Values are
+// nanoseconds and saturate at 2^MAX_BITS (about 68 seconds).
+class LatencyHistogram
+{
+public:
+	constexpr static int SUB_BITS = 5;
+	constexpr static int MAX_BITS = 36;
+	constexpr static uint64_t SUB_COUNT = 1ull << SUB_BITS;
+	constexpr static size_t BUCKET_COUNT = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+	static size_t BucketIndex(uint64_t value)
+	{
+		value = std::min<uint64_t>(value, (1ull << MAX_BITS) - 1);
+		if (value < SUB_COUNT)
+		{
+			return static_cast<size_t>(value);
+		}
+		const int shift = std::bit_width(value) - 1 - SUB_BITS;
+		return static_cast<size_t>((shift + 1) * SUB_COUNT + ((value >> shift) - SUB_COUNT));
+	}
+
+	// Largest value that maps to the bucket.
+	static uint64_t BucketValue(size_t index)
+	{
+		if (index < SUB_COUNT)
+		{
+			return index;
+		}
+		const int shift = static_cast<int>(index / SUB_COUNT) - 1;
+		const uint64_t lower = (SUB_COUNT + index % SUB_COUNT) << shift;
+		return lower + (1ull << shift) - 1;
+	}
+
+	void Record(int64_t value)
+	{
+		if (m_counts.empty())
+		{
+			m_counts.resize(BUCKET_COUNT);
+		}
+		const uint64_t v = value < 0 ? 0 : static_cast<uint64_t>(value);
+		m_counts[BucketIndex(v)]++;
+		m_min = m_count == 0 ? v : std::min<uint64_t>(m_min, v);
+		m_max = std::max<uint64_t>(m_max, v);
+		m_total += v;
+		m_count++;
+	}
+
+	void Merge(const LatencyHistogram& other)
+	{
+		if (other.m_count == 0)
+		{
+			return;
+		}
+		if (m_counts.empty())
+		{
+			m_counts.resize(BUCKET_COUNT);
+		}
+		for (size_t i = 0; i < BUCKET_COUNT; i++)
+		{
+			m_counts[i] += other.m_counts[i];
+		}
+		m_min = m_count == 0 ? other.m_min : std::min<uint64_t>(m_min, other.m_min);
+		m_max = std::max<uint64_t>(m_max, other.m_max);
+		m_total += other.m_total;
+		m_count += other.m_count;
+	}
+
+	void Reset()
+	{
+		std::fill(m_counts.begin(), m_counts.end(), 0);
+		m_count = 0;
+		m_total = 0;
+		m_min = 0;
+		m_max = 0;
+	}
+
+	// Value at or below which `percentile` percent of samples fall.
+	uint64_t Percentile(double percentile) const
+	{
+		if (m_count == 0)
+		{
+			return 0;
+		}
+		const double clamped = std::clamp<double>(percentile, 0.0, 100.0);
+		const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(clamped / 100.0 * static_cast<double>(m_count) + 0.5));
+		uint64_t seen = 0;
+		for (size_t i = 0; i < BUCKET_COUNT; i++)
+		{
+			seen += m_counts[i];
+			if (seen >= target)
+			{
+				return std::min<uint64_t>(BucketValue(i), m_max);
+			}
+		}
+		return m_max;
+	}
+
+	uint64_t Count() const { return m_count; }
+	uint64_t Min() const { return m_min; }
+	uint64_t Max() const { return m_max; }
+	uint64_t Mean() const { return m_count ? m_total / m_count : 0; }
+
+private:
+	std::vector<uint64_t> m_counts;
+	uint64_t m_count = 0;
+	uint64_t m_total = 0;
+	uint64_t m_min = 0;
+	uint64_t m_max = 0;
+};
+
+// Collects delivery latency of stamped pointer frames per message type.
+// Pointer messages carry their own injection stamp. Promoted mouse messages do
+// not, so every stamped frame of a primary pointer is kept pending, keyed by
+// pointer and frame id, until a promoted message is delivered at its position.
+// That frame then also feeds a histogram of the pointer-to-mouse promotion
+// delay, and the frames pending before it were coalesced away.
+class LatencyTracker
+{
+public:
+	// Frames awaiting promotion; the oldest are dropped beyond this.
+	constexpr static size_t MAX_PENDING = 64;
+
+	// `stamped` is the injection time recovered from the frame, or 0 when the
+	// frame was not stamped. `x` and `y` are where a mouse message promoted
+	// from it would be delivered.
+	void OnPointerMessage(UINT uMsg, uint32_t pointerId, uint32_t frameId, bool primary, int32_t x, int32_t y, int64_t stamped, int64_t now)
+	{
+		if (stamped == 0)
+		{
+			return;
+		}
+		if (LatencyHistogram* histogram = Find(uMsg))
+		{
+			histogram->Record(now - stamped);
+		}
+		// Several messages (enter, down, update...) can share one frame;
+		// promotion is measured from the first of them.
+		const bool pending = std::any_of(m_pending.begin(), m_pending.end(), [&](const Frame& frame) { return frame.pointerId == pointerId && frame.frameId == frameId; });
+		if (primary && !pending)
+		{
+			if (m_pending.size() == MAX_PENDING)
+			{
+				m_pending.erase(m_pending.begin());
+			}
+			m_pending.push_back({ pointerId, frameId, x, y, stamped, now });
+		}
+	}
+
+	// Returns false when no pending frame was delivered at the position.
+	bool OnPromotedMouseMessage(UINT uMsg, int32_t x, int32_t y, int64_t now)
+	{
+		const auto frame = std::find_if(m_pending.begin(), m_pending.end(), [&](const Frame& pending) { return pending.x == x && pending.y == y; });
+		if (frame == m_pending.end())
+		{
+			m_unmatched++;
+			return false;
+		}
+		if (LatencyHistogram* histogram = Find(uMsg))
+		{
+			histogram->Record(now - frame->stamped);
+		}
+		m_promotion.Record(now - frame->arrived);
+		// The frame stays pending for the other messages promoted from it,
+		// such as a button press following the move.
+		m_pending.erase(m_pending.begin(), frame);
+		return true;
+	}
+
+	const LatencyHistogram& Promotion() const { return m_promotion; }
+	// Promoted messages that matched no pending frame.
+	uint64_t Unmatched() const { return m_unmatched; }
+
+	// Calls `callback(info, histogram)` for every message type with samples.
+	template <typename Callback>
+	void ForEach(Callback&& callback) const
+	{
+		for (size_t i = 0; i < g_MessageCount; i++)
+		{
+			if (m_histograms[i].Count() > 0)
+			{
+				callback(g_Messages[i], m_histograms[i]);
+			}
+		}
+	}
+
+	void Reset()
+	{
+		for (LatencyHistogram& histogram : m_histograms)
+		{
+			histogram.Reset();
+		}
+		m_promotion.Reset();
+		m_pending.clear();
+		m_unmatched = 0;
+	}
+
+private:
+	struct Frame
+	{
+		uint32_t pointerId = 0;
+		uint32_t frameId = 0;
+		int32_t x = 0;
+		int32_t y = 0;
+		int64_t stamped = 0;
+		int64_t arrived = 0;
+	};
+
+	LatencyHistogram* Find(UINT uMsg)
+	{
+		if (uMsg >= g_MessageIndexSize || g_MessageIndex[uMsg] == g_NoMessage)
+		{
+			return nullptr;
+		}
+		return &m_histograms[g_MessageIndex[uMsg]];
+	}
+
+	std::array<LatencyHistogram, g_MessageCount> m_histograms{};
+	LatencyHistogram m_promotion{};
+	// Oldest first.
+	std::vector<Frame> m_pending;
+	uint64_t m_unmatched = 0;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "LogSink.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+// The longest prefix of `text` no more than `length` bytes long that does not
+// end inside a UTF-8 sequence.
+constexpr std::string_view Utf8Prefix(std::string_view text, size_t length)
+{
+	if (text.size() <= length)
+	{
+		return text;
+	}
+	// Back off over continuation bytes to the lead byte of the sequence that
+	// would be cut.
+	size_t end = length;
+	while (end > 0 && (static_cast<uint8_t>(text[end]) & 0xC0) == 0x80)
+	{
+		end--;
+	}
+	return text.substr(0, end);
+}
+
+// Bounded scrollback for the log view. Line text lives in a fixed circular
+// byte arena and every line has a fixed slot in a circular index, so memory is
+// allocated once and appending costs the same however long the session runs.
+// When either the arena or the index is full, the oldest lines are evicted.
+//
+// Lines are addressed by their position from the oldest retained line, which
+// is what a virtualized list view asks for when it draws an item.
+template <size_t LineCapacity = (1 << 16), size_t TextCapacity = (1 << 23)>
+class LogHistory final : public LogSink
+{
+	static_assert((LineCapacity & (LineCapacity - 1)) == 0, "LineCapacity must be a power of two");
+	static_assert(TextCapacity >= UINT16_MAX, "TextCapacity must hold the longest line");
+
+public:
+	// Splits a batch into lines; a trailing "\r" of each line is dropped.
+	void Append(std::string_view batch) override
+	{
+		while (!batch.empty())
+		{
+			const size_t end = batch.find('\n');
+			std::string_view line = batch.substr(0, end);
+			if (!line.empty() && line.back() == '\r')
+			{
+				line.remove_suffix(1);
+			}
+			AppendLine(line);
+			if (end == std::string_view::npos)
+			{
+				break;
+			}
+			batch.remove_prefix(end + 1);
+		}
+	}
+
+	void AppendLine(std::string_view line)
+	{
+		const size_t length = line.size() < UINT16_MAX ? line.size() : UINT16_MAX;
+
+		// A line never wraps around the end of the arena; if it does not fit
+		// in what is left, it starts over at the beginning.
+		uint64_t start = m_textHead;
+		if (start % TextCapacity + length > TextCapacity)
+		{
+			start += TextCapacity - start % TextCapacity;
+		}
+		while (Size() > 0 && (Size() == LineCapacity || start + length - Slot(0).start > TextCapacity))
+		{
+			m_first++;
+		}
+
+		line.copy(m_text.get() + start % TextCapacity, length);
+		m_lines[m_next & (LineCapacity - 1)] = { start, static_cast<uint16_t>(length) };
+		m_next++;
+		m_textHead = start + length;
+	}
+
+	// The index-th retained line, counting from the oldest one.
+	std::string_view Line(size_t index) const
+	{
+		const Entry& entry = Slot(index);
+		return { m_text.get() + entry.start % TextCapacity, entry.length };
+	}
+
+	size_t Size() const { return static_cast<size_t>(m_next - m_first); }
+	bool Empty() const { return m_next == m_first; }
+	// Lines appended since construction, including evicted ones.
+	uint64_t Total() const { return m_next; }
+	// Lines evicted since construction; also the sequence number of Line(0).
+	uint64_t Evicted() const { return m_first; }
+
+	void Clear()
+	{
+		m_first = m_next;
+	}
+
+private:
+	struct Entry
+	{
+		uint64_t start;
+		uint16_t length;
+	};
+
+	const Entry& Slot(size_t index) const { return m_lines[(m_first + index) & (LineCapacity - 1)]; }
+
+	std::unique_ptr<char[]> m_text{ new char[TextCapacity] };
+	std::unique_ptr<Entry[]> m_lines{ new Entry[LineCapacity] };
+	uint64_t m_textHead = 0;
+	uint64_t m_first = 0;
+	uint64_t m_next = 0;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Destination for batches of log lines. Implementations receive every line
+// drained by a single flush in one call, already newline-terminated.
+class LogSink
+{
+public:
+	virtual ~LogSink() = default;
+	virtual void Append(std::string_view batch) = 0;
+};
+
+// Headless sink that only counts what it receives; used to measure the
+// throughput of the logging pipeline without any UI attached.
+class CountingLogSink final : public LogSink
+{
+public:
+	void Append(std::string_view batch) override
+	{
+		m_bytes += batch.size();
+		m_batches++;
+	}
+
+	size_t Bytes() const { return m_bytes; }
+	size_t Batches() const { return m_batches; }
+
+private:
+	size_t m_bytes = 0;
+	size_t m_batches = 0;
+};
+
+// Sink that keeps everything in memory.
+class StringLogSink final : public LogSink
+{
+public:
+	void Append(std::string_view batch) override { m_text.append(batch); }
+
+	const std::string& Text() const { return m_text; }
+	void Clear() { m_text.clear(); }
+
+private:
+	std::string m_text;
+};
@@ -0,0 +1,395 @@
+#include "AllocationCount.h"
+#include "HeadlessPlatform.h"
+#include "Latency.h"
+#include "LogSink.h"
+#include "MessageHandler.h"
+#include "Pipeline.h"
+#include "Syscalls.h"
+#include "Trace.h"
+#include <fmt/core.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Drives the demo window's message handling with recorded or synthetic
+// messages on the headless platform, once for every combination of the Terse,
+// Throttle, Motion Events, Ret 0 on WM_POINTER* and Call
+// NtUserPromoteMouseInPointer checkboxes, and reports the cost, heap
+// allocations and 99th percentile latency per message. Messages the window
+// would pass on go to a DefWindowProc that only counts them, promotion goes to
+// a mock syscall table, and messages are stamped, throttled and flushed on the
+// demo's 16 ms timer by their recorded timestamps.
+//
+// With a baseline, exits with 1 when any combination allocates more per
+// message than the baseline. Allocation counts do not depend on the machine,
+// so the baseline checked in has only those. Timings are compared only for
+// rows that also have them, which --write-baseline records and which are only
+// meaningful on the machine that wrote them: a combination then regresses
+// when it is slower or has a higher p99 by more than the tolerance plus the
+// noise floor, and only when at least MIN_TIMING_ROUNDS rounds were run.
+//
+//     WmPointerMessageBenchmark [--count N] [--rounds 5] [--baseline FILE] [--write-baseline FILE] [--tolerance 0.25] [--noise-floor 50] [trace.wmpt]
+
+static uint64_t g_Promotions = 0;
+static uint64_t g_DefaultCalls = 0;
+
+static int WINAPI MockPromoteMouseInPointer(int)
+{
+	g_Promotions++;
+	return 1;
+}
+
+static int WINAPI MockPromotePointer(int, int)
+{
+	g_Promotions++;
+	return 1;
+}
+
+static LRESULT MockDefWindowProc(UINT, WPARAM, LPARAM)
+{
+	g_DefaultCalls++;
+	return 0;
+}
+
+constexpr UINT_PTR IDT_LOGFLUSH = 1;
+constexpr int64_t LOG_FLUSH_MILLISECONDS = 16;
+// Fewer rounds than this leave too much noise in the fastest of them.
+constexpr size_t MIN_TIMING_ROUNDS = 5;
+
+struct MessageConfig
+{
+	bool terse;
+	bool throttle;
+	MessageOptions options;
+
+	std::string Key() const
+	{
+		return fmt::format(
+			"terse={:d},throttle={:d},motion={:d},retzero={:d},promote={:d}",
+			terse,
+			throttle,
+			options.motionEnabled,
+			options.returnZeroOnWMPointer,
+			options.callPromoteMouseInPointer
+		);
+	}
+};
+
+struct MessageResults
+{
+	double nanoseconds = 0;
+	double allocations = 0;
+	uint64_t p99 = 0;
+	uint64_t messages = 0;
+	uint64_t returned = 0;
+	uint64_t defaulted = 0;
+	uint64_t promotions = 0;
+	uint64_t bytes = 0;
+};
+
+// The window procedure as the demo runs it for these messages: the handler
+// first, then the window's own switch, of which only the flush timer matters
+// here.
+static LRESULT Dispatch(MessageHandler& handler, EventPipeline& pipeline, UINT uMsg, WPARAM wParam, LPARAM lParam, MessageResults& results)
+{
+	const MessageResult handled = handler.Handle(uMsg, wParam, lParam);
+	switch (handled.action)
+	{
+	case MessageAction::Return:
+		results.returned++;
+		return handled.result;
+	case MessageAction::Default:
+		return MockDefWindowProc(uMsg, wParam, lParam);
+	case MessageAction::Continue:
+		break;
+	}
+
+	if (uMsg == WM_TIMER && wParam == IDT_LOGFLUSH)
+	{
+		pipeline.Tick();
+		return 0;
+	}
+	return MockDefWindowProc(uMsg, wParam, lParam);
+}
+
+// Each round is one pass over the records; the first grows the batch to its
+// working size and is not measured. The fastest of the other rounds is
+// reported, with the lowest p99 and the most allocations of any of them.
+static MessageResults Run(const MessageConfig& config, const std::vector<TraceRecord>& records, int64_t frequency, size_t rounds)
+{
+	CountingLogSink sink{};
+	HeadlessPlatform platform{ sink };
+	EventPipeline pipeline{ platform };
+	pipeline.SetTerse(config.terse);
+	pipeline.SetThrottling(config.throttle);
+	MessageHandler handler{ pipeline };
+	handler.Options() = config.options;
+
+	const int64_t tickInterval = frequency * LOG_FLUSH_MILLISECONDS / 1000;
+	// Every round replays the records a second after the previous one ended,
+	// so that throttling starts afresh rather than seeing time run backwards.
+	const int64_t span = records.empty() ? 0 : records.back().timestamp - records.front().timestamp + frequency;
+	MessageResults best{};
+	double allocated = 0;
+	uint64_t p99 = UINT64_MAX;
+	for (size_t round = 0; round <= rounds; round++)
+	{
+		MessageResults results{};
+		LatencyHistogram latency{};
+		const uint64_t bytes = sink.Bytes();
+		const uint64_t promotions = g_Promotions;
+		const uint64_t defaulted = g_DefaultCalls;
+		const uint64_t allocations = AllocationCount();
+		const auto start = std::chrono::steady_clock::now();
+		const int64_t offset = static_cast<int64_t>(round) * span;
+		int64_t nextTick = records.empty() ? 0 : records.front().timestamp + tickInterval;
+		for (const TraceRecord& record : records)
+		{
+			// The flush timer fires between messages, as WM_TIMER does.
+			const bool tick = record.timestamp >= nextTick;
+			if (tick)
+			{
+				nextTick = record.timestamp + tickInterval;
+			}
+			platform.SetReplayTime(record.timestamp + offset, frequency);
+			for (int i = tick ? 0 : 1; i < 2; i++)
+			{
+				const UINT uMsg = i == 0 ? WM_TIMER : record.message;
+				const WPARAM wParam = i == 0 ? IDT_LOGFLUSH : static_cast<WPARAM>(record.wParam);
+				const LPARAM lParam = i == 0 ? 0 : static_cast<LPARAM>(record.lParam);
+				const auto dispatched = std::chrono::steady_clock::now();
+				Dispatch(handler, pipeline, uMsg, wParam, lParam, results);
+				latency.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - dispatched).count());
+			}
+		}
+		pipeline.Tick();
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+		if (round == 0)
+		{
+			continue;
+		}
+
+		results.messages = latency.Count();
+		const double messages = static_cast<double>(results.messages ? results.messages : 1);
+		results.nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / messages;
+		results.allocations = static_cast<double>(AllocationCount() - allocations) / messages;
+		results.p99 = latency.Percentile(99);
+		results.promotions = g_Promotions - promotions;
+		results.defaulted = g_DefaultCalls - defaulted;
+		results.bytes = sink.Bytes() - bytes;
+		allocated = std::max<double>(allocated, results.allocations);
+		p99 = std::min<uint64_t>(p99, results.p99);
+		if (round == 1 || results.nanoseconds < best.nanoseconds)
+		{
+			best = results;
+		}
+	}
+	best.allocations = allocated;
+	best.p99 = p99;
+	return best;
+}
+
+struct BaselineEntry
+{
+	std::string key;
+	double allocations = 0;
+	// Only when the baseline was written on this machine.
+	bool timed = false;
+	double nanoseconds = 0;
+	uint64_t p99 = 0;
+};
+
+// One line per combination: key and allocations/msg, optionally followed by
+// ns/msg and p99 in ns. Lines starting with '#' are comments.
+static bool ReadBaseline(const std::string& path, std::vector<BaselineEntry>& baseline)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		return false;
+	}
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+		std::istringstream fields(line);
+		BaselineEntry entry{};
+		if (fields >> entry.key >> entry.allocations)
+		{
+			entry.timed = static_cast<bool>(fields >> entry.nanoseconds >> entry.p99);
+			baseline.push_back(std::move(entry));
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	size_t count = 200000;
+	size_t rounds = MIN_TIMING_ROUNDS;
+	double tolerance = 0.25;
+	double noiseFloor = 50;
+	std::string baselinePath;
+	std::string writeBaselinePath;
+	std::string tracePath;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string_view arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "--count" && hasValue)
+		{
+			count = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+		}
+		else if (arg == "--rounds" && hasValue)
+		{
+			rounds = std::max<size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+		}
+		else if (arg == "--tolerance" && hasValue)
+		{
+			tolerance = std::strtod(argv[++i], nullptr);
+		}
+		else if (arg == "--noise-floor" && hasValue)
+		{
+			noiseFloor = std::strtod(argv[++i], nullptr);
+		}
+		else if (arg == "--baseline" && hasValue)
+		{
+			baselinePath = argv[++i];
+		}
+		else if (arg == "--write-baseline" && hasValue)
+		{
+			writeBaselinePath = argv[++i];
+		}
+		else if (!arg.starts_with("--"))
+		{
+			tracePath = arg;
+		}
+		else
+		{
+			fmt::print(stderr, "Usage: {} [--count N] [--rounds 5] [--baseline FILE] [--write-baseline FILE] [--tolerance 0.25] [--noise-floor 50] [trace.wmpt]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<TraceRecord> records;
+	// Synthetic messages are stamped in HeadlessPlatform ticks.
+	CountingLogSink discard{};
+	int64_t frequency = HeadlessPlatform{ discard }.TimestampFrequency();
+	if (!tracePath.empty())
+	{
+		TraceReader reader{};
+		if (!reader.Open(tracePath))
+		{
+			fmt::print(stderr, "Unable to open trace {}\n", tracePath);
+			return 1;
+		}
+		records.assign(reader.begin(), reader.end());
+		frequency = reader.Header().timestampFrequency;
+	}
+	else
+	{
+		records = SyntheticMessages(count);
+	}
+
+	std::vector<BaselineEntry> baseline;
+	if (!baselinePath.empty() && !ReadBaseline(baselinePath, baseline))
+	{
+		fmt::print(stderr, "Unable to read baseline {}\n", baselinePath);
+		return 1;
+	}
+
+	SyscallTable syscalls{};
+	syscalls.PromoteMouseInPointer = &MockPromoteMouseInPointer;
+	syscalls.PromotePointer = &MockPromotePointer;
+	SetSyscalls(&syscalls);
+
+	const bool timeBaseline = rounds >= MIN_TIMING_ROUNDS;
+	if (!timeBaseline && std::any_of(baseline.begin(), baseline.end(), [](const BaselineEntry& base) { return base.timed; }))
+	{
+		fmt::print("Timings are not compared with fewer than {} rounds\n", MIN_TIMING_ROUNDS);
+	}
+
+	fmt::print("{} messages\n", records.size());
+	std::string written = "# WmPointerMessageBenchmark baseline: key allocs/msg ns/msg p99-ns\n";
+	size_t regressions = 0;
+	for (unsigned mask = 0; mask < 32; mask++)
+	{
+		MessageConfig config{};
+		config.terse = mask & 1;
+		config.throttle = mask & 2;
+		config.options.motionEnabled = mask & 4;
+		config.options.returnZeroOnWMPointer = mask & 8;
+		config.options.callPromoteMouseInPointer = mask & 16;
+		const std::string key = config.Key();
+		const MessageResults results = Run(config, records, frequency, rounds);
+
+		std::string verdict;
+		const auto entry = std::find_if(baseline.begin(), baseline.end(), [&](const BaselineEntry& base) { return base.key == key; });
+		if (entry != baseline.end())
+		{
+			const BaselineEntry& base = *entry;
+			const bool timed = base.timed && timeBaseline;
+			const bool slower = timed && results.nanoseconds > base.nanoseconds * (1 + tolerance) + noiseFloor;
+			const bool tail = timed && static_cast<double>(results.p99) > static_cast<double>(base.p99) * (1 + tolerance) + noiseFloor;
+			const bool allocates = results.allocations > base.allocations + 0.01;
+			if (slower || tail || allocates)
+			{
+				regressions++;
+				verdict = fmt::format(
+					"  REGRESSED{}{}{}",
+					slower ? fmt::format(" ns/msg {:.1f} > {:.1f}", results.nanoseconds, base.nanoseconds) : "",
+					tail ? fmt::format(" p99 {} > {}", results.p99, base.p99) : "",
+					allocates ? fmt::format(" allocs/msg {:.3f} > {:.3f}", results.allocations, base.allocations) : ""
+				);
+			}
+		}
+		else if (!baseline.empty())
+		{
+			verdict = "  (not in baseline)";
+		}
+
+		fmt::print(
+			"{}: {:.1f} ns/msg, {:.3f} allocs/msg, p99 {} ns, {} returned, {} default, {} promotions, {} bytes{}\n",
+			key,
+			results.nanoseconds,
+			results.allocations,
+			results.p99,
+			results.returned,
+			results.defaulted,
+			results.promotions,
+			results.bytes,
+			verdict
+		);
+		written += fmt::format("{} {:.3f} {:.1f} {}\n", key, results.allocations, results.nanoseconds, results.p99);
+	}
+	SetSyscalls(nullptr);
+
+	if (!writeBaselinePath.empty())
+	{
+		std::ofstream file(writeBaselinePath, std::ios::binary);
+		file << written;
+		if (!file)
+		{
+			fmt::print(stderr, "Unable to write baseline {}\n", writeBaselinePath);
+			return 1;
+		}
+	}
+
+	if (regressions > 0)
+	{
+		fmt::print("{} of 32 combinations regressed past the baseline (tolerance {:.0f}% + {:.0f} ns)\n", regressions, tolerance * 100, noiseFloor);
+		return 1;
+	}
+	return 0;
+}
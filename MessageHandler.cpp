@@ -0,0 +1,90 @@
+#include "MessageHandler.h"
+#include "Syscalls.h"
+#include "Trace.h"
+
+MessageResult MessageHandler::Handle(UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	if (m_options.callPromoteMouseInPointer)
+	{
+		PromotePointerMessage(Syscalls(), GET_POINTERID_WPARAM(wParam));
+	}
+
+	if (!m_options.motionEnabled)
+	{
+		switch (uMsg)
+		{
+		case WM_POINTERUPDATE:
+			if (m_options.returnZeroOnWMPointer)
+			{
+				return { MessageAction::Return, 0 };
+			}
+			// fallthrough
+		case WM_NCPOINTERUPDATE:
+		case WM_MOUSEMOVE:
+			return { MessageAction::Default, 0 };
+		}
+	}
+
+	if (!IsTracedMessage(uMsg))
+	{
+		return {};
+	}
+
+	// Contact summaries need pointer and pen details for every sample. A full
+	// collector counts the message as dropped.
+	const TraceRecord record = m_pipeline.Capture(uMsg, wParam, lParam, m_pipeline.Summarizing());
+	if (m_collector ? (m_collector->Push(m_collectorSource, record), true) : m_pipeline.Process(record))
+	{
+		switch (uMsg)
+		{
+		case WM_TOUCHHITTESTING:
+		case WM_MOUSEMOVE:
+		case WM_MOUSEWHEEL:
+		case WM_MOUSELEAVE:
+		case WM_RBUTTONDBLCLK:
+		case WM_RBUTTONDOWN:
+		case WM_RBUTTONUP:
+		case WM_LBUTTONDBLCLK:
+		case WM_LBUTTONDOWN:
+		case WM_LBUTTONUP:
+		case WM_MBUTTONDBLCLK:
+		case WM_MBUTTONDOWN:
+		case WM_MBUTTONUP:
+		case WM_XBUTTONDBLCLK:
+		case WM_XBUTTONDOWN:
+		case WM_XBUTTONUP:
+			return { MessageAction::Return, 0 };
+
+		case WM_MOUSEACTIVATE:
+			// Do *not* eat the event, so we can see that too.
+			return { MessageAction::Return, MA_ACTIVATE };
+		}
+	}
+
+	if (m_options.returnZeroOnWMPointer)
+	{
+		switch (uMsg)
+		{
+		case WM_POINTERACTIVATE:
+		case WM_POINTERCAPTURECHANGED:
+		case WM_POINTERDEVICECHANGE:
+		case WM_POINTERDEVICEINRANGE:
+		case WM_POINTERDEVICEOUTOFRANGE:
+		case WM_POINTERDOWN:
+		case WM_POINTERENTER:
+		case WM_POINTERLEAVE:
+		case WM_POINTERROUTEDAWAY:
+		case WM_POINTERROUTEDRELEASED:
+		case WM_POINTERROUTEDTO:
+		case WM_POINTERUP:
+		case WM_POINTERUPDATE:
+		case WM_POINTERWHEEL:
+		case WM_POINTERHWHEEL:
+			return { MessageAction::Return, 0 };
+		default:
+			break;
+		}
+	}
+
+	return { MessageAction::Default, 0 };
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "EventCollector.h"
+#include "Pipeline.h"
+#include "WinCompat.h"
+#include <cstddef>
+
+// The options behind the Motion Events, Ret 0 on WM_POINTER* and Call
+// NtUserPromoteMouseInPointer checkboxes; Terse and Throttle live on the
+// pipeline.
+struct MessageOptions
+{
+	bool motionEnabled = false;
+	bool returnZeroOnWMPointer = true;
+	bool callPromoteMouseInPointer = false;
+};
+
+enum class MessageAction
+{
+	// Not a traced message; the window handles it.
+	Continue,
+	// Handled; the window procedure returns `result`.
+	Return,
+	// Handled; the window procedure returns what DefWindowProc does.
+	Default,
+};
+
+struct MessageResult
+{
+	MessageAction action = MessageAction::Continue;
+	LRESULT result = 0;
+};
+
+// What the demo window does with every message before its own switch: promote
+// mouse input if asked to, drop motion when it is disabled, log traced
+// messages through the pipeline and decide what they return. It touches the
+// window only through the result, so it runs the same on the headless
+// platform.
+//
+// While a collector is set, traced messages are pushed to one of its sources
+// instead, to be logged in one order with those of other windows when the
+// collector is drained. The throttle has not seen them yet by then, so they
+// are answered as if they were logged.
+class MessageHandler
+{
+public:
+	explicit MessageHandler(EventPipeline& pipeline) : m_pipeline(pipeline) {}
+
+	MessageResult Handle(UINT uMsg, WPARAM wParam, LPARAM lParam);
+
+	MessageOptions& Options() { return m_options; }
+	const MessageOptions& Options() const { return m_options; }
+
+	// nullptr to log through the pipeline again.
+	void SetCollector(EventCollector<>* collector, size_t source)
+	{
+		m_collector = collector;
+		m_collectorSource = source;
+	}
+
+private:
+	EventPipeline& m_pipeline;
+	MessageOptions m_options{};
+	EventCollector<>* m_collector = nullptr;
+	size_t m_collectorSource = 0;
+};
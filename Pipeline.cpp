@@ -0,0 +1,114 @@
+#include "Pipeline.h"
+#include "Decode.h"
+#include "Latency.h"
+#include <chrono>
+
+EventPipeline::EventPipeline(Platform& platform, std::string_view lineEnding)
+	: m_platform(platform), m_output(platform.Output(), lineEnding)
+{
+}
+
+TraceRecord EventPipeline::Capture(UINT uMsg, WPARAM wParam, LPARAM lParam, bool detailed) const
+{
+	TraceRecord record{};
+	record.message = uMsg;
+	record.wParam = wParam;
+	record.lParam = lParam;
+	record.timestamp = m_platform.Timestamp();
+	m_platform.CaptureDetails(record, detailed);
+	return record;
+}
+
+bool EventPipeline::Process(const TraceRecord& record)
+{
+	if (m_summarize)
+	{
+		switch (record.message)
+		{
+		case WM_POINTERDOWN:
+		case WM_POINTERUPDATE:
+		case WM_POINTERUP:
+		case WM_POINTERCAPTURECHANGED:
+			{
+				ContactSummary summary{};
+				if (m_tracker.Track(record, summary))
+				{
+					LogContact(summary);
+				}
+			}
+			return true;
+		}
+	}
+
+	// Throttled on the time the message was stamped with, so that replayed
+	// messages are throttled as they were recorded.
+	const ThrottleResult throttle = m_throttle ? m_throttler.Throttle(record, TicksToNanoseconds(record.timestamp, m_platform.TimestampFrequency())) : ThrottleResult{};
+	if (throttle.releaseHeld)
+	{
+		m_throttler.ReleaseHeld([this](const TraceRecord& held) { LogEvent(held); });
+	}
+	if (throttle.hasHeld)
+	{
+		LogEvent(throttle.held);
+	}
+	return !throttle.drop && LogEvent(record, m_throttler.TakeThrottledCount(record.message));
+}
+
+bool EventPipeline::LogEvent(const TraceRecord& record, uint32_t throttled)
+{
+	if (!FindMessage(record.message))
+	{
+		return false;
+	}
+	if (m_events.Full())
+	{
+		Flush();
+	}
+	m_events.Push(MessageEvent(record, m_terse, throttled));
+	return true;
+}
+
+void EventPipeline::LogContact(const ContactSummary& summary)
+{
+	const int64_t frequency = m_platform.TimestampFrequency();
+	Log(FMT_STRING("pointer {} {}: {:.1f} ms, {} samples, path {:.0f} px, mean {:.0f} px/s, peak {:.0f} px/s, ~{} dropped"),
+		summary.pointerId,
+		summary.cancelled ? "cancelled" : "lifted",
+		static_cast<double>(summary.Duration()) * 1000.0 / static_cast<double>(frequency),
+		summary.state.samples,
+		summary.state.pathLength,
+		summary.MeanVelocity(frequency),
+		summary.PeakVelocity(frequency),
+		summary.state.dropped
+	);
+	if (summary.state.pressureSamples)
+	{
+		Log(FMT_STRING(";   pressure {}-{}, mean {:.0f}"), summary.state.minPressure, summary.state.maxPressure, summary.MeanPressure());
+	}
+}
+
+void EventPipeline::Tick()
+{
+	m_throttler.Expire([this](const TraceRecord& held) { LogEvent(held); }, TicksToNanoseconds(m_platform.Timestamp(), m_platform.TimestampFrequency()));
+	Flush();
+}
+
+void EventPipeline::Flush()
+{
+	// The time the sinks take is what Adaptive throttling paces itself by.
+	const auto start = std::chrono::steady_clock::now();
+	const size_t events = m_events.Drain([this](const EventRecord& event, std::string_view text)
+	{
+		m_output.Append(event, text);
+		if (m_sink)
+		{
+			m_sink->Append(event, text);
+		}
+	});
+	m_output.Flush();
+	if (m_sink)
+	{
+		m_sink->Flush();
+	}
+	m_throttler.ReportSinkCost(events, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
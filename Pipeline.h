@@ -0,0 +1,76 @@
+#pragma once
+
+#include "EventLog.h"
+#include "Platform.h"
+#include "PointerTracker.h"
+#include "Throttle.h"
+#include "Trace.h"
+#include "WinCompat.h"
+#include <string_view>
+#include <utility>
+
+// Capture, throttle, decode and log stage for traced messages. It owns the
+// event arena and the throttler and talks to the host only through Platform,
+// so the same code runs behind the demo window and in headless builds.
+// Messages are kept as EventRecords and only rendered to text when flushed.
+class EventPipeline
+{
+public:
+	explicit EventPipeline(Platform& platform, std::string_view lineEnding = "\n");
+
+	TraceRecord Capture(UINT uMsg, WPARAM wParam, LPARAM lParam, bool detailed) const;
+
+	// Logs a traced message unless it is throttled, along with any message
+	// the throttler held back. With contact summaries on, pointer down, update
+	// and up messages are folded into one line per contact, logged when it
+	// ends. Returns whether the message itself was logged or summarized.
+	bool Process(const TraceRecord& record);
+
+	// Releases held messages whose throttle window has closed and flushes.
+	void Tick();
+	void Flush();
+
+	void Log(std::string_view line)
+	{
+		if (m_events.Full())
+		{
+			Flush();
+		}
+		m_events.PushText(m_platform.Timestamp(), line);
+	}
+
+	template <typename... T>
+	void Log(fmt::format_string<T...> format, T&&... args)
+	{
+		if (m_events.Full())
+		{
+			Flush();
+		}
+		m_events.PushText(m_platform.Timestamp(), format, std::forward<T>(args)...);
+	}
+
+	bool Terse() const { return m_terse; }
+	void SetTerse(bool terse) { m_terse = terse; }
+	bool Throttling() const { return m_throttle; }
+	void SetThrottling(bool throttle) { m_throttle = throttle; }
+	bool Summarizing() const { return m_summarize; }
+	void SetSummarizing(bool summarize) { m_summarize = summarize; }
+	Throttler& GetThrottler() { return m_throttler; }
+	// Another sink that receives every event when the log is flushed, such as
+	// an EventFileWriter; nullptr to stop.
+	void SetEventSink(EventSink* sink) { m_sink = sink; }
+
+private:
+	bool LogEvent(const TraceRecord& record, uint32_t throttled = 0);
+	void LogContact(const ContactSummary& summary);
+
+	Platform& m_platform;
+	bool m_terse = true;
+	bool m_throttle = false;
+	bool m_summarize = false;
+	Throttler m_throttler{};
+	PointerTracker m_tracker{};
+	EventArena<> m_events{};
+	TextEventSink m_output;
+	EventSink* m_sink = nullptr;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Injection.h"
+#include "LogSink.h"
+#include "Trace.h"
+#include "WinCompat.h"
+#include <cstdint>
+#include <memory>
+
+// Everything the event pipeline needs from the host. The demo window
+// implements it on top of Win32; HeadlessPlatform stands in for it elsewhere.
+class Platform
+{
+public:
+	virtual ~Platform() = default;
+
+	// Monotonic timestamp in ticks of TimestampFrequency, as stored in traces.
+	virtual int64_t Timestamp() = 0;
+	virtual int64_t TimestampFrequency() = 0;
+
+	// Adds whatever the message refers to that is not in wParam/lParam, such
+	// as hit-test input, and with `detailed` the pointer and pen state.
+	virtual void CaptureDetails(TraceRecord& record, bool detailed) = 0;
+
+	// Receives every flushed batch of log lines.
+	virtual LogSink& Output() = 0;
+
+	virtual std::unique_ptr<InjectionBackend> CreateInjectionBackend() = 0;
+};
@@ -0,0 +1,289 @@
+#pragma once
+
+#include "WinCompat.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// One hardware sample, as recovered from a pointer's coalesced history.
+struct PointerSample
+{
+	uint32_t frameId;
+	int32_t x;
+	int32_t y;
+	uint32_t pressure;
+	int32_t tiltX;
+	int32_t tiltY;
+	uint64_t performanceCount;
+};
+
+// Fixed-size structure-of-arrays chunk of samples, so consumers can walk one
+// field at a time.
+struct SampleBlock
+{
+	constexpr static size_t CAPACITY = 256;
+
+	uint32_t count = 0;
+	std::array<uint32_t, CAPACITY> frameId;
+	std::array<int32_t, CAPACITY> x;
+	std::array<int32_t, CAPACITY> y;
+	std::array<uint32_t, CAPACITY> pressure;
+	std::array<int32_t, CAPACITY> tiltX;
+	std::array<int32_t, CAPACITY> tiltY;
+	std::array<uint64_t, CAPACITY> performanceCount;
+
+	bool Full() const { return count == CAPACITY; }
+
+	void Push(const PointerSample& sample)
+	{
+		frameId[count] = sample.frameId;
+		x[count] = sample.x;
+		y[count] = sample.y;
+		pressure[count] = sample.pressure;
+		tiltX[count] = sample.tiltX;
+		tiltY[count] = sample.tiltY;
+		performanceCount[count] = sample.performanceCount;
+		count++;
+	}
+};
+
+// Free list of sample blocks. Blocks are allocated on first demand and then
+// recycled, so a steady stream of strokes stops allocating once the pool has
+// grown to the peak number of blocks in use.
+class SamplePool
+{
+public:
+	SampleBlock* Acquire()
+	{
+		if (m_free.empty())
+		{
+			m_blocks.push_back(std::make_unique<SampleBlock>());
+			m_free.push_back(m_blocks.back().get());
+		}
+		SampleBlock* block = m_free.back();
+		m_free.pop_back();
+		block->count = 0;
+		return block;
+	}
+
+	void Release(SampleBlock* block) { m_free.push_back(block); }
+
+	size_t Allocated() const { return m_blocks.size(); }
+	size_t Available() const { return m_free.size(); }
+
+private:
+	std::vector<std::unique_ptr<SampleBlock>> m_blocks;
+	std::vector<SampleBlock*> m_free;
+};
+
+// Every sample of one pointer since it was last cleared, oldest first.
+class PointerSamples
+{
+public:
+	explicit PointerSamples(SamplePool& pool) : m_pool(&pool) {}
+	PointerSamples(const PointerSamples&) = delete;
+	PointerSamples& operator=(const PointerSamples&) = delete;
+	~PointerSamples() { Clear(); }
+
+	void Push(const PointerSample& sample)
+	{
+		if (m_blocks.empty() || m_blocks.back()->Full())
+		{
+			m_blocks.push_back(m_pool->Acquire());
+		}
+		m_blocks.back()->Push(sample);
+		m_size++;
+	}
+
+	// Returns every block to the pool.
+	void Clear()
+	{
+		for (SampleBlock* block : m_blocks)
+		{
+			m_pool->Release(block);
+		}
+		m_blocks.clear();
+		m_size = 0;
+	}
+
+	size_t Size() const { return m_size; }
+	bool Empty() const { return m_size == 0; }
+	const std::vector<SampleBlock*>& Blocks() const { return m_blocks; }
+
+	// Calls `callback(block)` for every block, oldest first.
+	template <typename Callback>
+	void ForEachBlock(Callback&& callback) const
+	{
+		for (const SampleBlock* block : m_blocks)
+		{
+			callback(*block);
+		}
+	}
+
+private:
+	SamplePool* m_pool;
+	std::vector<SampleBlock*> m_blocks;
+	size_t m_size = 0;
+};
+
+// Per-pointer sample buffers fed from coalesced pointer history. The same
+// frames are reported again by every message that retrieves history, so only
+// frames newer than the last one seen for a pointer are kept.
+class PointerHistory
+{
+public:
+	constexpr static size_t MAX_POINTERS = 32;
+
+	struct Track
+	{
+		bool active = false;
+		uint32_t pointerId = 0;
+		uint32_t lastFrameId = 0;
+		// Messages that delivered history, as opposed to samples received.
+		size_t messages = 0;
+		PointerSamples samples;
+
+		explicit Track(SamplePool& pool) : samples(pool) {}
+	};
+
+	PointerHistory()
+	{
+		m_tracks.reserve(MAX_POINTERS);
+		for (size_t i = 0; i < MAX_POINTERS; i++)
+		{
+			m_tracks.push_back(std::make_unique<Track>(m_pool));
+		}
+	}
+
+	// `history` is ordered newest first, as returned by the GetPointer*History
+	// functions. Returns the number of new samples, or 0 when every pointer
+	// slot is taken.
+	size_t Append(uint32_t pointerId, const PointerSample* history, size_t count)
+	{
+		Track* track = Find(pointerId, true);
+		if (!track)
+		{
+			return 0;
+		}
+		size_t added = 0;
+		for (size_t i = count; i-- > 0;)
+		{
+			if (track->samples.Empty() || static_cast<int32_t>(history[i].frameId - track->lastFrameId) > 0)
+			{
+				track->samples.Push(history[i]);
+				track->lastFrameId = history[i].frameId;
+				added++;
+			}
+		}
+		track->messages++;
+		return added;
+	}
+
+	const Track* Get(uint32_t pointerId) const
+	{
+		for (const auto& track : m_tracks)
+		{
+			if (track->active && track->pointerId == pointerId)
+			{
+				return track.get();
+			}
+		}
+		return nullptr;
+	}
+
+	// Drops a pointer's samples once it has been consumed or it is gone, e.g.
+	// on lift, on leaving the window or on losing capture.
+	void Release(uint32_t pointerId)
+	{
+		if (Track* track = Find(pointerId, false))
+		{
+			track->samples.Clear();
+			track->messages = 0;
+			track->active = false;
+		}
+	}
+
+	void Clear()
+	{
+		for (const auto& track : m_tracks)
+		{
+			if (track->active)
+			{
+				Release(track->pointerId);
+			}
+		}
+	}
+
+	const SamplePool& Pool() const { return m_pool; }
+
+private:
+	Track* Find(uint32_t pointerId, bool create)
+	{
+		Track* unused = nullptr;
+		for (const auto& track : m_tracks)
+		{
+			if (track->active && track->pointerId == pointerId)
+			{
+				return track.get();
+			}
+			if (!track->active && !unused)
+			{
+				unused = track.get();
+			}
+		}
+		if (!create || !unused)
+		{
+			return nullptr;
+		}
+		unused->active = true;
+		unused->pointerId = pointerId;
+		unused->lastFrameId = 0;
+		unused->messages = 0;
+		return unused;
+	}
+
+	// Declared first so that it outlives the tracks returning blocks to it.
+	SamplePool m_pool;
+	std::vector<std::unique_ptr<Track>> m_tracks;
+};
+
+struct SampleSummary
+{
+	size_t samples = 0;
+	size_t messages = 0;
+	// Between the first and last sample, in ticks of the timestamp frequency.
+	uint64_t duration = 0;
+	uint32_t minPressure = 0;
+	uint32_t maxPressure = 0;
+
+	double Rate(int64_t frequency) const
+	{
+		return samples > 1 && duration > 0 ? static_cast<double>(samples - 1) * static_cast<double>(frequency) / static_cast<double>(duration) : 0.0;
+	}
+};
+
+inline SampleSummary SummarizeSamples(const PointerHistory::Track& track)
+{
+	SampleSummary summary{};
+	summary.samples = track.samples.Size();
+	summary.messages = track.messages;
+	if (track.samples.Empty())
+	{
+		return summary;
+	}
+
+	const auto& blocks = track.samples.Blocks();
+	summary.duration = blocks.back()->performanceCount[blocks.back()->count - 1] - blocks.front()->performanceCount[0];
+	summary.minPressure = UINT32_MAX;
+	track.samples.ForEachBlock([&](const SampleBlock& block)
+	{
+		const auto pressure = block.pressure.begin();
+		const auto [lowest, highest] = std::minmax_element(pressure, pressure + block.count);
+		summary.minPressure = std::min<uint32_t>(summary.minPressure, *lowest);
+		summary.maxPressure = std::max<uint32_t>(summary.maxPressure, *highest);
+	});
+	return summary;
+}
@@ -0,0 +1,293 @@
+#pragma once
+
+#include "Trace.h"
+#include "WinCompat.h"
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Flat open-addressed map from pointer id to Value. Linear probing with
+// backward-shift deletion, so there are no tombstones and lookups never have to
+// scan past a removed contact. One slot is always left free so a probe for a
+// missing key terminates.
+template <typename Value, size_t Capacity = 64>
+class PointerTable
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	Value* Find(uint32_t key)
+	{
+		for (size_t i = Home(key);; i = (i + 1) & (Capacity - 1))
+		{
+			if (!m_slots[i].used)
+			{
+				return nullptr;
+			}
+			if (m_slots[i].key == key)
+			{
+				return &m_slots[i].value;
+			}
+		}
+	}
+
+	// Returns the existing entry or a value-initialized new one, or null when
+	// the table is full.
+	Value* Insert(uint32_t key)
+	{
+		size_t i = Home(key);
+		for (; m_slots[i].used; i = (i + 1) & (Capacity - 1))
+		{
+			if (m_slots[i].key == key)
+			{
+				return &m_slots[i].value;
+			}
+		}
+		if (m_size == Capacity - 1)
+		{
+			return nullptr;
+		}
+		m_slots[i] = { true, key, Value{} };
+		m_size++;
+		return &m_slots[i].value;
+	}
+
+	void Erase(uint32_t key)
+	{
+		size_t hole = Home(key);
+		for (;; hole = (hole + 1) & (Capacity - 1))
+		{
+			if (!m_slots[hole].used)
+			{
+				return;
+			}
+			if (m_slots[hole].key == key)
+			{
+				break;
+			}
+		}
+		// Pull back every following entry whose home is not between the hole
+		// and its current slot, so that it stays reachable.
+		for (size_t next = (hole + 1) & (Capacity - 1); m_slots[next].used; next = (next + 1) & (Capacity - 1))
+		{
+			const size_t home = Home(m_slots[next].key);
+			if (((next - home) & (Capacity - 1)) >= ((next - hole) & (Capacity - 1)))
+			{
+				m_slots[hole] = m_slots[next];
+				hole = next;
+			}
+		}
+		m_slots[hole].used = false;
+		m_size--;
+	}
+
+	size_t Size() const { return m_size; }
+
+	template <typename Callback>
+	void ForEach(Callback&& callback) const
+	{
+		for (const Slot& slot : m_slots)
+		{
+			if (slot.used)
+			{
+				callback(slot.key, slot.value);
+			}
+		}
+	}
+
+private:
+	struct Slot
+	{
+		bool used = false;
+		uint32_t key = 0;
+		Value value{};
+	};
+
+	static size_t Home(uint32_t key)
+	{
+		constexpr int BITS = std::countr_zero(Capacity);
+		return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> (64 - BITS));
+	}
+
+	std::array<Slot, Capacity> m_slots{};
+	size_t m_size = 0;
+};
+
+// Running lifecycle of one contact. Times are in ticks of the trace timestamp
+// frequency and distances in pixels.
+struct ContactState
+{
+	int64_t downTime = 0;
+	int64_t lastTime = 0;
+	uint32_t samples = 0;
+	int32_t lastX = 0;
+	int32_t lastY = 0;
+	double pathLength = 0.0;
+	// Pixels per tick.
+	double peakVelocity = 0.0;
+	uint32_t pressureSamples = 0;
+	uint32_t minPressure = 0;
+	uint32_t maxPressure = 0;
+	uint64_t pressureTotal = 0;
+	// Smoothed interval between samples, used to spot missing ones.
+	double interval = 0.0;
+	uint32_t dropped = 0;
+};
+
+struct ContactSummary
+{
+	uint32_t pointerId = 0;
+	// Ended by WM_POINTERCAPTURECHANGED rather than a lift.
+	bool cancelled = false;
+	ContactState state{};
+
+	int64_t Duration() const { return state.lastTime - state.downTime; }
+
+	double MeanVelocity(int64_t frequency) const
+	{
+		return Duration() > 0 ? state.pathLength * static_cast<double>(frequency) / static_cast<double>(Duration()) : 0.0;
+	}
+
+	double PeakVelocity(int64_t frequency) const { return state.peakVelocity * static_cast<double>(frequency); }
+
+	double MeanPressure() const
+	{
+		return state.pressureSamples ? static_cast<double>(state.pressureTotal) / state.pressureSamples : 0.0;
+	}
+};
+
+// Follows contacts across WM_POINTERDOWN/UPDATE/UP/CAPTURECHANGED and folds
+// every sample into its contact's running state. Positions and pressure come
+// from the captured pointer and pen details when present and from lParam
+// otherwise.
+class PointerTracker
+{
+public:
+	// An interval this many times the smoothed one counts as missed samples.
+	constexpr static double DROP_THRESHOLD = 1.5;
+
+	// Returns true when the record ends a contact, with its summary.
+	bool Track(const TraceRecord& record, ContactSummary& summary)
+	{
+		const uint32_t pointerId = GET_POINTERID_WPARAM(record.wParam);
+		switch (record.message)
+		{
+		case WM_POINTERDOWN:
+			m_contacts.Erase(pointerId);
+			[[fallthrough]];
+		case WM_POINTERUPDATE:
+			if (ContactState* state = m_contacts.Find(pointerId))
+			{
+				Sample(*state, record);
+			}
+			else if (record.message == WM_POINTERDOWN || IS_POINTER_INCONTACT_WPARAM(record.wParam))
+			{
+				// Contacts already down when tracking started are picked up
+				// on their next update.
+				if (ContactState* started = m_contacts.Insert(pointerId))
+				{
+					Start(*started, record);
+				}
+				else
+				{
+					m_overflow++;
+				}
+			}
+			return false;
+
+		case WM_POINTERUP:
+		case WM_POINTERCAPTURECHANGED:
+			if (ContactState* state = m_contacts.Find(pointerId))
+			{
+				if (record.message == WM_POINTERUP)
+				{
+					Sample(*state, record);
+				}
+				summary = { pointerId, record.message != WM_POINTERUP, *state };
+				m_contacts.Erase(pointerId);
+				return true;
+			}
+			return false;
+
+		default:
+			return false;
+		}
+	}
+
+	size_t Active() const { return m_contacts.Size(); }
+	// Contacts that could not be tracked because the table was full.
+	uint64_t Overflow() const { return m_overflow; }
+
+private:
+	static void Position(const TraceRecord& record, int32_t& x, int32_t& y)
+	{
+		if (record.flags & TRACE_HAS_POINTER)
+		{
+			x = record.pointer.pixelX;
+			y = record.pointer.pixelY;
+		}
+		else
+		{
+			x = GET_X_LPARAM(record.lParam);
+			y = GET_Y_LPARAM(record.lParam);
+		}
+	}
+
+	static void AddPressure(ContactState& state, const TraceRecord& record)
+	{
+		if (!(record.flags & TRACE_HAS_PEN) || !(record.pen.penMask & PEN_MASK_PRESSURE))
+		{
+			return;
+		}
+		const uint32_t pressure = record.pen.pressure;
+		state.minPressure = state.pressureSamples ? (pressure < state.minPressure ? pressure : state.minPressure) : pressure;
+		state.maxPressure = state.pressureSamples ? (pressure > state.maxPressure ? pressure : state.maxPressure) : pressure;
+		state.pressureTotal += pressure;
+		state.pressureSamples++;
+	}
+
+	static void Start(ContactState& state, const TraceRecord& record)
+	{
+		state = {};
+		state.downTime = record.timestamp;
+		state.lastTime = record.timestamp;
+		state.samples = 1;
+		Position(record, state.lastX, state.lastY);
+		AddPressure(state, record);
+	}
+
+	static void Sample(ContactState& state, const TraceRecord& record)
+	{
+		int32_t x = 0;
+		int32_t y = 0;
+		Position(record, x, y);
+		const double distance = std::hypot(static_cast<double>(x - state.lastX), static_cast<double>(y - state.lastY));
+		const int64_t elapsed = record.timestamp - state.lastTime;
+		if (elapsed > 0)
+		{
+			const double velocity = distance / static_cast<double>(elapsed);
+			state.peakVelocity = velocity > state.peakVelocity ? velocity : state.peakVelocity;
+
+			const double interval = static_cast<double>(elapsed);
+			if (state.interval > 0 && interval > DROP_THRESHOLD * state.interval)
+			{
+				state.dropped += static_cast<uint32_t>(std::lround(interval / state.interval)) - 1;
+			}
+			else
+			{
+				state.interval = state.interval > 0 ? state.interval + (interval - state.interval) / 8 : interval;
+			}
+		}
+		state.pathLength += distance;
+		state.lastX = x;
+		state.lastY = y;
+		state.lastTime = record.timestamp;
+		state.samples++;
+		AddPressure(state, record);
+	}
+
+	PointerTable<ContactState> m_contacts{};
+	uint64_t m_overflow = 0;
+};
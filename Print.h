@@ -1,12 +1,32 @@
 #pragma once
 
-#include <windows.h>
+#include "WinCompat.h"
 #include <fmt/core.h>
 #include <fmt/format.h>
+#include <algorithm>
+#include <string>
+#include <string_view>
 
 namespace {
 
-#define ENUM_STR_START(name) static std::string name##_STR(int val) { switch (val) { default: return fmt::format("{}", val)
+// Each enumeration gets a name lookup (e.g. PDC_NAME) that returns an empty
+// view for unknown values, a formatter (e.g. FormatPDC) that writes the name or
+// number to an output iterator without allocating, and the string-returning
+// PDC_STR style helper built on top of it.
+#define ENUM_STR_START(name) \
+	static std::string_view name##_NAME(int val); \
+	template <typename OutputIt> OutputIt Format##name(OutputIt out, int val) \
+	{ \
+		const std::string_view str = name##_NAME(val); \
+		return str.empty() ? fmt::format_to(out, "{}", val) : std::copy(str.begin(), str.end(), out); \
+	} \
+	[[maybe_unused]] static std::string name##_STR(int val) \
+	{ \
+		fmt::memory_buffer buffer; \
+		Format##name(fmt::appender(buffer), val); \
+		return fmt::to_string(buffer); \
+	} \
+	static std::string_view name##_NAME(int val) { switch (val) { default: return {}
 #define ENUM_STR_END() } }
 #define ENUM_STR_KEY(key) case key: return #key
 
@@ -34,7 +54,8 @@ constexpr std::string_view Btn(bool down)
 	return down ? "X" : " ";
 }
 
-std::string PointerState(WPARAM wParam)
+template <typename OutputIt>
+OutputIt FormatPointerState(OutputIt out, WPARAM wParam)
 {
 	const bool newPtr = IS_POINTER_NEW_WPARAM(wParam);
 	const bool inRange = IS_POINTER_INRANGE_WPARAM(wParam);
@@ -45,10 +66,11 @@ std::string PointerState(WPARAM wParam)
 	const bool b3 = IS_POINTER_THIRDBUTTON_WPARAM(wParam);
 	const bool b4 = IS_POINTER_FOURTHBUTTON_WPARAM(wParam);
 	const bool b5 = IS_POINTER_FIFTHBUTTON_WPARAM(wParam);
-	return fmt::format("{} {} {} {} [{}|{}|{}|{}|{}]", newPtr ? "NEW" : "!NEW", inRange ? "INRANGE" : "!INRANGE", inContact ? "INCONTACT" : "!INCONTACT", isPrimary ? "PRIMARY" : "!PRIMARY", Btn(b1), Btn(b2), Btn(b3), Btn(b4), Btn(b5));
+	return fmt::format_to(out, FMT_STRING("{} {} {} {} [{}|{}|{}|{}|{}]"), newPtr ? "NEW" : "!NEW", inRange ? "INRANGE" : "!INRANGE", inContact ? "INCONTACT" : "!INCONTACT", isPrimary ? "PRIMARY" : "!PRIMARY", Btn(b1), Btn(b2), Btn(b3), Btn(b4), Btn(b5));
 }
 
-std::string MouseState(WPARAM wParam)
+template <typename OutputIt>
+OutputIt FormatMouseState(OutputIt out, WPARAM wParam)
 {
 	const bool l = LOWORD(wParam) & MK_LBUTTON;
 	const bool r = LOWORD(wParam) & MK_RBUTTON;
@@ -57,7 +79,21 @@ std::string MouseState(WPARAM wParam)
 	const bool m = LOWORD(wParam) & MK_MBUTTON;
 	const bool x1 = LOWORD(wParam) & MK_XBUTTON1;
 	const bool x2 = LOWORD(wParam) & MK_XBUTTON2;
-	return fmt::format("{} {} [{}|{}|{}|{}|{}]", shift ? "SHIFT" : "!SHIFT", ctrl ? "CTRL" : "!CTRL", Btn(l), Btn(r), Btn(m), Btn(x1), Btn(x2));
+	return fmt::format_to(out, FMT_STRING("{} {} [{}|{}|{}|{}|{}]"), shift ? "SHIFT" : "!SHIFT", ctrl ? "CTRL" : "!CTRL", Btn(l), Btn(r), Btn(m), Btn(x1), Btn(x2));
 }
 
-}
\ No newline at end of file
+[[maybe_unused]] std::string PointerState(WPARAM wParam)
+{
+	fmt::memory_buffer buffer;
+	FormatPointerState(fmt::appender(buffer), wParam);
+	return fmt::to_string(buffer);
+}
+
+[[maybe_unused]] std::string MouseState(WPARAM wParam)
+{
+	fmt::memory_buffer buffer;
+	FormatMouseState(fmt::appender(buffer), wParam);
+	return fmt::to_string(buffer);
+}
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Gesture.h"
+#include "Injection.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Multi-contact injection at touch-panel report rates. Each frame carries
+// every contact and is handed to the backend in a single call. Every rate
+// compiles to its own plan, which is played by the injection worker on a
+// device leased from its pool.
+struct StressConfig
+{
+	POINTER_INPUT_TYPE pointerType = PT_TOUCH;
+	uint32_t contacts = 10;
+	POINTER_FEEDBACK_MODE feedback = POINTER_FEEDBACK_DEFAULT;
+	// Report rates to step through, in Hz.
+	std::vector<double> rates{ 120.0, 240.0, 360.0, 480.0 };
+	std::chrono::nanoseconds stepDuration = std::chrono::seconds(2);
+	// Contacts circle around this point, in screen pixels.
+	int32_t centerX = 400;
+	int32_t centerY = 300;
+	int32_t radius = 100;
+};
+
+struct StressStepReport
+{
+	double requestedRate = 0.0;
+	uint32_t contacts = 0;
+	size_t plannedFrames = 0;
+	PlayStats stats{};
+};
+
+// Every contact touches down on the first frame, moves around a circle and
+// lifts on the last one. Contacts are spread evenly around the circle and each
+// also has a small orbit of its own so consecutive frames are never identical.
+inline InjectPlan CompileStressPlan(const StressConfig& config, double rate)
+{
+	constexpr double PI = 3.14159265358979323846;
+
+	InjectPlan plan{};
+	plan.pointerType = config.pointerType;
+	plan.maxContacts = std::max<uint32_t>(config.contacts, 1);
+	plan.feedback = config.feedback;
+	if (rate <= 0)
+	{
+		return plan;
+	}
+
+	const double interval = 1e9 / rate;
+	const size_t frameCount = std::max<size_t>(static_cast<size_t>(static_cast<double>(config.stepDuration.count()) / interval), 2);
+	plan.settle = std::chrono::nanoseconds(std::llround(interval));
+	plan.frames.reserve(frameCount);
+	plan.contacts.reserve(frameCount * plan.maxContacts);
+
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		const bool inContact = frame + 1 < frameCount;
+		const double progress = static_cast<double>(frame) / static_cast<double>(frameCount);
+		plan.frames.push_back({
+			std::chrono::nanoseconds(std::llround(static_cast<double>(frame) * interval)),
+			static_cast<uint32_t>(plan.contacts.size()),
+			plan.maxContacts,
+		});
+		for (uint32_t i = 0; i < plan.maxContacts; i++)
+		{
+			const double angle = 2 * PI * (progress + static_cast<double>(i) / plan.maxContacts);
+			const double wobble = 2 * PI * progress * 8;
+			InjectContact contact{};
+			contact.pointerId = i;
+			contact.x = config.centerX + static_cast<int32_t>(std::lround(config.radius * std::cos(angle) + 10 * std::cos(wobble)));
+			contact.y = config.centerY + static_cast<int32_t>(std::lround(config.radius * std::sin(angle) + 10 * std::sin(wobble)));
+			contact.pressure = 512;
+			contact.penMask = PEN_MASK_PRESSURE;
+			SetContactState(contact, config.pointerType, i == 0, inContact, frame != 0);
+			plan.contacts.push_back(contact);
+		}
+	}
+	return plan;
+}
@@ -0,0 +1,289 @@
+#pragma once
+
+#include "Injection.h"
+#include "WinCompat.h"
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Signatures of the win32u entry points described in Syscalls.md. Entries
+// whose arguments are not known yet are kept as plain addresses so that their
+// availability can still be reported.
+typedef int(WINAPI* NtUserPromotePointerFn)(int pointerId, int unknown);
+typedef int(WINAPI* NtUserPromoteMouseInPointerFn)(int unknown);
+typedef BOOL(WINAPI* NtUserEnableMouseInPointerFn)(BOOL enable);
+typedef BOOL(WINAPI* NtUserGetPointerCursorIdFn)(UINT32 pointerId, UINT32* cursorId);
+typedef BOOL(WINAPI* NtUserGetPointerDeviceFn)(HANDLE device, POINTER_DEVICE_INFO* pointerDevice);
+typedef BOOL(WINAPI* NtUserGetPointerDeviceCursorsFn)(HANDLE device, UINT32* cursorCount, POINTER_DEVICE_CURSOR_INFO* deviceCursors);
+typedef BOOL(WINAPI* NtUserGetPointerDevicesFn)(UINT32* deviceCount, POINTER_DEVICE_INFO* pointerDevices);
+typedef BOOL(WINAPI* NtUserGetPointerInputTransformFn)(UINT32 pointerId, UINT32 historyCount, INPUT_TRANSFORM* inputTransform);
+typedef BOOL(WINAPI* NtUserGetPointerTypeFn)(UINT32 pointerId, POINTER_INPUT_TYPE* pointerType);
+typedef const void* NtUserUnknownFn;
+
+typedef void(WINAPI* NtUserInitializePointerDeviceInjectionFn)(
+	POINTER_INPUT_TYPE       pointerType,
+	ULONG                    maxCount,
+	ULONG                    unknown,
+	POINTER_FEEDBACK_MODE    mode,
+	HSYNTHETICPOINTERDEVICE* out
+);
+
+typedef BOOL(WINAPI* NtUserInjectPointerInputFn)(
+	HSYNTHETICPOINTERDEVICE  device,
+	const POINTER_TYPE_INFO* pointerInfo,
+	UINT32                   count
+);
+
+typedef void(WINAPI* NtUserRemoveInjectionDeviceFn)(
+	HSYNTHETICPOINTERDEVICE device
+);
+
+// Every entry listed in Syscalls.md, without the NtUser prefix.
+#define SYSCALL_ENTRIES(X) \
+	X(PromotePointer, NtUserPromotePointerFn) \
+	X(PromoteMouseInPointer, NtUserPromoteMouseInPointerFn) \
+	X(EnableMouseInPointer, NtUserEnableMouseInPointerFn) \
+	X(EnableMouseInPointerForWindow, NtUserUnknownFn) \
+	X(GetPointerCursorId, NtUserGetPointerCursorIdFn) \
+	X(GetPointerDevice, NtUserGetPointerDeviceFn) \
+	X(GetPointerDeviceCursors, NtUserGetPointerDeviceCursorsFn) \
+	X(GetPointerDeviceInputSpace, NtUserUnknownFn) \
+	X(GetPointerDeviceOrientation, NtUserUnknownFn) \
+	X(GetPointerDeviceProperties, NtUserUnknownFn) \
+	X(GetPointerDeviceRects, NtUserUnknownFn) \
+	X(GetPointerDevices, NtUserGetPointerDevicesFn) \
+	X(GetPointerFrameArrivalTimes, NtUserUnknownFn) \
+	X(GetPointerFrameTimes, NtUserUnknownFn) \
+	X(GetPointerInfoList, NtUserUnknownFn) \
+	X(GetPointerInputTransform, NtUserGetPointerInputTransformFn) \
+	X(GetPointerProprietaryId, NtUserUnknownFn) \
+	X(GetPointerType, NtUserGetPointerTypeFn) \
+	X(InitializePointerDeviceInjection, NtUserInitializePointerDeviceInjectionFn) \
+	X(InjectPointerInput, NtUserInjectPointerInputFn) \
+	X(RemoveInjectionDevice, NtUserRemoveInjectionDeviceFn)
+
+enum class Syscall : uint8_t
+{
+#define SYSCALL_ENUM(name, type) name,
+	SYSCALL_ENTRIES(SYSCALL_ENUM)
+#undef SYSCALL_ENUM
+	Count,
+};
+
+constexpr std::string_view g_SyscallNames[] = {
+#define SYSCALL_NAME(name, type) "NtUser" #name,
+	SYSCALL_ENTRIES(SYSCALL_NAME)
+#undef SYSCALL_NAME
+};
+
+constexpr uint32_t SyscallBit(Syscall syscall)
+{
+	return 1u << static_cast<uint32_t>(syscall);
+}
+
+static_assert(static_cast<size_t>(Syscall::Count) <= 32, "availability flags are a 32-bit mask");
+
+// Typed entry points, resolved once. An entry may be null when neither win32u
+// nor user32 provides it; `available` marks entries that came from win32u and
+// `fallback` those that were filled in from their documented user32
+// equivalent.
+struct SyscallTable
+{
+#define SYSCALL_FIELD(name, type) type name = nullptr;
+	SYSCALL_ENTRIES(SYSCALL_FIELD)
+#undef SYSCALL_FIELD
+
+	uint32_t available = 0;
+	uint32_t fallback = 0;
+
+	bool IsAvailable(Syscall syscall) const { return (available & SyscallBit(syscall)) != 0; }
+	bool IsFallback(Syscall syscall) const { return (fallback & SyscallBit(syscall)) != 0; }
+};
+
+#ifdef _WIN32
+
+// Adapters for the entries whose user32 equivalent differs in shape.
+namespace SyscallFallback
+{
+	inline void WINAPI InitializePointerDeviceInjection(POINTER_INPUT_TYPE pointerType, ULONG maxCount, ULONG, POINTER_FEEDBACK_MODE mode, HSYNTHETICPOINTERDEVICE* out)
+	{
+		*out = CreateSyntheticPointerDevice(pointerType, maxCount, mode);
+	}
+
+	inline void WINAPI RemoveInjectionDevice(HSYNTHETICPOINTERDEVICE device)
+	{
+		DestroySyntheticPointerDevice(device);
+	}
+}
+
+template <typename Fn>
+void SetSyscallFallback(SyscallTable& table, Fn& entry, Fn fallback, Syscall syscall)
+{
+	if (!entry)
+	{
+		entry = fallback;
+		table.fallback |= SyscallBit(syscall);
+	}
+}
+
+inline SyscallTable ResolveSyscalls()
+{
+	SyscallTable table{};
+	const HMODULE win32u = GetModuleHandle(TEXT("win32u"));
+	if (win32u)
+	{
+#define SYSCALL_RESOLVE(name, type) \
+		table.name = reinterpret_cast<type>(GetProcAddress(win32u, "NtUser" #name)); \
+		if (table.name) \
+		{ \
+			table.available |= SyscallBit(Syscall::name); \
+		}
+		SYSCALL_ENTRIES(SYSCALL_RESOLVE)
+#undef SYSCALL_RESOLVE
+	}
+
+	SetSyscallFallback<NtUserEnableMouseInPointerFn>(table, table.EnableMouseInPointer, &EnableMouseInPointer, Syscall::EnableMouseInPointer);
+	SetSyscallFallback<NtUserGetPointerCursorIdFn>(table, table.GetPointerCursorId, &GetPointerCursorId, Syscall::GetPointerCursorId);
+	SetSyscallFallback<NtUserGetPointerDeviceFn>(table, table.GetPointerDevice, &GetPointerDevice, Syscall::GetPointerDevice);
+	SetSyscallFallback<NtUserGetPointerDeviceCursorsFn>(table, table.GetPointerDeviceCursors, &GetPointerDeviceCursors, Syscall::GetPointerDeviceCursors);
+	SetSyscallFallback<NtUserGetPointerDevicesFn>(table, table.GetPointerDevices, &GetPointerDevices, Syscall::GetPointerDevices);
+	SetSyscallFallback<NtUserGetPointerInputTransformFn>(table, table.GetPointerInputTransform, &GetPointerInputTransform, Syscall::GetPointerInputTransform);
+	SetSyscallFallback<NtUserGetPointerTypeFn>(table, table.GetPointerType, &GetPointerType, Syscall::GetPointerType);
+	SetSyscallFallback<NtUserInitializePointerDeviceInjectionFn>(table, table.InitializePointerDeviceInjection, &SyscallFallback::InitializePointerDeviceInjection, Syscall::InitializePointerDeviceInjection);
+	SetSyscallFallback<NtUserInjectPointerInputFn>(table, table.InjectPointerInput, &InjectSyntheticPointerInput, Syscall::InjectPointerInput);
+	SetSyscallFallback<NtUserRemoveInjectionDeviceFn>(table, table.RemoveInjectionDevice, &SyscallFallback::RemoveInjectionDevice, Syscall::RemoveInjectionDevice);
+	return table;
+}
+
+#else
+
+// There is nothing to resolve against; a mock table has to be installed with
+// SetSyscalls for any entry to be callable.
+inline SyscallTable ResolveSyscalls()
+{
+	return {};
+}
+
+#endif
+
+inline std::atomic<const SyscallTable*>& SyscallOverride()
+{
+	static std::atomic<const SyscallTable*> table{ nullptr };
+	return table;
+}
+
+// The table resolved on first use, unless one was installed with SetSyscalls.
+inline const SyscallTable& Syscalls()
+{
+	static const SyscallTable resolved = ResolveSyscalls();
+	const SyscallTable* table = SyscallOverride().load(std::memory_order_acquire);
+	return table ? *table : resolved;
+}
+
+// Swaps in another table, e.g. a mock in tests; null restores the resolved one.
+// The table must outlive its installation. Returns the previous override.
+inline const SyscallTable* SetSyscalls(const SyscallTable* table)
+{
+	return SyscallOverride().exchange(table, std::memory_order_acq_rel);
+}
+
+// Asks win32u to promote the pointer message being handled to WM_MOUSE*; see
+// the event promotion section of Syscalls.md. Entries that are missing are
+// skipped, as promotion has no user32 equivalent.
+inline void PromotePointerMessage(const SyscallTable& table, UINT32 pointerId)
+{
+	if (table.PromoteMouseInPointer)
+	{
+		table.PromoteMouseInPointer(0);
+	}
+	if (table.PromotePointer)
+	{
+		table.PromotePointer(static_cast<int>(pointerId), MAKELONG(0, 0));
+		table.PromotePointer(static_cast<int>(pointerId), MAKELONG(1, 1));
+	}
+}
+
+// The injection time is stamped into PerformanceCount so that delivery latency
+// can be measured when the frame reaches HandleMessage.
+inline POINTER_TYPE_INFO ToPointerTypeInfo(POINTER_INPUT_TYPE type, const InjectContact& contact, UINT64 performanceCount)
+{
+	POINTER_TYPE_INFO info{};
+	info.type = type;
+	POINTER_INFO& pointerInfo = type == PT_TOUCH ? info.touchInfo.pointerInfo : info.penInfo.pointerInfo;
+	pointerInfo.pointerType = type;
+	pointerInfo.pointerId = contact.pointerId;
+	pointerInfo.pointerFlags = contact.pointerFlags;
+	pointerInfo.ButtonChangeType = static_cast<POINTER_BUTTON_CHANGE_TYPE>(contact.buttonChangeType);
+	pointerInfo.ptPixelLocation.x = contact.x;
+	pointerInfo.ptPixelLocation.y = contact.y;
+	pointerInfo.PerformanceCount = performanceCount;
+	if (type == PT_TOUCH)
+	{
+		info.touchInfo.touchFlags = TOUCH_FLAG_NONE;
+		info.touchInfo.touchMask = TOUCH_MASK_PRESSURE;
+		info.touchInfo.pressure = contact.pressure;
+		info.touchInfo.orientation = contact.rotation;
+	}
+	else
+	{
+		info.penInfo.penFlags = contact.penFlags;
+		info.penInfo.penMask = contact.penMask;
+		info.penInfo.pressure = contact.pressure;
+		info.penInfo.rotation = contact.rotation;
+		info.penInfo.tiltX = contact.tiltX;
+		info.penInfo.tiltY = contact.tiltY;
+	}
+	return info;
+}
+
+// Injects through the win32u syscalls, or whatever the table falls back to.
+class NtUserInjectionBackend final : public InjectionBackend
+{
+public:
+	explicit NtUserInjectionBackend(const SyscallTable& table = Syscalls()) : m_table(table) {}
+	~NtUserInjectionBackend() { Close(); }
+
+	bool Open(POINTER_INPUT_TYPE pointerType, uint32_t maxContacts, POINTER_FEEDBACK_MODE feedback) override
+	{
+		Close();
+		if (!m_table.InitializePointerDeviceInjection || !m_table.InjectPointerInput || !m_table.RemoveInjectionDevice)
+		{
+			return false;
+		}
+		m_pointerType = pointerType;
+		m_buffer.resize(maxContacts);
+		m_table.InitializePointerDeviceInjection(pointerType, maxContacts, 0, feedback, &m_device);
+		return m_device != nullptr;
+	}
+
+	bool Inject(const InjectContact* contacts, uint32_t count) override
+	{
+		if (!m_device || count > m_buffer.size())
+		{
+			return false;
+		}
+		LARGE_INTEGER now{};
+		QueryPerformanceCounter(&now);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			m_buffer[i] = ToPointerTypeInfo(m_pointerType, contacts[i], now.QuadPart);
+		}
+		return m_table.InjectPointerInput(m_device, m_buffer.data(), count) != FALSE;
+	}
+
+	void Close() override
+	{
+		if (m_device)
+		{
+			m_table.RemoveInjectionDevice(m_device);
+			m_device = nullptr;
+		}
+	}
+
+private:
+	const SyscallTable& m_table;
+	POINTER_INPUT_TYPE m_pointerType = PT_PEN;
+	HSYNTHETICPOINTERDEVICE m_device = nullptr;
+	std::vector<POINTER_TYPE_INFO> m_buffer;
+};
@@ -0,0 +1,136 @@
+#include "Analysis.h"
+#include "Test.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+constexpr int64_t FREQUENCY = 10000000;
+
+// A pen and a touch device taking turns as the primary pointer, with
+// secondary contacts, promoted mouse messages, undecoded messages and bursts
+// that fall inside the throttle window, at irregular intervals.
+static std::vector<TraceRecord> MakeTrace(size_t count)
+{
+	std::mt19937 random{ 15 };
+	std::vector<TraceRecord> records(count);
+	int64_t timestamp = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		TraceRecord& record = records[i];
+		timestamp += random() % 8 == 0 ? 200000 + random() % 100000 : random() % 20000;
+		record.timestamp = timestamp;
+		const bool pen = (i / 500) % 2 == 0;
+		switch (random() % 10)
+		{
+		case 0:
+			record.message = WM_MOUSEMOVE;
+			continue;
+		case 1:
+			record.message = WM_TIMER;
+			continue;
+		case 2:
+			record.message = WM_POINTERDOWN;
+			break;
+		default:
+			record.message = WM_POINTERUPDATE;
+			break;
+		}
+		const bool primary = random() % 4 != 0;
+		record.wParam = MAKELONG(primary ? 1 : 2, POINTER_MESSAGE_FLAG_INRANGE | (primary ? POINTER_MESSAGE_FLAG_PRIMARY : 0));
+		if (random() % 16 != 0)
+		{
+			record.flags = TRACE_HAS_POINTER;
+			record.pointer.pointerType = pen ? PT_PEN : PT_TOUCH;
+		}
+	}
+	return records;
+}
+
+static void CheckSame(const TraceAnalysis& a, const TraceAnalysis& b)
+{
+	CHECK_EQ(a.records, b.records);
+	CHECK_EQ(a.undecoded, b.undecoded);
+	CHECK_EQ(a.unattributedMouse, b.unattributedMouse);
+	CHECK(a.messages == b.messages);
+	CHECK(a.throttled == b.throttled);
+	for (size_t kind = 0; kind < POINTER_KIND_COUNT; kind++)
+	{
+		const DeviceStats& x = a.devices[kind];
+		const DeviceStats& y = b.devices[kind];
+		CHECK_EQ(x.pointerMessages, y.pointerMessages);
+		CHECK_EQ(x.promotedMessages, y.promotedMessages);
+		CHECK_EQ(x.intervals.Count(), y.intervals.Count());
+		CHECK_EQ(x.intervals.Mean(), y.intervals.Mean());
+		CHECK_EQ(x.intervals.Percentile(50), y.intervals.Percentile(50));
+		CHECK_EQ(x.intervals.Percentile(99), y.intervals.Percentile(99));
+		CHECK(x.intervalSquares == y.intervalSquares);
+		CHECK_EQ(x.Jitter(), y.Jitter());
+	}
+}
+
+// One chunk on one thread is the plain sequential pass every other split has
+// to reproduce.
+TEST(Analysis, SameForAnyThreadsAndChunks)
+{
+	const std::vector<TraceRecord> records = MakeTrace(20000);
+	AnalysisOptions options{};
+	options.threads = 1;
+	options.chunkRecords = records.size();
+	const TraceAnalysis expected = AnalyzeTrace(records.data(), records.size(), FREQUENCY, options);
+	CHECK_EQ(expected.records, uint64_t{ 20000 });
+	CHECK(expected.undecoded > 0);
+	CHECK(expected.devices[PT_PEN].promotedMessages > 0);
+	CHECK(expected.devices[PT_TOUCH].intervals.Count() > 0);
+
+	const size_t hardware = std::max<size_t>(std::thread::hardware_concurrency(), 3);
+	for (const size_t threads : { size_t{ 1 }, size_t{ 2 }, hardware })
+	{
+		for (const size_t chunkRecords : { size_t{ 1 }, size_t{ 7 }, size_t{ 500 }, size_t{ 4096 }, records.size() + 1 })
+		{
+			options.threads = threads;
+			options.chunkRecords = chunkRecords;
+			CheckSame(AnalyzeTrace(records.data(), records.size(), FREQUENCY, options), expected);
+		}
+	}
+}
+
+// Updates 1 ms apart against a 10 ms window: one in ten is let through, even
+// when every update is a chunk of its own.
+TEST(Analysis, ThrottleAcrossChunks)
+{
+	std::vector<TraceRecord> records(100);
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		records[i].message = WM_POINTERUPDATE;
+		records[i].timestamp = static_cast<int64_t>(i) * FREQUENCY / 1000;
+	}
+	const size_t index = static_cast<size_t>(FindMessage(WM_POINTERUPDATE) - g_Messages);
+	AnalysisOptions options{};
+	options.throttleWindow = std::chrono::milliseconds(10);
+	for (const size_t chunkRecords : { size_t{ 1 }, size_t{ 3 }, size_t{ 100 } })
+	{
+		options.chunkRecords = chunkRecords;
+		const TraceAnalysis analysis = AnalyzeTrace(records.data(), records.size(), FREQUENCY, options);
+		CHECK_EQ(analysis.throttled[index], uint64_t{ 90 });
+	}
+}
+
+TEST(Analysis, SquareSumIsExact)
+{
+	SquareSum sum{};
+	sum.Add((uint64_t{ 1 } << 32) + 1);
+	CHECK_EQ(sum.low, (uint64_t{ 1 } << 33) + 1);
+	CHECK_EQ(sum.high, uint64_t{ 1 });
+	SquareSum big{};
+	big.Add(UINT64_MAX);
+	// (2^64 - 1)^2 = 2^128 - 2^65 + 1
+	CHECK_EQ(big.low, uint64_t{ 1 });
+	CHECK_EQ(big.high, UINT64_MAX - 1);
+	sum.Merge(big);
+	CHECK_EQ(sum.low, (uint64_t{ 1 } << 33) + 2);
+	CHECK_EQ(sum.high, UINT64_MAX);
+	CHECK_EQ(SquareSum{}.Value(), 0.0);
+}
@@ -0,0 +1,116 @@
+#include "BatchDecode.h"
+#include "Print.h"
+#include "Test.h"
+#include <cstdint>
+#include <random>
+#include <vector>
+
+static std::vector<DecodeKernel> Kernels()
+{
+	std::vector<DecodeKernel> kernels{ DecodeKernel::Scalar };
+#ifdef BATCH_DECODE_X86
+	kernels.push_back(DecodeKernel::SSE2);
+	if (HasAVX2())
+	{
+		kernels.push_back(DecodeKernel::AVX2);
+	}
+#endif
+	return kernels;
+}
+
+// Parameters that start with every single flag bit and every extreme
+// coordinate, then carry on at random. The high 32 bits are filled too, since
+// the macros ignore them.
+static void MakeParams(size_t count, std::vector<uint64_t>& wParam, std::vector<int64_t>& lParam)
+{
+	const int16_t coordinates[] = { 0, 1, -1, INT16_MAX, INT16_MIN, -2, 1920, -1080 };
+	std::mt19937_64 random{ 14 };
+	wParam.resize(count);
+	lParam.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		const uint64_t high = random() & 0xFFFFFFFF00000000;
+		const uint16_t flags = i < 16 ? static_cast<uint16_t>(1u << i) : static_cast<uint16_t>(random());
+		wParam[i] = high | static_cast<uint32_t>(MAKELONG(static_cast<WORD>(random()), flags));
+		const int16_t x = i < 64 ? coordinates[i % 8] : static_cast<int16_t>(random());
+		const int16_t y = i < 64 ? coordinates[i / 8] : static_cast<int16_t>(random());
+		lParam[i] = static_cast<int64_t>(high | static_cast<uint32_t>(MAKELONG(x, y)));
+	}
+}
+
+// Checks every decoded column against the macros applied to one message at a
+// time, and the flags against PointerState's reading of them.
+static void CheckColumns(const std::vector<uint64_t>& wParam, const std::vector<int64_t>& lParam, const PointerParamColumns& columns, DecodeKernel kernel)
+{
+	CHECK_EQ(columns.Size(), wParam.size());
+	for (size_t i = 0; i < columns.Size(); i++)
+	{
+		const WPARAM w = static_cast<WPARAM>(wParam[i]);
+		const LPARAM l = static_cast<LPARAM>(lParam[i]);
+		bool flagsMatch = true;
+		for (uint32_t bit = 0; bit < 16; bit++)
+		{
+			flagsMatch &= IS_POINTER_FLAG_SET_WPARAM(w, 1u << bit) == ((columns.flags[i] & (1u << bit)) != 0);
+		}
+		if (columns.pointerId[i] != GET_POINTERID_WPARAM(w) || !flagsMatch || PointerState(MAKELONG(0, columns.flags[i])) != PointerState(w)
+			|| columns.x[i] != GET_X_LPARAM(l) || columns.y[i] != GET_Y_LPARAM(l))
+		{
+			CHECK_EQ(fmt::format("{} kernel, {} messages, at {}: {:#x} {:#x} {} {}", DecodeKernelName(kernel), columns.Size(), i, columns.pointerId[i], columns.flags[i], columns.x[i], columns.y[i]),
+				fmt::format("{:#x} {:#x} {} {}", GET_POINTERID_WPARAM(w), HIWORD(w), GET_X_LPARAM(l), GET_Y_LPARAM(l)));
+			return;
+		}
+	}
+}
+
+// Every length up to a few vector widths, so that each kernel's tail is taken
+// with every remainder, and one long run.
+TEST(BatchDecode, KernelsMatchMacros)
+{
+	std::vector<uint64_t> wParam;
+	std::vector<int64_t> lParam;
+	for (const DecodeKernel kernel : Kernels())
+	{
+		for (size_t count = 0; count <= 70; count++)
+		{
+			MakeParams(count, wParam, lParam);
+			PointerParamColumns columns{};
+			DecodeParams(wParam.data(), lParam.data(), count, columns, kernel);
+			CheckColumns(wParam, lParam, columns, kernel);
+		}
+		MakeParams(4099, wParam, lParam);
+		PointerParamColumns columns{};
+		DecodeParams(wParam.data(), lParam.data(), wParam.size(), columns, kernel);
+		CheckColumns(wParam, lParam, columns, kernel);
+	}
+}
+
+// The kernels only write the columns' first `count` entries, so a decode into
+// the middle of larger arrays leaves the rest alone.
+TEST(BatchDecode, KernelsStayInBounds)
+{
+	std::vector<uint64_t> wParam;
+	std::vector<int64_t> lParam;
+	MakeParams(64, wParam, lParam);
+	for (const DecodeKernel kernel : Kernels())
+	{
+		for (size_t count : { 7u, 15u, 17u, 31u, 33u })
+		{
+			std::vector<uint16_t> pointerId(count + 2, 0xAAAA);
+			std::vector<uint16_t> flags(count + 2, 0xAAAA);
+			std::vector<int32_t> x(count + 2, -7);
+			std::vector<int32_t> y(count + 2, -7);
+			switch (kernel)
+			{
+#ifdef BATCH_DECODE_X86
+			case DecodeKernel::AVX2: DecodeParamsAVX2(wParam.data(), lParam.data(), count, pointerId.data() + 1, flags.data() + 1, x.data() + 1, y.data() + 1); break;
+			case DecodeKernel::SSE2: DecodeParamsSSE2(wParam.data(), lParam.data(), count, pointerId.data() + 1, flags.data() + 1, x.data() + 1, y.data() + 1); break;
+#endif
+			default: DecodeParamsScalar(wParam.data(), lParam.data(), count, pointerId.data() + 1, flags.data() + 1, x.data() + 1, y.data() + 1); break;
+			}
+			CHECK(pointerId.front() == 0xAAAA && pointerId.back() == 0xAAAA);
+			CHECK(flags.front() == 0xAAAA && flags.back() == 0xAAAA);
+			CHECK(x.front() == -7 && x.back() == -7 && y.front() == -7 && y.back() == -7);
+			CHECK_EQ(x[count], GET_X_LPARAM(static_cast<LPARAM>(lParam[count - 1])));
+		}
+	}
+}
@@ -0,0 +1,294 @@
+#include "BatchDecode.h"
+#include "CoordinateTransform.h"
+#include "DpiLayout.h"
+#include "Test.h"
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// AxisTransform::Apply worked out in 64 bits, without MulDivRound: round half
+// away from zero, -1 where MulDiv fails, and a 32-bit wrap of the origin and
+// offset.
+static int32_t Reference(const AxisTransform& axis, int32_t value)
+{
+	const int32_t relative = static_cast<int32_t>(static_cast<uint32_t>(value) - static_cast<uint32_t>(axis.origin));
+	int32_t scaled = -1;
+	if (axis.denominator != 0)
+	{
+		const int64_t product = static_cast<int64_t>(relative) * axis.numerator;
+		const int64_t dividend = product < 0 ? -product : product;
+		const int64_t divisor = axis.denominator < 0 ? -static_cast<int64_t>(axis.denominator) : axis.denominator;
+		const int64_t magnitude = dividend / divisor + (dividend % divisor * 2 >= divisor ? 1 : 0);
+		const int64_t result = (product < 0) != (axis.denominator < 0) ? -magnitude : magnitude;
+		if (result >= INT32_MIN && result <= INT32_MAX)
+		{
+			scaled = static_cast<int32_t>(result);
+		}
+	}
+	return static_cast<int32_t>(static_cast<uint32_t>(axis.offset) + static_cast<uint32_t>(scaled));
+}
+
+static std::vector<DecodeKernel> Kernels()
+{
+	std::vector<DecodeKernel> kernels{ DecodeKernel::Scalar };
+#ifdef BATCH_DECODE_X86
+	kernels.push_back(DecodeKernel::SSE2);
+	if (HasAVX2())
+	{
+		kernels.push_back(DecodeKernel::AVX2);
+	}
+#endif
+	return kernels;
+}
+
+static int32_t Reference(const std::vector<CoordinateTransform>& steps, bool y, int32_t value)
+{
+	for (const CoordinateTransform& step : steps)
+	{
+		value = Reference(y ? step.y : step.x, value);
+	}
+	return value;
+}
+
+static std::string Describe(const std::vector<CoordinateTransform>& steps)
+{
+	std::string text;
+	for (const CoordinateTransform& step : steps)
+	{
+		for (const AxisTransform& axis : { step.x, step.y })
+		{
+			text += fmt::format("({}, {}, {}, {}) ", axis.origin, axis.numerator, axis.denominator, axis.offset);
+		}
+	}
+	return text;
+}
+
+// Runs every kernel over `values`, as x and reversed as y, and checks each
+// result against the reference applied step by step. The inputs are not a
+// multiple of eight long, so every kernel's tail is covered as well.
+static void CheckKernels(const std::vector<CoordinateTransform>& steps, const std::vector<int32_t>& values)
+{
+	TransformChain chain{};
+	for (const CoordinateTransform& step : steps)
+	{
+		CHECK(chain.Append(step));
+	}
+	const std::vector<int32_t> reversed(values.rbegin(), values.rend());
+	for (const DecodeKernel kernel : Kernels())
+	{
+		std::vector<int32_t> x(values.size());
+		std::vector<int32_t> y(values.size());
+		TransformPoints(chain, values.data(), reversed.data(), values.size(), x.data(), y.data(), kernel);
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			if (x[i] != Reference(steps, false, values[i]) || y[i] != Reference(steps, true, reversed[i]))
+			{
+				CHECK_EQ(
+					fmt::format("kernel {} of {}at ({}, {}): ({}, {})", static_cast<int>(kernel), Describe(steps), values[i], reversed[i], x[i], y[i]),
+					fmt::format("({}, {})", Reference(steps, false, values[i]), Reference(steps, true, reversed[i])));
+				break;
+			}
+		}
+	}
+}
+
+static void CheckKernels(const AxisTransform& axis, const std::vector<int32_t>& values)
+{
+	CheckKernels({ { axis, axis } }, values);
+}
+
+static std::vector<int32_t> Values()
+{
+	std::vector<int32_t> values{ INT32_MIN, INT32_MIN + 1, INT32_MAX, INT32_MAX - 1, 0, 1, -1, 2, -2, 3, -3, 5, -5, 7, -7, 4095, -4095, 65535, -65536 };
+	std::mt19937 random{ 25 };
+	std::uniform_int_distribution<int32_t> wide{ INT32_MIN, INT32_MAX };
+	std::uniform_int_distribution<int32_t> narrow{ -100000, 100000 };
+	for (int i = 0; i < 500; i++)
+	{
+		values.push_back(i % 2 ? wide(random) : narrow(random));
+	}
+	values.push_back(9);
+	return values;
+}
+
+TEST(CoordinateTransform, MulDivRound)
+{
+	// Half away from zero, whatever the signs.
+	CHECK_EQ(MulDivRound(3, 1, 2), 2);
+	CHECK_EQ(MulDivRound(-3, 1, 2), -2);
+	CHECK_EQ(MulDivRound(3, 1, -2), -2);
+	CHECK_EQ(MulDivRound(-3, -1, -2), -2);
+	CHECK_EQ(MulDivRound(5, 1, 4), 1);
+	CHECK_EQ(MulDivRound(-5, 1, 4), -1);
+	// MulDiv's failures.
+	CHECK_EQ(MulDivRound(10, 10, 0), -1);
+	CHECK_EQ(MulDivRound(INT32_MAX, 2, 1), -1);
+	CHECK_EQ(MulDivRound(INT32_MIN, -1, 1), -1);
+	CHECK_EQ(MulDivRound(INT32_MIN, 1, 1), INT32_MIN);
+	CHECK_EQ(MulDivRound(INT32_MAX, INT32_MAX, INT32_MAX), INT32_MAX);
+}
+
+TEST(CoordinateTransform, KernelsMatchReference)
+{
+	const std::vector<int32_t> values = Values();
+	const int32_t limit = AxisTransform::VECTOR_NUMERATOR_LIMIT;
+	const int32_t numerators[] = { 1, -1, 2, 3, -3, 7, 96, 144, -144, 2540, limit - 1, limit, -limit, limit + 1, -limit - 1, INT32_MAX, INT32_MIN, 0 };
+	const int32_t denominators[] = { 1, -1, 2, -2, 3, 4, -4, 96, 2540, -2540, 65536, INT32_MAX, INT32_MIN, 0 };
+	for (const int32_t numerator : numerators)
+	{
+		for (const int32_t denominator : denominators)
+		{
+			CheckKernels({ 0, numerator, denominator, 0 }, values);
+			CheckKernels({ 1000, numerator, denominator, -37 }, values);
+		}
+	}
+}
+
+// An origin or offset that pushes the result past 32 bits wraps around, in
+// every kernel alike.
+TEST(CoordinateTransform, OriginAndOffsetWrap)
+{
+	const std::vector<int32_t> values = Values();
+	for (const int32_t edge : { INT32_MIN, INT32_MAX, -1, 1 })
+	{
+		CheckKernels({ edge, 1, 1, 0 }, values);
+		CheckKernels({ 0, 1, 1, edge }, values);
+		CheckKernels({ edge, 3, -2, edge }, values);
+	}
+	CHECK_EQ((AxisTransform{ 1, 1, 1, 0 }.Apply(INT32_MIN)), INT32_MAX);
+	CHECK_EQ((AxisTransform{ 0, 1, 1, 1 }.Apply(INT32_MAX)), INT32_MIN);
+}
+
+// Every .5 rounds away from zero, in the vector kernels as well.
+TEST(CoordinateTransform, Ties)
+{
+	std::vector<int32_t> values;
+	for (int32_t i = -1001; i <= 1001; i += 2)
+	{
+		values.push_back(i);
+	}
+	CheckKernels({ 0, 1, 2, 0 }, values);
+	CheckKernels({ 0, -1, 2, 0 }, values);
+	CheckKernels({ 0, 1, -2, 0 }, values);
+	CheckKernels({ 0, 3, 6, 0 }, values);
+	CheckKernels({ 0, AxisTransform::VECTOR_NUMERATOR_LIMIT, 2 * AxisTransform::VECTOR_NUMERATOR_LIMIT, 0 }, values);
+	PointerParamColumns columns{};
+	columns.x = values;
+	columns.y = values;
+	TransformPoints({ DpiScale(2, 1) }, columns);
+	CHECK_EQ(columns.x.front(), -501);
+	CHECK_EQ(columns.y.back(), 501);
+}
+
+// Values whose rounded quotient is a whole number that a reciprocal rounded to
+// nearest falls just short of, for a divisor of 49.
+TEST(CoordinateTransform, WholeQuotients)
+{
+	for (const auto& [numerator, first] : { std::pair{ 3, 2127483658 }, std::pair{ 96, 2127483678 }, std::pair{ 2540, 2127483669 } })
+	{
+		std::vector<int32_t> values;
+		for (int32_t i = 0; i < 1000; i++)
+		{
+			values.push_back(first + i * 49);
+			values.push_back(-first - i * 49);
+		}
+		CheckKernels({ 0, numerator, 49, 0 }, values);
+	}
+}
+
+// Chains of every kind of step, each rounding on its own, give what applying
+// the steps one at a time gives.
+TEST(CoordinateTransform, ChainsMatchSteps)
+{
+	const std::vector<int32_t> values = Values();
+	const RECT himetric{ 0, 0, 29376, 16524 };
+	const RECT pixels{ 0, 0, 2560, 1440 };
+	CheckKernels({ PixelsToHimetric(himetric, pixels), ScreenToClient({ 100, 50 }), DpiScale(144, DEFAULT_DPI) }, values);
+	CheckKernels({ HimetricToPixels(himetric, { 1920, -200, 4480, 1240 }), ScreenToClient({ -7, 3 }), DpiScale(DEFAULT_DPI, 120), DpiScale(120, 144) }, values);
+	CheckKernels({ ScreenToClient({ INT32_MAX, INT32_MIN }), ScreenToClient({ 5, -5 }) }, values);
+
+	std::mt19937 random{ 2025 };
+	const int32_t limit = AxisTransform::VECTOR_NUMERATOR_LIMIT;
+	const int32_t scales[] = { 1, -1, 2, -3, 96, 144, 2540, limit, -limit, limit + 1, 0, INT32_MIN };
+	std::uniform_int_distribution<size_t> pick{ 0, std::size(scales) - 1 };
+	std::uniform_int_distribution<size_t> length{ 1, TransformChain::MAX_STEPS };
+	std::uniform_int_distribution<int32_t> shift{ -3000, 3000 };
+	std::uniform_int_distribution<int32_t> wide{ INT32_MIN, INT32_MAX };
+	const auto axis = [&]
+	{
+		const int32_t numerator = scales[pick(random)];
+		// One step in four scales by exactly one.
+		const int32_t denominator = random() % 4 ? scales[pick(random)] : numerator;
+		const bool far = random() % 8 == 0;
+		return AxisTransform{ far ? wide(random) : shift(random), numerator, denominator, far ? wide(random) : shift(random) };
+	};
+	for (int i = 0; i < 300; i++)
+	{
+		std::vector<CoordinateTransform> steps(length(random));
+		for (CoordinateTransform& step : steps)
+		{
+			step = { axis(), axis() };
+		}
+		CheckKernels(steps, values);
+	}
+}
+
+TEST(CoordinateTransform, ChainFoldsUnitSteps)
+{
+	const TransformChain chain{ HimetricToPixels({ 0, 0, 29376, 16524 }, { 0, 0, 2560, 1440 }), ScreenToClient({ 100, 50 }), DpiScale(144, DEFAULT_DPI) };
+	CHECK_EQ(chain.Steps(), size_t{ 3 });
+	CHECK_EQ(chain.X().scales, size_t{ 2 });
+	CHECK_EQ(chain.X().shift[1], -100);
+	CHECK(chain.Vectorizable());
+	CHECK_EQ(TransformChain{ ScreenToClient({ 100, 50 }) }.Y().scales, size_t{ 0 });
+	// A numerator beyond the limit is fine in a step that scales by one.
+	CHECK((TransformChain{ { { 0, INT32_MAX, INT32_MAX, 0 }, { 0, 1, 1, 0 } } }.Vectorizable()));
+	CHECK(!(TransformChain{ DpiScale(1, AxisTransform::VECTOR_NUMERATOR_LIMIT + 1) }.Vectorizable()));
+
+	TransformChain full{};
+	for (size_t i = 0; i < TransformChain::MAX_STEPS; i++)
+	{
+		CHECK(full.Append(DpiScale(2, 3)));
+	}
+	CHECK(!full.Append(DpiScale(2, 3)));
+	CHECK_EQ(full.Steps(), TransformChain::MAX_STEPS);
+	CHECK_EQ(full.Apply({ 16, -16 }).x, 81);
+}
+
+TEST(CoordinateTransform, CacheBuildsOncePerKey)
+{
+	std::vector<TransformKey> built;
+	TransformCache cache([&](const TransformKey& key)
+	{
+		built.push_back(key);
+		return TransformChain{ DpiScale(DEFAULT_DPI, key.dpi) };
+	}, 2);
+	HANDLE pen = reinterpret_cast<HANDLE>(1);
+	HANDLE touch = reinterpret_cast<HANDLE>(2);
+	HMONITOR monitor = reinterpret_cast<HMONITOR>(3);
+
+	CHECK_EQ(cache.Get({ pen, monitor, 144 }).Apply({ 10, 10 }).x, 15);
+	CHECK_EQ(cache.Get({ pen, monitor, 144 }).Apply({ 10, 10 }).x, 15);
+	CHECK_EQ(cache.Get({ touch, monitor, 192 }).Apply({ 10, 10 }).x, 20);
+	CHECK_EQ(cache.Hits(), uint64_t{ 1 });
+	CHECK_EQ(cache.Misses(), uint64_t{ 2 });
+
+	// The least recently used key goes first.
+	cache.Get({ pen, monitor, 144 });
+	cache.Get({ pen, nullptr, 144 });
+	CHECK_EQ(cache.Evictions(), uint64_t{ 1 });
+	CHECK_EQ(cache.Size(), size_t{ 2 });
+	cache.Get({ pen, monitor, 144 });
+	CHECK_EQ(cache.Hits(), uint64_t{ 3 });
+
+	// A remapped device's chains are built again.
+	cache.Invalidate(pen);
+	CHECK_EQ(cache.Size(), size_t{ 0 });
+	cache.Get({ pen, monitor, 144 });
+	CHECK_EQ(built.size(), size_t{ 4 });
+	cache.Clear();
+	CHECK_EQ(cache.Size(), size_t{ 0 });
+}
@@ -0,0 +1,95 @@
+#include "Decode.h"
+#include "EventLog.h"
+#include "LogSink.h"
+#include "Print.h"
+#include "Test.h"
+#include "Trace.h"
+#include <fmt/format.h>
+#include <string>
+
+static TraceRecord Message(UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	TraceRecord record{};
+	record.message = uMsg;
+	record.wParam = wParam;
+	record.lParam = lParam;
+	return record;
+}
+
+static std::string Decode(const TraceRecord& record, bool terse, uint32_t throttled = 0)
+{
+	StringLogSink output{};
+	TextEventSink text{ output };
+	LogMessage(text, record, terse, throttled);
+	text.Flush();
+	return output.Text();
+}
+
+constexpr WPARAM CONTACT_FLAGS = POINTER_MESSAGE_FLAG_INRANGE | POINTER_MESSAGE_FLAG_INCONTACT | POINTER_MESSAGE_FLAG_FIRSTBUTTON | POINTER_MESSAGE_FLAG_PRIMARY;
+
+TEST(Decode, PointerMessage)
+{
+	CHECK_EQ(
+		Decode(Message(WM_POINTERDOWN, MAKELONG(1, CONTACT_FLAGS), MAKELONG(100, 200)), false),
+		"\n"
+		"WM_POINTERDOWN(wParam: 0x20160001, lParam: 0x00c80064)\n"
+		"; - GET_POINTERID_WPARAM(wParam) = 1  pointer identifier\n"
+		"; - PointerState(wParam) = !NEW INRANGE INCONTACT PRIMARY [X| | | | ]  pointer state\n"
+		"; - GET_X_LPARAM(lParam) = 100  x coordinate\n"
+		"; - GET_Y_LPARAM(lParam) = 200  y coordinate\n"
+	);
+}
+
+TEST(Decode, TerseWithThrottledCount)
+{
+	CHECK_EQ(
+		Decode(Message(WM_MOUSEMOVE, MK_LBUTTON | MK_SHIFT, MAKELONG(-1, 5)), true, 3),
+		"WM_MOUSEMOVE(wParam: 0x00000005, lParam: 0x0005ffff)\n"
+		"; (throttled 3 previous WM_MOUSEMOVE messages)\n"
+	);
+}
+
+TEST(Decode, NegativeCoordinates)
+{
+	const std::string text = Decode(Message(WM_MOUSEMOVE, 0, MAKELONG(-20, -30)), false);
+	CHECK(text.find("GET_X_LPARAM(lParam) = -20 ") != std::string::npos);
+	CHECK(text.find("GET_Y_LPARAM(lParam) = -30 ") != std::string::npos);
+	CHECK(text.find("!SHIFT !CTRL [ | | | | ]") != std::string::npos);
+}
+
+TEST(Decode, DeviceChange)
+{
+	CHECK(Decode(Message(WM_POINTERDEVICECHANGE, PDC_ARRIVAL, 0), false).find("PDC_STR(wParam) = PDC_ARRIVAL ") != std::string::npos);
+	CHECK_EQ(PDC_STR(PDC_MAPPING_CHANGE), "PDC_MAPPING_CHANGE");
+	CHECK_EQ(PDC_STR(0x7777), "30583");
+}
+
+TEST(Decode, UnknownMessages)
+{
+	CHECK(FindMessage(WM_TIMER) == nullptr);
+	CHECK(FindMessage(0xFFFF) == nullptr);
+	CHECK_EQ(Decode(Message(WM_TIMER, 0, 0), false), "");
+	for (const MessageInfo& info : g_Messages)
+	{
+		CHECK(FindMessage(info.id) == &info);
+	}
+}
+
+TEST(Decode, StateFormatters)
+{
+	fmt::memory_buffer buffer;
+	FormatPointerState(fmt::appender(buffer), MAKELONG(7, POINTER_MESSAGE_FLAG_NEW | POINTER_MESSAGE_FLAG_SECONDBUTTON | POINTER_MESSAGE_FLAG_FIFTHBUTTON));
+	CHECK_EQ(fmt::to_string(buffer), "NEW !INRANGE !INCONTACT !PRIMARY [ |X| | |X]");
+	CHECK_EQ(PointerState(0), "!NEW !INRANGE !INCONTACT !PRIMARY [ | | | | ]");
+	CHECK_EQ(MouseState(MK_CONTROL | MK_RBUTTON | MK_XBUTTON2), "!SHIFT CTRL [ |X| | |X]");
+}
+
+// WM_MOUSEHWHEEL was never logged by the demo, so it is neither traced nor
+// decoded.
+TEST(Decode, TracedMessages)
+{
+	CHECK(IsTracedMessage(WM_MOUSEWHEEL));
+	CHECK(IsTracedMessage(WM_XBUTTONDBLCLK));
+	CHECK(!IsTracedMessage(WM_MOUSEHWHEEL));
+	CHECK(FindMessage(WM_MOUSEHWHEEL) == nullptr);
+}
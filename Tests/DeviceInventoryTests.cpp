@@ -0,0 +1,186 @@
+#include "DeviceInventory.h"
+#include "Test.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+static HANDLE Device(uintptr_t id)
+{
+	return reinterpret_cast<HANDLE>(id);
+}
+
+constexpr PointerDeviceRects RECTS{ { 0, 0, 29376, 16524 }, { 0, 0, 2560, 1440 } };
+constexpr PointerDeviceRects RIGHT_SCREEN{ { 0, 0, 29376, 16524 }, { 2560, 0, 5120, 1440 } };
+
+// The inventory over a scripted source holding devices 1 to `count`, with the
+// source kept at hand to script changes and read the query counts.
+struct Fixture
+{
+	ScriptedDeviceSource* source = nullptr;
+	std::unique_ptr<DeviceInventory> inventory;
+
+	explicit Fixture(uintptr_t count)
+	{
+		auto scripted = std::make_unique<ScriptedDeviceSource>();
+		source = scripted.get();
+		for (uintptr_t id = 1; id <= count; id++)
+		{
+			Attach(id);
+		}
+		inventory = std::make_unique<DeviceInventory>(std::move(scripted));
+	}
+
+	void Attach(uintptr_t id, const PointerDeviceRects& rects = RECTS)
+	{
+		source->Attach({ Device(id), id % 2 ? PointerDeviceType::IntegratedPen : PointerDeviceType::Touch, static_cast<uint32_t>(id), 0, 0 }, rects, std::vector<PointerDeviceProperty>(id));
+	}
+
+	// Queries made by one update, as listings, rectangles and properties.
+	struct Queries
+	{
+		uint64_t listings;
+		uint64_t rects;
+		uint64_t properties;
+	};
+
+	Queries Update(WPARAM change, DeviceInventoryChange& result)
+	{
+		const Queries before{ source->Enumerations(), source->RectQueries(), source->PropertyQueries() };
+		result = inventory->Update(change);
+		return { source->Enumerations() - before.listings, source->RectQueries() - before.rects, source->PropertyQueries() - before.properties };
+	}
+};
+
+// Checks that every attached device is found by its handle with what it was
+// attached with, and that `missing` is not.
+static void CheckLookups(const DeviceInventory& inventory, uintptr_t first, uintptr_t last, uintptr_t missing)
+{
+	for (uintptr_t id = first; id <= last; id++)
+	{
+		const PointerDeviceEntry* entry = inventory.Find(Device(id));
+		CHECK(entry != nullptr);
+		if (entry)
+		{
+			CHECK(entry->description.device == Device(id));
+			CHECK_EQ(entry->description.maxActiveContacts, static_cast<uint32_t>(id));
+			CHECK_EQ(entry->properties.size(), static_cast<size_t>(id));
+		}
+	}
+	CHECK(inventory.Find(Device(missing)) == nullptr);
+}
+
+TEST(DeviceInventory, Refresh)
+{
+	Fixture fixture{ 4 };
+	const DeviceInventoryChange result = fixture.inventory->Refresh();
+	CHECK_EQ(result.added, 4u);
+	CHECK(!result.failed);
+	CHECK_EQ(fixture.inventory->Size(), 4u);
+	CHECK_EQ(fixture.source->Enumerations(), uint64_t{ 1 });
+	CHECK_EQ(fixture.source->RectQueries(), uint64_t{ 4 });
+	CHECK_EQ(fixture.source->PropertyQueries(), uint64_t{ 4 });
+	CheckLookups(*fixture.inventory, 1, 4, 5);
+	const PointerDeviceEntry* entry = fixture.inventory->Find(Device(2));
+	CHECK(entry && entry->transform.Apply({ 29376, 16524 }).x == 2560);
+}
+
+// An arrival queries only the new device.
+TEST(DeviceInventory, Arrival)
+{
+	Fixture fixture{ 4 };
+	fixture.inventory->Refresh();
+	fixture.Attach(5);
+	DeviceInventoryChange result{};
+	const Fixture::Queries queries = fixture.Update(PDC_ARRIVAL, result);
+	CHECK_EQ(result.added, 1u);
+	CHECK_EQ(result.removed + result.remapped, 0u);
+	CHECK_EQ(queries.listings, uint64_t{ 1 });
+	CHECK_EQ(queries.rects, uint64_t{ 1 });
+	CHECK_EQ(queries.properties, uint64_t{ 1 });
+	CheckLookups(*fixture.inventory, 1, 5, 6);
+}
+
+// A removal lists the devices and queries none of them; the entry moved into
+// the removed one's place is still found by its handle.
+TEST(DeviceInventory, Removal)
+{
+	Fixture fixture{ 4 };
+	fixture.inventory->Refresh();
+	fixture.source->Detach(Device(1));
+	DeviceInventoryChange result{};
+	const Fixture::Queries queries = fixture.Update(PDC_REMOVAL, result);
+	CHECK_EQ(result.removed, 1u);
+	CHECK_EQ(result.added + result.remapped, 0u);
+	CHECK_EQ(queries.listings, uint64_t{ 1 });
+	CHECK_EQ(queries.rects + queries.properties, uint64_t{ 0 });
+	CHECK_EQ(fixture.inventory->Size(), 3u);
+	CheckLookups(*fixture.inventory, 2, 4, 1);
+}
+
+// A mapping change queries the rectangles of every device, but none of their
+// properties.
+TEST(DeviceInventory, MappingChange)
+{
+	Fixture fixture{ 4 };
+	fixture.inventory->Refresh();
+	fixture.source->Remap(Device(3), RIGHT_SCREEN);
+	DeviceInventoryChange result{};
+	const Fixture::Queries queries = fixture.Update(PDC_MAPPING_CHANGE, result);
+	CHECK_EQ(result.remapped, 4u);
+	CHECK_EQ(result.added + result.removed, 0u);
+	CHECK_EQ(queries.listings, uint64_t{ 1 });
+	CHECK_EQ(queries.rects, uint64_t{ 4 });
+	CHECK_EQ(queries.properties, uint64_t{ 0 });
+	CheckLookups(*fixture.inventory, 1, 4, 5);
+	const PointerDeviceEntry* entry = fixture.inventory->Find(Device(3));
+	CHECK(entry && entry->rects.pixels.left == 2560);
+	CHECK(entry && entry->transform.Apply({ 0, 0 }).x == 2560);
+
+	// A change that moves nothing only lists the devices.
+	const Fixture::Queries quiet = fixture.Update(PDC_ARRIVAL, result);
+	CHECK_EQ(result.remapped, 0u);
+	CHECK_EQ(quiet.rects + quiet.properties, uint64_t{ 0 });
+}
+
+// Whatever a failed query was for is asked again on the next update, and
+// only that.
+TEST(DeviceInventory, RetriesFailedQueries)
+{
+	Fixture fixture{ 2 };
+	fixture.inventory->Refresh();
+
+	// A device that arrives while the source fails is added afterwards.
+	fixture.Attach(3);
+	fixture.source->SetFailing(true);
+	DeviceInventoryChange result{};
+	fixture.Update(PDC_ARRIVAL, result);
+	CHECK(result.failed);
+	CHECK_EQ(fixture.inventory->Size(), 2u);
+	CHECK(fixture.inventory->Find(Device(3)) == nullptr);
+	fixture.source->SetFailing(false);
+	Fixture::Queries queries = fixture.Update(0, result);
+	CHECK(!result.failed);
+	CHECK_EQ(result.added, 1u);
+	CHECK_EQ(queries.rects, uint64_t{ 1 });
+	CHECK_EQ(queries.properties, uint64_t{ 1 });
+	CheckLookups(*fixture.inventory, 1, 3, 4);
+
+	// So is a mapping change that came while the source was failing.
+	fixture.source->Remap(Device(2), RIGHT_SCREEN);
+	fixture.source->SetFailing(true);
+	fixture.Update(PDC_MAPPING_CHANGE, result);
+	CHECK(result.failed);
+	CHECK_EQ(fixture.inventory->Find(Device(2))->rects.pixels.left, 0);
+	fixture.source->SetFailing(false);
+	queries = fixture.Update(0, result);
+	CHECK(!result.failed);
+	CHECK_EQ(result.remapped, 3u);
+	CHECK_EQ(queries.rects, uint64_t{ 3 });
+	CHECK_EQ(queries.properties, uint64_t{ 0 });
+	CHECK_EQ(fixture.inventory->Find(Device(2))->rects.pixels.left, 2560);
+	CheckLookups(*fixture.inventory, 1, 3, 4);
+
+	// Once done, the retry is not repeated.
+	queries = fixture.Update(0, result);
+	CHECK_EQ(queries.rects + queries.properties, uint64_t{ 0 });
+}
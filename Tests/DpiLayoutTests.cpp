@@ -0,0 +1,136 @@
+#include "DpiLayout.h"
+#include "Test.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Resources that record which DPI they were created for and whether they are
+// still alive.
+struct FakeResources
+{
+	std::shared_ptr<uint32_t> dpi;
+};
+
+struct FakeFactory
+{
+	std::vector<uint32_t> created;
+	std::vector<std::weak_ptr<uint32_t>> alive;
+
+	DpiCache<FakeResources>::Factory Bind()
+	{
+		return [this](uint32_t dpi)
+		{
+			created.push_back(dpi);
+			auto resources = FakeResources{ std::make_shared<uint32_t>(dpi) };
+			alive.push_back(resources.dpi);
+			return resources;
+		};
+	}
+
+	size_t Alive() const
+	{
+		size_t count = 0;
+		for (const auto& resources : alive)
+		{
+			count += !resources.expired();
+		}
+		return count;
+	}
+};
+
+TEST(DpiLayout, CacheEvictsLeastRecentlyUsed)
+{
+	FakeFactory factory{};
+	DpiCache<FakeResources> cache{ factory.Bind(), 3 };
+	cache.Get(96);
+	cache.Get(120);
+	cache.Get(144);
+	// 96 becomes the most recent, leaving 120 the least.
+	CHECK_EQ(*cache.Get(96).dpi, 96u);
+	CHECK_EQ(*cache.Get(192).dpi, 192u);
+	CHECK_EQ(cache.Evictions(), 1u);
+	CHECK(factory.alive[1].expired());
+	CHECK_EQ(factory.Alive(), 3u);
+
+	// 144 is now the least recent.
+	cache.Get(120);
+	CHECK(factory.alive[2].expired());
+	CHECK(factory.created == std::vector<uint32_t>({ 96, 120, 144, 192, 120 }));
+	CHECK_EQ(cache.Size(), 3u);
+	CHECK_EQ(cache.Hits(), 1u);
+	CHECK_EQ(cache.Misses(), 5u);
+	CHECK_EQ(cache.Evictions(), 2u);
+}
+
+TEST(DpiLayout, PreviousGetSurvivesNext)
+{
+	for (size_t capacity = 0; capacity <= 4; capacity++)
+	{
+		FakeFactory factory{};
+		DpiCache<FakeResources> cache{ factory.Bind(), capacity };
+		const FakeResources* previous = &cache.Get(96);
+		// Moving through more DPIs than fit evicts on every step.
+		for (uint32_t dpi = 97; dpi < 110; dpi++)
+		{
+			const uint32_t previousDpi = *previous->dpi;
+			const FakeResources* next = &cache.Get(dpi);
+			CHECK(next != previous);
+			CHECK(previous->dpi != nullptr);
+			CHECK_EQ(previous->dpi ? *previous->dpi : 0, previousDpi);
+			CHECK_EQ(*next->dpi, dpi);
+			previous = next;
+		}
+		// The cache is never smaller than two.
+		CHECK_EQ(cache.Size(), capacity < 2 ? 2u : capacity);
+		CHECK_EQ(factory.Alive(), cache.Size());
+	}
+}
+
+TEST(DpiLayout, ScaleForDpi)
+{
+	CHECK_EQ(ScaleForDpi(BUTTON_ROW_HEIGHT, 96), 40);
+	CHECK_EQ(ScaleForDpi(BUTTON_ROW_HEIGHT, 120), 50);
+	// 41.25 and 41.67.
+	CHECK_EQ(ScaleForDpi(BUTTON_ROW_HEIGHT, 99), 41);
+	CHECK_EQ(ScaleForDpi(BUTTON_ROW_HEIGHT, 100), 42);
+	// 12 * 100 / 96 = 12.5 rounds away from zero.
+	CHECK_EQ(ScaleForDpi(12, 100), 13);
+	CHECK_EQ(ScaleForDpi(-12, 100), -13);
+}
+
+// The buttons tile the row without gaps and the last one takes whatever the
+// division leaves over, at any width and DPI.
+TEST(DpiLayout, ButtonRowRemainder)
+{
+	constexpr uint32_t DPIS[] = { 96, 99, 120, 144, 168, 192, 241 };
+	for (const uint32_t dpi : DPIS)
+	{
+		for (int32_t width = 0; width < 64; width++)
+		{
+			for (size_t count = 1; count <= 7; count++)
+			{
+				std::array<LayoutRect, 7> buttons{};
+				LayoutRect log{};
+				const int32_t height = 2 * width + 1;
+				LayoutMainWindow(width, height, dpi, log, std::span<LayoutRect>(buttons.data(), count));
+				CHECK(log == LayoutRect({ 0, 0, width, height / 2 }));
+
+				const int32_t share = width / static_cast<int32_t>(count);
+				int32_t x = 0;
+				for (size_t i = 0; i < count; i++)
+				{
+					const int32_t expectedWidth = i + 1 < count ? share : width - x;
+					CHECK(buttons[i] == LayoutRect({ x, height / 2, expectedWidth, ScaleForDpi(BUTTON_ROW_HEIGHT, dpi) }));
+					x += buttons[i].width;
+				}
+				CHECK_EQ(x, width);
+				CHECK(buttons[count - 1].width - share < static_cast<int32_t>(count));
+			}
+		}
+	}
+
+	LayoutRect log{};
+	LayoutMainWindow(101, 300, 120, log, {});
+	CHECK(log == LayoutRect({ 0, 0, 101, 150 }));
+}
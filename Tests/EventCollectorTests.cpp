@@ -0,0 +1,180 @@
+#include "EventCollector.h"
+#include "HeadlessPlatform.h"
+#include "LogSink.h"
+#include "MessageHandler.h"
+#include "Pipeline.h"
+#include "Test.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A clock that only moves when told to.
+struct StoppedClock
+{
+	static inline std::atomic<int64_t> now{ 0 };
+
+	static int64_t Now() { return now.load(std::memory_order_relaxed); }
+};
+
+static TraceRecord Sequenced(int64_t sequence)
+{
+	TraceRecord record{};
+	record.message = WM_POINTERUPDATE;
+	record.lParam = sequence;
+	return record;
+}
+
+// Several threads push as fast as they can while this one drains. Whatever
+// the interleaving, timestamps never go backwards, ties come out in source
+// order, every source comes out in the order it pushed, and nothing is lost.
+TEST(EventCollector, ConcurrentProducersMergeInOrder)
+{
+	const size_t sources = 4;
+	const int64_t perSource = 50000;
+	EventCollector<256> collector{ sources };
+	std::atomic<size_t> running{ sources };
+	std::vector<uint64_t> retries(sources);
+	std::vector<std::thread> producers;
+	for (size_t source = 0; source < sources; source++)
+	{
+		producers.emplace_back([&, source]()
+		{
+			for (int64_t i = 0; i < perSource; i++)
+			{
+				while (!collector.Push(source, Sequenced(i)))
+				{
+					retries[source]++;
+					std::this_thread::yield();
+				}
+			}
+			running.fetch_sub(1, std::memory_order_release);
+		});
+	}
+
+	size_t merged = 0;
+	size_t outOfOrder = 0;
+	size_t tiesOutOfOrder = 0;
+	size_t gaps = 0;
+	CollectedEvent last{};
+	std::vector<int64_t> next(sources, 0);
+	const auto check = [&](const CollectedEvent& event)
+	{
+		if (merged > 0)
+		{
+			outOfOrder += event.record.timestamp < last.record.timestamp;
+			tiesOutOfOrder += event.record.timestamp == last.record.timestamp && event.source < last.source;
+		}
+		gaps += event.record.lParam != next[event.source];
+		next[event.source] = event.record.lParam + 1;
+		last = event;
+		merged++;
+	};
+	for (;;)
+	{
+		const bool stopped = running.load(std::memory_order_acquire) == 0;
+		if (collector.Drain(check) == 0)
+		{
+			if (stopped)
+			{
+				break;
+			}
+			std::this_thread::yield();
+		}
+	}
+	for (std::thread& producer : producers)
+	{
+		producer.join();
+	}
+
+	CHECK_EQ(merged, sources * perSource);
+	CHECK_EQ(outOfOrder, 0u);
+	CHECK_EQ(tiesOutOfOrder, 0u);
+	CHECK_EQ(gaps, 0u);
+	for (size_t source = 0; source < sources; source++)
+	{
+		CHECK_EQ(next[source], perSource);
+		CHECK_EQ(collector.Dropped(source), retries[source]);
+	}
+	CHECK_EQ(collector.Drain([](const CollectedEvent&) {}), 0u);
+}
+
+// Events stamped at the same time go in source order, and only once the clock
+// has moved past them: until then an empty source could still push one with
+// the same stamp.
+TEST(EventCollector, TiesGoInSourceOrder)
+{
+	EventCollector<8, StoppedClock> collector{ 3 };
+	StoppedClock::now = 5;
+	CHECK(collector.Push(2, Sequenced(0)));
+	CHECK(collector.Push(0, Sequenced(1)));
+	CHECK(collector.Push(1, Sequenced(2)));
+	CHECK(collector.Push(2, Sequenced(3)));
+	std::vector<uint32_t> order;
+	const auto record = [&](const CollectedEvent& event) { order.push_back(event.source); };
+	// Once source 0 is empty it could still push an event stamped 5, so the
+	// rest wait for the clock to move on.
+	CHECK_EQ(collector.Drain(record), 1u);
+	StoppedClock::now = 6;
+	CHECK_EQ(collector.Drain(record), 3u);
+	CHECK(order == std::vector<uint32_t>({ 0, 1, 2, 2 }));
+}
+
+TEST(EventCollector, FullSourceDrops)
+{
+	EventCollector<4, StoppedClock> collector{ 2 };
+	StoppedClock::now = 1;
+	for (int64_t i = 0; i < 4; i++)
+	{
+		CHECK(collector.Push(1, Sequenced(i)));
+	}
+	CHECK(!collector.Push(1, Sequenced(4)));
+	CHECK(collector.Push(0, Sequenced(5)));
+	CHECK_EQ(collector.Dropped(1), uint64_t{ 1 });
+	CHECK_EQ(collector.Dropped(0), uint64_t{ 0 });
+	StoppedClock::now = 2;
+	CHECK_EQ(collector.Drain([](const CollectedEvent&) {}), 5u);
+}
+
+// With a collector set, the window's own messages wait in it and are logged
+// by whoever drains it, in one order with every other source.
+TEST(EventCollector, MessageHandlerPushesToCollector)
+{
+	StringLogSink output{};
+	HeadlessPlatform platform{ output };
+	EventPipeline pipeline{ platform };
+	MessageHandler handler{ pipeline };
+	handler.Options().motionEnabled = true;
+	EventCollector<> collector{ 2 };
+	handler.SetCollector(&collector, 1);
+
+	CHECK(handler.Handle(WM_POINTERDOWN, MAKELONG(1, POINTER_MESSAGE_FLAG_INCONTACT), MAKELONG(10, 20)).action == MessageAction::Return);
+	CHECK(collector.Push(0, Sequenced(7)));
+	CHECK(handler.Handle(WM_MOUSEMOVE, 0, MAKELONG(10, 20)).action == MessageAction::Return);
+	// Not traced, so not collected.
+	CHECK(handler.Handle(WM_TIMER, 0, 0).action == MessageAction::Continue);
+	pipeline.Flush();
+	CHECK(output.Text().empty());
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	std::vector<uint32_t> messages;
+	std::vector<uint32_t> order;
+	collector.Drain([&](const CollectedEvent& event)
+	{
+		messages.push_back(event.record.message);
+		order.push_back(event.source);
+		pipeline.Process(event.record);
+	});
+	CHECK(messages == std::vector<uint32_t>({ WM_POINTERDOWN, WM_POINTERUPDATE, WM_MOUSEMOVE }));
+	CHECK(order == std::vector<uint32_t>({ 1, 0, 1 }));
+	pipeline.Flush();
+	CHECK(output.Text().find("WM_POINTERDOWN") < output.Text().find("WM_MOUSEMOVE"));
+
+	handler.SetCollector(nullptr, 0);
+	output.Clear();
+	handler.Handle(WM_MOUSEMOVE, 0, 0);
+	pipeline.Flush();
+	CHECK(output.Text().find("WM_MOUSEMOVE") != std::string::npos);
+}
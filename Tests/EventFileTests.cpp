@@ -0,0 +1,255 @@
+#include "EventFile.h"
+#include "ScratchDirectory.h"
+#include "Test.h"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Every fifth event is a line of text; the others are pointer updates.
+static void AppendEvents(EventFileWriter& writer, int64_t first, int64_t count)
+{
+	for (int64_t t = first; t < first + count; t++)
+	{
+		EventRecord event{};
+		event.timestamp = t;
+		if (t % 5 == 0)
+		{
+			const std::string text = fmt::format("line {}", t);
+			event.kind = EventKind::Text;
+			event.textLength = static_cast<uint16_t>(text.size());
+			writer.Append(event, text);
+			continue;
+		}
+		event.kind = EventKind::Message;
+		event.message = WM_POINTERUPDATE;
+		event.pointerId = static_cast<uint32_t>(t % 3);
+		event.x = static_cast<int32_t>(t * 7);
+		event.y = static_cast<int32_t>(-t);
+		writer.Append(event, {});
+	}
+}
+
+static EventFileConfig Config(const ScratchDirectory& directory, BlockCodec codec = DEFAULT_BLOCK_CODEC)
+{
+	EventFileConfig config{};
+	config.directory = directory.path;
+	config.baseName = "events";
+	config.timestampFrequency = 1000;
+	config.codec = codec;
+	config.blockEvents = 16;
+	config.maxFiles = 0;
+	// Room for every block the tests write, so that none are dropped.
+	config.queueBlocks = 64;
+	return config;
+}
+
+// Reads the file from the reader's position and checks that it holds the
+// events AppendEvents wrote from `first` on. Returns how many it read.
+static int64_t CheckEvents(EventFileReader& reader, int64_t first)
+{
+	EventRecord event{};
+	std::string_view text;
+	int64_t t = first;
+	for (; reader.Next(event, text); t++)
+	{
+		CHECK_EQ(event.timestamp, t);
+		if (t % 5 == 0)
+		{
+			CHECK(event.kind == EventKind::Text);
+			CHECK_EQ(text, fmt::format("line {}", t));
+		}
+		else
+		{
+			CHECK(event.kind == EventKind::Message);
+			CHECK_EQ(event.pointerId, static_cast<uint32_t>(t % 3));
+			CHECK_EQ(event.x, static_cast<int32_t>(t * 7));
+			CHECK_EQ(event.y, static_cast<int32_t>(-t));
+			CHECK(text.empty());
+		}
+	}
+	return t - first;
+}
+
+TEST(EventFile, RoundTrip)
+{
+	for (const BlockCodec codec : { BlockCodec::Stored, DEFAULT_BLOCK_CODEC })
+	{
+		ScratchDirectory directory{ "roundtrip" };
+		{
+			EventFileWriter writer{ Config(directory, codec) };
+			AppendEvents(writer, 0, 1000);
+			writer.Sync();
+			const EventFileStats stats = writer.Stats();
+			CHECK_EQ(stats.events, 1000u);
+			CHECK_EQ(stats.blocks, 63u);
+			CHECK_EQ(stats.files, 1u);
+			CHECK(!stats.failed);
+		}
+
+		const std::vector<std::filesystem::path> files = EventFiles(directory.path, "events");
+		CHECK_EQ(files.size(), 1u);
+		EventFileReader reader{};
+		CHECK(!files.empty() && reader.Open(files[0]));
+		CHECK_EQ(reader.Header().timestampFrequency, 1000);
+		CHECK_EQ(reader.Header().sequence, 1u);
+		CHECK_EQ(reader.BlockCount(), 63u);
+		CHECK_EQ(CheckEvents(reader, 0), 1000);
+	}
+}
+
+TEST(EventFile, Rotation)
+{
+	ScratchDirectory directory{ "rotation" };
+	EventFileConfig config = Config(directory);
+	// Every block starts a new file.
+	config.maxFileBytes = 1;
+	config.maxFiles = 3;
+	{
+		EventFileWriter writer{ config };
+		for (int64_t block = 0; block < 5; block++)
+		{
+			AppendEvents(writer, block * 16, 16);
+			writer.Sync();
+		}
+		CHECK_EQ(writer.Stats().files, 5u);
+		CHECK(writer.CurrentPath() == EventFilePath(directory.path, "events", 5));
+	}
+
+	// The two oldest were deleted.
+	const std::vector<std::filesystem::path> files = EventFiles(directory.path, "events");
+	CHECK_EQ(files.size(), 3u);
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		CHECK(files[i] == EventFilePath(directory.path, "events", i + 3));
+		EventFileReader reader{};
+		CHECK(reader.Open(files[i]));
+		CHECK_EQ(reader.Header().sequence, i + 3);
+		CHECK_EQ(CheckEvents(reader, static_cast<int64_t>(i + 2) * 16), 16);
+	}
+}
+
+TEST(EventFile, Seek)
+{
+	ScratchDirectory directory{ "seek" };
+	{
+		EventFileWriter writer{ Config(directory) };
+		AppendEvents(writer, 100, 500);
+	}
+	EventFileReader reader{};
+	CHECK(reader.Open(EventFilePath(directory.path, "events", 1)));
+	for (const int64_t t : { 0, 100, 115, 116, 117, 333, 599 })
+	{
+		CHECK(reader.Seek(t));
+		const int64_t first = t < 100 ? 100 : t;
+		CHECK_EQ(CheckEvents(reader, first), 600 - first);
+	}
+	CHECK(!reader.Seek(600));
+	reader.Rewind();
+	CHECK_EQ(CheckEvents(reader, 100), 500);
+}
+
+// A file whose writer never closed it is read up to its last complete block,
+// and damaged block headers are refused before anything is allocated for them.
+TEST(EventFile, Truncation)
+{
+	ScratchDirectory directory{ "truncation" };
+	{
+		EventFileWriter writer{ Config(directory, BlockCodec::Stored) };
+		AppendEvents(writer, 0, 160);
+	}
+	const std::filesystem::path path = EventFilePath(directory.path, "events", 1);
+	const uint64_t blockBytes = sizeof(EventBlockHeader) + 16 * sizeof(EventRecord);
+	EventFileReader reader{};
+	CHECK(reader.Open(path));
+	CHECK_EQ(reader.BlockCount(), 10u);
+	// Each block also carries the text of its lines after its records.
+	const uint64_t thirdBlock = reader.Index()[2].offset;
+	const uint64_t fourthBlock = reader.Index()[3].offset;
+	CHECK(fourthBlock - thirdBlock > blockBytes);
+
+	// Cut in the middle of the fourth block.
+	std::filesystem::resize_file(path, fourthBlock + sizeof(EventBlockHeader) + 10);
+	CHECK(reader.Open(path));
+	CHECK_EQ(reader.BlockCount(), 3u);
+	CHECK_EQ(CheckEvents(reader, 0), 48);
+
+	// A block claiming more events than the format allows ends the rebuilt
+	// index before it.
+	{
+		std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+		EventBlockHeader header{};
+		file.seekg(static_cast<std::streamoff>(thirdBlock));
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		header.eventCount = UINT32_MAX;
+		file.seekp(static_cast<std::streamoff>(thirdBlock));
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	}
+	CHECK(reader.Open(path));
+	CHECK_EQ(reader.BlockCount(), 2u);
+	CHECK(!reader.LoadBlock(2));
+	CHECK_EQ(CheckEvents(reader, 0), 32);
+}
+
+// An indexed block is checked as carefully as one found by a rebuild.
+TEST(EventFile, DamagedIndexedBlock)
+{
+	ScratchDirectory directory{ "damaged" };
+	{
+		EventFileWriter writer{ Config(directory) };
+		AppendEvents(writer, 0, 64);
+	}
+	const std::filesystem::path path = EventFilePath(directory.path, "events", 1);
+	EventFileReader reader{};
+	CHECK(reader.Open(path));
+	CHECK_EQ(reader.BlockCount(), 4u);
+	const uint64_t offset = reader.Index()[1].offset;
+	const auto damage = [&](auto&& change)
+	{
+		std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+		EventBlockHeader header{};
+		file.seekg(static_cast<std::streamoff>(offset));
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		const EventBlockHeader original = header;
+		change(header);
+		file.seekp(static_cast<std::streamoff>(offset));
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		return original;
+	};
+
+	EventBlockHeader original = damage([](EventBlockHeader& header) { header.magic[0] = 'X'; });
+	CHECK(reader.Open(path));
+	CHECK_EQ(reader.BlockCount(), 4u);
+	CHECK(reader.LoadBlock(0));
+	CHECK(!reader.LoadBlock(1));
+	CHECK(reader.LoadBlock(2));
+
+	damage([&](EventBlockHeader& header) { header = original; header.storedSize = UINT32_MAX; });
+	CHECK(reader.Open(path));
+	CHECK(!reader.LoadBlock(1));
+	damage([&](EventBlockHeader& header) { header = original; header.textSize = UINT32_MAX; });
+	CHECK(reader.Open(path));
+	CHECK(!reader.LoadBlock(1));
+	damage([&](EventBlockHeader& header) { header = original; });
+	CHECK(reader.Open(path));
+	CHECK_EQ(CheckEvents(reader, 0), 64);
+}
+
+TEST(EventFile, RefusesToOverwrite)
+{
+	ScratchDirectory directory{ "overwrite" };
+	const std::filesystem::path path = EventFilePath(directory.path, "events", 1);
+	std::ofstream(path) << "keep";
+	{
+		EventFileWriter writer{ Config(directory) };
+		AppendEvents(writer, 0, 10);
+		writer.Sync();
+		CHECK(writer.Stats().failed);
+		CHECK_EQ(writer.Stats().droppedEvents, 10u);
+	}
+	std::ifstream file(path);
+	std::string kept;
+	file >> kept;
+	CHECK_EQ(kept, "keep");
+}
@@ -0,0 +1,115 @@
+#include "EventLog.h"
+#include "LogSink.h"
+#include "Test.h"
+#include "Trace.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static TraceRecord Update(int64_t timestamp, int16_t x)
+{
+	TraceRecord record{};
+	record.message = WM_POINTERUPDATE;
+	record.wParam = MAKELONG(3, POINTER_MESSAGE_FLAG_INRANGE);
+	record.lParam = MAKELONG(x, 7);
+	record.timestamp = timestamp;
+	return record;
+}
+
+TEST(EventLog, DrainsInOrder)
+{
+	auto arena = std::make_unique<EventArena<8, 1024>>();
+	CHECK(arena->Push(MessageEvent(Update(1, 10), true)));
+	CHECK(arena->PushText(2, "first"));
+	CHECK(arena->Push(MessageEvent(Update(3, 20), true, 4)));
+	CHECK(arena->PushText(4, FMT_STRING("second {}"), 2));
+	CHECK_EQ(arena->Pending(), 4u);
+
+	std::vector<std::string> seen;
+	const size_t drained = arena->Drain([&](const EventRecord& event, std::string_view text)
+	{
+		seen.push_back(event.kind == EventKind::Text ? std::string(text) : fmt::format("{} {} {} {}", event.timestamp, event.pointerId, event.x, event.throttled));
+	});
+	CHECK_EQ(drained, 4u);
+	CHECK(arena->Empty());
+	CHECK(seen == std::vector<std::string>({ "1 3 10 0", "first", "3 3 20 4", "second 2" }));
+}
+
+TEST(EventLog, FullWithoutAllocating)
+{
+	auto arena = std::make_unique<EventArena<4, 1024>>();
+	for (int i = 0; i < 4; i++)
+	{
+		CHECK(arena->Push(MessageEvent(Update(i, 0), true)));
+	}
+	CHECK(arena->Full());
+	CHECK(!arena->Push(MessageEvent(Update(4, 0), true)));
+	CHECK(!arena->PushText(4, "dropped"));
+	CHECK_EQ(arena->Drain([](const EventRecord&, std::string_view) {}), 4u);
+	CHECK(!arena->Full());
+	CHECK(arena->PushText(5, "kept"));
+}
+
+TEST(EventLog, TextWrapsAround)
+{
+	using Arena = EventArena<64, 512>;
+	auto arena = std::make_unique<Arena>();
+	const std::string line(100, 'x');
+	std::string expected;
+	std::string seen;
+	// Enough lines to go around the text buffer several times, each of which
+	// has to start over at its beginning rather than straddle the end.
+	for (int round = 0; round < 10; round++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			const std::string text = fmt::format("{}:{}", round * 3 + i, line);
+			CHECK(arena->PushText(0, text));
+			expected += text;
+		}
+		arena->Drain([&](const EventRecord&, std::string_view text) { seen += text; });
+	}
+	CHECK(seen == expected);
+}
+
+TEST(EventLog, RendersLikeLogMessage)
+{
+	auto arena = std::make_unique<EventArena<>>();
+	const TraceRecord record = Update(0, -5);
+	arena->Push(MessageEvent(record, false, 2));
+	arena->PushText(0, "line");
+
+	StringLogSink rendered{};
+	TextEventSink text{ rendered };
+	arena->Drain([&](const EventRecord& event, std::string_view line) { text.Append(event, line); });
+	text.Flush();
+
+	StringLogSink direct{};
+	TextEventSink expected{ direct };
+	LogMessage(expected, record, false, 2);
+	expected.Log("line");
+	expected.Flush();
+	CHECK_EQ(rendered.Text(), direct.Text());
+}
+
+TEST(EventLog, MarksTruncatedLines)
+{
+	using Arena = EventArena<8, 1024>;
+	auto arena = std::make_unique<Arena>();
+	const std::string fits(Arena::LINE_LENGTH, 'a');
+	const std::string longer(Arena::LINE_LENGTH + 1, 'b');
+	CHECK(arena->PushText(0, fits));
+	CHECK(arena->PushText(1, longer));
+	CHECK(arena->PushText(2, FMT_STRING("{}"), fits));
+	CHECK(arena->PushText(3, FMT_STRING("{}c"), fits));
+
+	std::vector<std::string> seen;
+	arena->Drain([&](const EventRecord&, std::string_view text) { seen.emplace_back(text); });
+	const std::string marked = std::string(Arena::LINE_LENGTH - Arena::TRUNCATION_MARK.size(), 'b') + std::string(Arena::TRUNCATION_MARK);
+	CHECK_EQ(seen.size(), 4u);
+	CHECK(seen.size() == 4 && seen[0] == fits);
+	CHECK(seen.size() == 4 && seen[1] == marked);
+	CHECK(seen.size() == 4 && seen[2] == fits);
+	CHECK(seen.size() == 4 && seen[3] == std::string(Arena::LINE_LENGTH - Arena::TRUNCATION_MARK.size(), 'a') + std::string(Arena::TRUNCATION_MARK));
+}
@@ -0,0 +1,207 @@
+#include "DevicePool.h"
+#include "Gesture.h"
+#include "Injection.h"
+#include "InjectionWorker.h"
+#include "Stress.h"
+#include "Syscalls.h"
+#include "Test.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+// A clock that only moves when it is slept on, so that playback is exact and
+// instant.
+struct ManualClock
+{
+	using time_point = std::chrono::steady_clock::time_point;
+
+	static inline time_point now{};
+
+	static time_point Now() { return now; }
+
+	static void SleepUntil(time_point deadline)
+	{
+		if (deadline > now)
+		{
+			now = deadline;
+		}
+	}
+};
+
+static Gesture Stroke()
+{
+	Gesture gesture{};
+	gesture.pointerType = PT_PEN;
+	gesture.pointerId = 2;
+	gesture.frameRate = 100.0;
+	gesture.keyframes = {
+		{ 0ms, 0, 0, 0, 0, 0, false },
+		{ 10ms, 0, 0, 512, 0, 0, true },
+		{ 50ms, 400, 200, 512, 10, -10, true },
+		{ 60ms, 400, 200, 0, 0, 0, false },
+	};
+	return gesture;
+}
+
+TEST(Injection, CompileGesture)
+{
+	const InjectPlan plan = CompileGesture(Stroke());
+	CHECK_EQ(plan.frames.size(), 7u);
+	CHECK_EQ(plan.contacts.size(), 7u);
+	CHECK(plan.settle == 10ms);
+	for (size_t i = 0; i < plan.frames.size(); i++)
+	{
+		CHECK(plan.frames[i].time == std::chrono::milliseconds(10 * i));
+		CHECK_EQ(plan.frames[i].contactCount, 1u);
+		CHECK_EQ(plan.Contacts(plan.frames[i])->pointerId, 2u);
+	}
+
+	// Hover, down, three moves, up.
+	CHECK_EQ(plan.contacts[0].buttonChangeType, static_cast<uint32_t>(POINTER_CHANGE_NONE));
+	CHECK((plan.contacts[0].pointerFlags & POINTER_FLAG_INCONTACT) == 0);
+	CHECK_EQ(plan.contacts[1].buttonChangeType, static_cast<uint32_t>(POINTER_CHANGE_FIRSTBUTTON_DOWN));
+	CHECK_EQ(plan.contacts[5].buttonChangeType, static_cast<uint32_t>(POINTER_CHANGE_NONE));
+	CHECK_EQ(plan.contacts[6].buttonChangeType, static_cast<uint32_t>(POINTER_CHANGE_FIRSTBUTTON_UP));
+	// Halfway between the second and third keyframes.
+	CHECK_EQ(plan.contacts[3].x, 200);
+	CHECK_EQ(plan.contacts[3].y, 100);
+	CHECK_EQ(plan.contacts[3].tiltX, 5);
+}
+
+TEST(Injection, TouchTransitionFlags)
+{
+	Gesture gesture = Stroke();
+	gesture.pointerType = PT_TOUCH;
+	const InjectPlan plan = CompileGesture(gesture);
+	CHECK((plan.contacts[1].pointerFlags & POINTER_FLAG_DOWN) != 0);
+	CHECK((plan.contacts[2].pointerFlags & POINTER_FLAG_UPDATE) != 0);
+	CHECK((plan.contacts[6].pointerFlags & POINTER_FLAG_UP) != 0);
+}
+
+TEST(Injection, CompileStressPlan)
+{
+	StressConfig config{};
+	config.contacts = 5;
+	config.stepDuration = 100ms;
+	const InjectPlan plan = CompileStressPlan(config, 240.0);
+	CHECK_EQ(plan.frames.size(), 24u);
+	CHECK_EQ(plan.contacts.size(), 24u * 5);
+	CHECK_EQ(plan.maxContacts, 5u);
+	for (const InjectFrame& frame : plan.frames)
+	{
+		CHECK_EQ(frame.contactCount, 5u);
+	}
+	for (uint32_t i = 0; i < 5; i++)
+	{
+		CHECK_EQ(plan.contacts[i].pointerId, i);
+		CHECK_EQ(plan.contacts[i].buttonChangeType, static_cast<uint32_t>(POINTER_CHANGE_FIRSTBUTTON_DOWN));
+		CHECK_EQ(plan.contacts[plan.contacts.size() - 5 + i].buttonChangeType, static_cast<uint32_t>(POINTER_CHANGE_FIRSTBUTTON_UP));
+	}
+	CHECK(CompileStressPlan(config, 0.0).frames.empty());
+}
+
+TEST(Injection, PlayPlanOnSchedule)
+{
+	const InjectPlan plan = CompileGesture(Stroke());
+	RecordingInjectionBackend backend{};
+	CHECK(backend.Open(plan.pointerType, plan.maxContacts, plan.feedback));
+	ManualClock::now = {};
+	const PlayStats stats = PlayPlan<ManualClock>(plan, backend);
+	CHECK_EQ(stats.played, 7u);
+	CHECK_EQ(stats.failed, 0u);
+	CHECK(stats.firstFrame == 0ms);
+	CHECK(stats.lastFrame == 60ms);
+	CHECK(stats.maxLateness == 0ms);
+	CHECK(ManualClock::now.time_since_epoch() == 70ms);
+	CHECK_EQ(backend.Entries().size(), 7u);
+}
+
+TEST(Injection, PlayPlanCancelAndFailures)
+{
+	const InjectPlan plan = CompileGesture(Stroke());
+	RecordingInjectionBackend closed{};
+	ManualClock::now = {};
+	// A backend that was never opened refuses every frame.
+	const PlayStats failed = PlayPlan<ManualClock>(plan, closed);
+	CHECK_EQ(failed.played, 0u);
+	CHECK_EQ(failed.failed, 7u);
+
+	RecordingInjectionBackend backend{};
+	backend.Open(plan.pointerType, plan.maxContacts, plan.feedback);
+	size_t polls = 0;
+	const PlayStats stats = PlayPlan<ManualClock>(plan, backend, [&]() { return ++polls > 3; });
+	CHECK_EQ(stats.played, 3u);
+	CHECK_EQ(backend.Entries().size(), 3u);
+}
+
+// A syscall table whose injection entry refuses every other frame.
+static uint32_t g_MockInjections = 0;
+
+static void WINAPI MockInitialize(POINTER_INPUT_TYPE, ULONG, ULONG, POINTER_FEEDBACK_MODE, HSYNTHETICPOINTERDEVICE* out)
+{
+	*out = reinterpret_cast<HSYNTHETICPOINTERDEVICE>(uintptr_t{ 1 });
+}
+
+static BOOL WINAPI MockInject(HSYNTHETICPOINTERDEVICE, const POINTER_TYPE_INFO*, UINT32)
+{
+	return g_MockInjections++ % 2 == 0;
+}
+
+static void WINAPI MockRemove(HSYNTHETICPOINTERDEVICE) {}
+
+TEST(Injection, SyscallBackendReportsFailures)
+{
+	SyscallTable table{};
+	table.InitializePointerDeviceInjection = &MockInitialize;
+	table.InjectPointerInput = &MockInject;
+	table.RemoveInjectionDevice = &MockRemove;
+
+	const InjectPlan plan = CompileGesture(Stroke());
+	NtUserInjectionBackend backend{ table };
+	CHECK(backend.Open(plan.pointerType, plan.maxContacts, plan.feedback));
+	g_MockInjections = 0;
+	ManualClock::now = {};
+	const PlayStats stats = PlayPlan<ManualClock>(plan, backend);
+	CHECK_EQ(stats.played, 4u);
+	CHECK_EQ(stats.failed, 3u);
+}
+
+// A plan submitted with a lease plays on that device and gives it back to its
+// own pool; the worker's pool is left alone.
+TEST(Injection, WorkerPlaysOnSubmittedLease)
+{
+	DevicePool workerDevices{ []() { return std::make_unique<RecordingInjectionBackend>(); } };
+	DevicePool ownDevices{ []() { return std::make_unique<RecordingInjectionBackend>(); } };
+	std::mutex mutex;
+	std::condition_variable finished;
+	std::vector<InjectCompletion> completions;
+	InjectionWorker<ManualClock> worker{ workerDevices, [&](const InjectCompletion& completion)
+	{
+		std::lock_guard lock{ mutex };
+		completions.push_back(completion);
+		finished.notify_one();
+	} };
+
+	const InjectPlan plan = CompileGesture(Stroke());
+	DeviceLease lease = ownDevices.Acquire(PlanDeviceKey(plan));
+	CHECK(static_cast<bool>(lease));
+	const uint64_t leased = worker.Submit(plan, std::move(lease));
+	const uint64_t pooled = worker.Submit(plan);
+	CHECK(leased != 0 && pooled != 0);
+	{
+		std::unique_lock lock{ mutex };
+		finished.wait(lock, [&]() { return completions.size() == 2; });
+	}
+	CHECK_EQ(completions[0].id, leased);
+	CHECK(completions[0].status == InjectStatus::Completed);
+	CHECK_EQ(completions[0].stats.played, 7u);
+	CHECK_EQ(ownDevices.Stats().created, uint64_t{ 1 });
+	CHECK_EQ(ownDevices.Idle(), 1u);
+	CHECK(completions[1].status == InjectStatus::Completed);
+	CHECK_EQ(workerDevices.Stats().created, uint64_t{ 1 });
+}
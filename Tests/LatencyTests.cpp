@@ -0,0 +1,91 @@
+#include "Latency.h"
+#include "Test.h"
+#include <cstdint>
+
+TEST(Latency, TicksToNanoseconds)
+{
+	CHECK_EQ(TicksToNanoseconds(3, 1000), 3000000);
+	CHECK_EQ(TicksToNanoseconds(10000000, 10000000), 1000000000);
+	// Large enough that ticks * 1e9 would overflow.
+	CHECK_EQ(TicksToNanoseconds(INT64_C(1) << 50, INT64_C(1) << 20), INT64_C(1000000000) << 30);
+}
+
+TEST(Latency, HistogramPercentiles)
+{
+	LatencyHistogram histogram{};
+	for (int64_t i = 1; i <= 100; i++)
+	{
+		histogram.Record(i * 1000);
+	}
+	CHECK_EQ(histogram.Count(), 100u);
+	CHECK_EQ(histogram.Min(), 1000u);
+	CHECK_EQ(histogram.Max(), 100000u);
+	// Within the bucket resolution of 1 / 2^SUB_BITS.
+	const uint64_t p50 = histogram.Percentile(50);
+	CHECK(p50 >= 50000 && p50 <= 50000 + 50000 / LatencyHistogram::SUB_COUNT);
+	CHECK_EQ(histogram.Percentile(100), 100000u);
+}
+
+// Two contacts move in one frame each time, and the promoted mouse messages
+// arrive only after several frames have been delivered.
+TEST(Latency, PromotionMatchesFrames)
+{
+	LatencyTracker tracker{};
+	for (uint32_t frame = 1; frame <= 3; frame++)
+	{
+		const int64_t stamped = frame * 1000;
+		const int64_t arrived = stamped + 100;
+		tracker.OnPointerMessage(WM_POINTERUPDATE, 0, frame, true, static_cast<int32_t>(frame), 0, stamped, arrived);
+		tracker.OnPointerMessage(WM_POINTERUPDATE, 1, frame, false, 50, 50, stamped, arrived);
+	}
+	CHECK(tracker.OnPromotedMouseMessage(WM_MOUSEMOVE, 1, 0, 1500));
+	CHECK(tracker.OnPromotedMouseMessage(WM_MOUSEMOVE, 3, 0, 3500));
+	// Frame 2 was coalesced away by the message for frame 3.
+	CHECK(!tracker.OnPromotedMouseMessage(WM_MOUSEMOVE, 2, 0, 3600));
+	// The secondary contact is never promoted.
+	CHECK(!tracker.OnPromotedMouseMessage(WM_MOUSEMOVE, 50, 50, 3700));
+	// Another message promoted from the same frame.
+	CHECK(tracker.OnPromotedMouseMessage(WM_LBUTTONUP, 3, 0, 3800));
+	CHECK_EQ(tracker.Unmatched(), 2u);
+
+	uint64_t moves = 0;
+	uint64_t updates = 0;
+	tracker.ForEach([&](const MessageInfo& info, const LatencyHistogram& histogram)
+	{
+		if (info.id == WM_MOUSEMOVE)
+		{
+			moves = histogram.Count();
+			CHECK_EQ(histogram.Min(), 500u);
+			CHECK_EQ(histogram.Max(), 500u);
+		}
+		if (info.id == WM_POINTERUPDATE)
+		{
+			updates = histogram.Count();
+			CHECK_EQ(histogram.Max(), 100u);
+		}
+	});
+	CHECK_EQ(moves, 2u);
+	CHECK_EQ(updates, 6u);
+	CHECK_EQ(tracker.Promotion().Count(), 3u);
+	CHECK_EQ(tracker.Promotion().Min(), 400u);
+	CHECK_EQ(tracker.Promotion().Max(), 700u);
+}
+
+TEST(Latency, UnstampedAndBoundedFrames)
+{
+	LatencyTracker tracker{};
+	tracker.OnPointerMessage(WM_POINTERUPDATE, 0, 1, true, 7, 7, 0, 100);
+	CHECK(!tracker.OnPromotedMouseMessage(WM_MOUSEMOVE, 7, 7, 200));
+
+	for (uint32_t frame = 0; frame <= LatencyTracker::MAX_PENDING; frame++)
+	{
+		tracker.OnPointerMessage(WM_POINTERUPDATE, 0, frame, true, static_cast<int32_t>(frame), 0, 1, 1);
+	}
+	// The oldest frame was dropped to make room for the newest.
+	CHECK(!tracker.OnPromotedMouseMessage(WM_MOUSEMOVE, 0, 0, 2));
+	CHECK(tracker.OnPromotedMouseMessage(WM_MOUSEMOVE, 1, 0, 2));
+
+	tracker.Reset();
+	CHECK_EQ(tracker.Unmatched(), 0u);
+	CHECK(!tracker.OnPromotedMouseMessage(WM_MOUSEMOVE, 1, 0, 2));
+}
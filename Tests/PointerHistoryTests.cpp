@@ -0,0 +1,46 @@
+#include "PointerHistory.h"
+#include "Test.h"
+#include <cstdint>
+
+static PointerSample Sample(uint32_t frameId)
+{
+	return { frameId, static_cast<int32_t>(frameId), 0, 0, 0, 0, frameId };
+}
+
+TEST(PointerHistory, KeepsOnlyNewFrames)
+{
+	PointerHistory history{};
+	// Newest first, overlapping the previous message by one frame.
+	const PointerSample first[] = { Sample(2), Sample(1) };
+	const PointerSample second[] = { Sample(4), Sample(3), Sample(2) };
+	CHECK_EQ(history.Append(5, first, 2), 2u);
+	CHECK_EQ(history.Append(5, second, 3), 2u);
+	const PointerHistory::Track* track = history.Get(5);
+	CHECK(track != nullptr);
+	CHECK_EQ(track ? track->samples.Size() : 0, 4u);
+	CHECK_EQ(track ? track->messages : 0, 2u);
+}
+
+TEST(PointerHistory, ReleaseFreesSlots)
+{
+	PointerHistory history{};
+	const PointerSample sample[] = { Sample(1) };
+	for (uint32_t id = 0; id < PointerHistory::MAX_POINTERS; id++)
+	{
+		CHECK_EQ(history.Append(id, sample, 1), 1u);
+	}
+	// Every slot is taken until a pointer goes away.
+	CHECK_EQ(history.Append(100, sample, 1), 0u);
+	history.Release(3);
+	CHECK(history.Get(3) == nullptr);
+	CHECK_EQ(history.Append(100, sample, 1), 1u);
+
+	history.Clear();
+	for (uint32_t id = 0; id < PointerHistory::MAX_POINTERS; id++)
+	{
+		CHECK(history.Get(id) == nullptr);
+	}
+	CHECK(history.Get(100) == nullptr);
+	CHECK_EQ(history.Pool().Available(), history.Pool().Allocated());
+	CHECK_EQ(history.Append(200, sample, 1), 1u);
+}
@@ -0,0 +1,154 @@
+#include "PointerTracker.h"
+#include "Test.h"
+#include <cstdint>
+#include <map>
+#include <random>
+
+// Random inserts and erases over a small key range, so that probe chains
+// collide, wrap around and are shifted back, checked against std::map.
+TEST(PointerTracker, TableMatchesMap)
+{
+	std::mt19937 random{ 1234 };
+	for (int run = 0; run < 20; run++)
+	{
+		PointerTable<uint32_t, 16> table{};
+		std::map<uint32_t, uint32_t> expected;
+		for (int step = 0; step < 2000; step++)
+		{
+			const uint32_t key = random() % 40;
+			if (random() % 3 == 0)
+			{
+				table.Erase(key);
+				expected.erase(key);
+			}
+			else if (uint32_t* value = table.Insert(key))
+			{
+				*value = step;
+				expected[key] = step;
+			}
+			else
+			{
+				// Full; one slot is always kept free.
+				CHECK_EQ(expected.size(), 15u);
+				CHECK(expected.find(key) == expected.end());
+			}
+
+			CHECK_EQ(table.Size(), expected.size());
+			for (uint32_t probe = 0; probe < 40; probe++)
+			{
+				const uint32_t* found = table.Find(probe);
+				const auto entry = expected.find(probe);
+				CHECK_EQ(found != nullptr, entry != expected.end());
+				if (found && entry != expected.end())
+				{
+					CHECK_EQ(*found, entry->second);
+				}
+			}
+		}
+		size_t visited = 0;
+		table.ForEach([&](uint32_t key, uint32_t value)
+		{
+			visited++;
+			CHECK_EQ(expected.count(key), 1u);
+			CHECK_EQ(expected[key], value);
+		});
+		CHECK_EQ(visited, expected.size());
+	}
+}
+
+static TraceRecord Pointer(UINT message, uint32_t pointerId, int64_t timestamp, int16_t x, bool inContact = true)
+{
+	TraceRecord record{};
+	record.message = message;
+	record.wParam = MAKELONG(pointerId, inContact ? POINTER_MESSAGE_FLAG_INCONTACT : 0);
+	record.lParam = MAKELONG(x, 0);
+	record.timestamp = timestamp;
+	return record;
+}
+
+TEST(PointerTracker, ContactLifecycle)
+{
+	PointerTracker tracker{};
+	ContactSummary summary{};
+	CHECK(!tracker.Track(Pointer(WM_POINTERDOWN, 1, 0, 0), summary));
+	// Samples every 10 ticks, with one missing at 40.
+	CHECK(!tracker.Track(Pointer(WM_POINTERUPDATE, 1, 10, 10), summary));
+	CHECK(!tracker.Track(Pointer(WM_POINTERUPDATE, 1, 20, 20), summary));
+	CHECK(!tracker.Track(Pointer(WM_POINTERUPDATE, 1, 30, 30), summary));
+	CHECK(!tracker.Track(Pointer(WM_POINTERUPDATE, 1, 50, 50), summary));
+	CHECK_EQ(tracker.Active(), 1u);
+	CHECK(tracker.Track(Pointer(WM_POINTERUP, 1, 60, 60, false), summary));
+	CHECK_EQ(tracker.Active(), 0u);
+
+	CHECK_EQ(summary.pointerId, 1u);
+	CHECK(!summary.cancelled);
+	CHECK_EQ(summary.state.samples, 6u);
+	CHECK_EQ(summary.Duration(), 60);
+	CHECK_EQ(summary.state.pathLength, 60.0);
+	CHECK_EQ(summary.state.dropped, 1u);
+	CHECK_EQ(summary.MeanVelocity(1000), 1000.0);
+
+	// Hovering updates do not start a contact; losing capture ends one.
+	CHECK(!tracker.Track(Pointer(WM_POINTERUPDATE, 2, 70, 0, false), summary));
+	CHECK_EQ(tracker.Active(), 0u);
+	CHECK(!tracker.Track(Pointer(WM_POINTERUPDATE, 2, 80, 0), summary));
+	CHECK(tracker.Track(Pointer(WM_POINTERCAPTURECHANGED, 2, 90, 0), summary));
+	CHECK(summary.cancelled);
+	CHECK_EQ(summary.state.samples, 1u);
+}
+
+// Random streams of pointer messages over more ids than the table holds. Every
+// contact that is started ends exactly once, and the tracker never holds more
+// contacts than were started or than fit.
+TEST(PointerTracker, RandomEventStreams)
+{
+	constexpr UINT MESSAGES[] = { WM_POINTERDOWN, WM_POINTERUPDATE, WM_POINTERUP, WM_POINTERCAPTURECHANGED, WM_MOUSEMOVE };
+	std::mt19937 random{ 42 };
+	for (int run = 0; run < 20; run++)
+	{
+		PointerTracker tracker{};
+		std::map<uint32_t, uint32_t> down;
+		uint64_t overflow = 0;
+		int64_t timestamp = 0;
+		for (int step = 0; step < 5000; step++)
+		{
+			const UINT message = MESSAGES[random() % std::size(MESSAGES)];
+			const uint32_t pointerId = random() % 200;
+			const bool inContact = random() % 2 == 0;
+			timestamp += random() % 3;
+			const TraceRecord record = Pointer(message, pointerId, timestamp, static_cast<int16_t>(random() % 2000 - 1000), inContact);
+
+			const bool known = down.count(pointerId) != 0;
+			ContactSummary summary{};
+			const bool ended = tracker.Track(record, summary);
+			CHECK_EQ(ended, known && (message == WM_POINTERUP || message == WM_POINTERCAPTURECHANGED));
+			if (ended)
+			{
+				CHECK_EQ(summary.pointerId, pointerId);
+				CHECK_EQ(summary.state.samples, down[pointerId] + (message == WM_POINTERUP));
+				CHECK(summary.Duration() >= 0);
+				CHECK(summary.state.pathLength >= 0);
+				down.erase(pointerId);
+			}
+			else if (message == WM_POINTERUPDATE && known)
+			{
+				down[pointerId]++;
+			}
+			else if (message == WM_POINTERDOWN || (message == WM_POINTERUPDATE && inContact))
+			{
+				// A new contact needs a free slot; one is always kept empty.
+				if (known || down.size() < 63)
+				{
+					down[pointerId] = 1;
+				}
+				else
+				{
+					overflow++;
+				}
+			}
+			CHECK_EQ(tracker.Active(), down.size());
+		}
+		CHECK_EQ(tracker.Overflow(), overflow);
+		CHECK(overflow > 0);
+	}
+}
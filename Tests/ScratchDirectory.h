@@ -0,0 +1,25 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <fmt/format.h>
+#include <string_view>
+#include <system_error>
+
+// A directory of its own under the temporary directory, removed afterwards.
+struct ScratchDirectory
+{
+	std::filesystem::path path;
+
+	explicit ScratchDirectory(std::string_view name)
+	{
+		path = std::filesystem::temp_directory_path() / fmt::format("WmPointerTests-{}-{}", name, std::chrono::steady_clock::now().time_since_epoch().count());
+		std::filesystem::create_directories(path);
+	}
+
+	~ScratchDirectory()
+	{
+		std::error_code error;
+		std::filesystem::remove_all(path, error);
+	}
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <string_view>
+#include <vector>
+
+// A minimal test harness: TEST(Suite, Name) registers a function, CHECK and
+// CHECK_EQ report a failure and let the test carry on. WmPointerTests runs
+// every test, or those of the suites named on its command line, and exits
+// with 1 if any check failed.
+struct TestCase
+{
+	std::string_view suite;
+	std::string_view name;
+	void (*run)();
+};
+
+std::vector<TestCase>& TestCases();
+void ReportFailure(std::string_view expression, std::string_view detail, const char* file, int line);
+
+struct TestRegistration
+{
+	TestRegistration(std::string_view suite, std::string_view name, void (*run)()) { TestCases().push_back({ suite, name, run }); }
+};
+
+template <typename A, typename B>
+void CheckEqual(const A& a, const B& b, std::string_view expression, const char* file, int line)
+{
+	if (!(a == b))
+	{
+		ReportFailure(expression, fmt::format("{} != {}", a, b), file, line);
+	}
+}
+
+#define TEST(suite, name) \
+	static void suite##_##name(); \
+	static const TestRegistration suite##_##name##_registration{ #suite, #name, &suite##_##name }; \
+	static void suite##_##name()
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			ReportFailure(#condition, {}, __FILE__, __LINE__); \
+		} \
+	} while (false)
+
+#define CHECK_EQ(a, b) CheckEqual((a), (b), #a " == " #b, __FILE__, __LINE__)
@@ -0,0 +1,43 @@
+#include "Test.h"
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+static size_t g_Failures = 0;
+
+std::vector<TestCase>& TestCases()
+{
+	static std::vector<TestCase> cases;
+	return cases;
+}
+
+void ReportFailure(std::string_view expression, std::string_view detail, const char* file, int line)
+{
+	g_Failures++;
+	fmt::print(stderr, "{}:{}: CHECK({}) failed{}{}\n", file, line, expression, detail.empty() ? "" : ": ", detail);
+}
+
+//     WmPointerTests [Suite...]
+int main(int argc, char** argv)
+{
+	const std::vector<std::string_view> suites(argv + 1, argv + argc);
+	size_t run = 0;
+	for (const TestCase& test : TestCases())
+	{
+		if (!suites.empty() && std::find(suites.begin(), suites.end(), test.suite) == suites.end())
+		{
+			continue;
+		}
+		const size_t failures = g_Failures;
+		test.run();
+		run++;
+		fmt::print("{} {}.{}\n", g_Failures == failures ? "ok    " : "FAILED", test.suite, test.name);
+	}
+	if (run == 0)
+	{
+		fmt::print(stderr, "No tests to run\n");
+		return 1;
+	}
+	fmt::print("{} tests, {} failed checks\n", run, g_Failures);
+	return g_Failures == 0 ? 0 : 1;
+}
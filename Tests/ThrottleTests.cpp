@@ -0,0 +1,269 @@
+#include "HeadlessPlatform.h"
+#include "LogSink.h"
+#include "Pipeline.h"
+#include "Test.h"
+#include "Throttle.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+static TraceRecord Move(int64_t timestamp, int16_t x = 0)
+{
+	TraceRecord record{};
+	record.message = WM_MOUSEMOVE;
+	record.lParam = MAKELONG(x, 0);
+	record.timestamp = timestamp;
+	return record;
+}
+
+static Throttler MakeThrottler(ThrottlePolicy policy, uint32_t burst = 1)
+{
+	ThrottleConfig config{};
+	config.policy = policy;
+	config.window = std::chrono::nanoseconds(100);
+	config.burst = burst;
+	return Throttler{ config };
+}
+
+TEST(Throttle, FixedWindow)
+{
+	Throttler throttler = MakeThrottler(ThrottlePolicy::FixedWindow);
+	CHECK(!throttler.Throttle(Move(0), 0).drop);
+	CHECK(throttler.Throttle(Move(50), 50).drop);
+	CHECK(throttler.Throttle(Move(99), 99).drop);
+	CHECK(!throttler.Throttle(Move(100), 100).drop);
+	CHECK_EQ(throttler.TakeThrottledCount(WM_MOUSEMOVE), 2u);
+	CHECK_EQ(throttler.TakeThrottledCount(WM_MOUSEMOVE), 0u);
+}
+
+TEST(Throttle, MessagesAreIndependent)
+{
+	Throttler throttler = MakeThrottler(ThrottlePolicy::FixedWindow);
+	TraceRecord wheel = Move(10);
+	wheel.message = WM_MOUSEWHEEL;
+	CHECK(!throttler.Throttle(Move(0), 0).drop);
+	CHECK(!throttler.Throttle(wheel, 10).drop);
+	// Not in the message table, so never throttled.
+	TraceRecord timer = Move(20);
+	timer.message = WM_TIMER;
+	CHECK(!throttler.Throttle(timer, 20).drop);
+	CHECK(!throttler.Throttle(timer, 21).drop);
+}
+
+TEST(Throttle, TokenBucket)
+{
+	Throttler throttler = MakeThrottler(ThrottlePolicy::TokenBucket, 3);
+	for (int64_t t = 0; t < 3; t++)
+	{
+		CHECK(!throttler.Throttle(Move(t), t).drop);
+	}
+	CHECK(throttler.Throttle(Move(3), 3).drop);
+	// One more token per window.
+	CHECK(!throttler.Throttle(Move(100), 100).drop);
+	CHECK(throttler.Throttle(Move(101), 101).drop);
+	// A quiet spell refills the whole burst.
+	for (int64_t t = 1000; t < 1003; t++)
+	{
+		CHECK(!throttler.Throttle(Move(t), t).drop);
+	}
+	CHECK(throttler.Throttle(Move(1003), 1003).drop);
+}
+
+TEST(Throttle, KeepFirstLast)
+{
+	Throttler throttler = MakeThrottler(ThrottlePolicy::KeepFirstLast);
+	CHECK(!throttler.Throttle(Move(0, 1), 0).drop);
+	CHECK(throttler.Throttle(Move(10, 2), 10).drop);
+	CHECK(throttler.Throttle(Move(20, 3), 20).drop);
+
+	// The next window's first message brings the last one held before it.
+	const ThrottleResult next = throttler.Throttle(Move(150, 4), 150);
+	CHECK(!next.drop);
+	CHECK(next.hasHeld);
+	CHECK_EQ(GET_X_LPARAM(next.held.lParam), 3);
+	CHECK_EQ(throttler.TakeThrottledCount(WM_MOUSEMOVE), 1u);
+
+	// Or the timer releases it once its window has closed.
+	CHECK(throttler.Throttle(Move(160, 5), 160).drop);
+	std::vector<TraceRecord> expired;
+	throttler.Expire([&](const TraceRecord& held) { expired.push_back(held); }, 200);
+	CHECK(expired.empty());
+	throttler.Expire([&](const TraceRecord& held) { expired.push_back(held); }, 250);
+	CHECK_EQ(expired.size(), 1u);
+	CHECK_EQ(expired.empty() ? 0 : GET_X_LPARAM(expired[0].lParam), 5);
+}
+
+TEST(Throttle, ConfigureResets)
+{
+	Throttler throttler = MakeThrottler(ThrottlePolicy::FixedWindow);
+	CHECK(!throttler.Throttle(Move(0), 0).drop);
+	CHECK(throttler.Throttle(Move(1), 1).drop);
+	throttler.Configure(throttler.Config());
+	CHECK(!throttler.Throttle(Move(2), 2).drop);
+	CHECK_EQ(throttler.TakeThrottledCount(WM_MOUSEMOVE), 0u);
+}
+
+// The pipeline throttles on the time messages were stamped with, not on when
+// it gets to them, so a replayed second of input keeps one message per window.
+TEST(Throttle, PipelineUsesRecordTimestamps)
+{
+	StringLogSink output{};
+	HeadlessPlatform platform{ output };
+	EventPipeline pipeline{ platform };
+	pipeline.SetThrottling(true);
+	ThrottleConfig config{};
+	config.window = std::chrono::milliseconds(100);
+	pipeline.GetThrottler().Configure(config);
+
+	// One second at 1 kHz, in microsecond ticks.
+	size_t logged = 0;
+	for (int64_t i = 0; i < 1000; i++)
+	{
+		platform.SetReplayTime(i * 1000, 1000000);
+		logged += pipeline.Process(Move(i * 1000));
+	}
+	CHECK_EQ(logged, 10u);
+	pipeline.Flush();
+	CHECK(output.Text().find("(throttled 99 previous WM_MOUSEMOVE messages)") != std::string::npos);
+}
+
+// Feeds records through an Adaptive throttler the way the pipeline does and
+// returns what it would log, ending with whatever expires after the last one.
+static std::vector<TraceRecord> Adapt(Throttler& throttler, const std::vector<TraceRecord>& records)
+{
+	std::vector<TraceRecord> logged;
+	const auto log = [&](const TraceRecord& record) { logged.push_back(record); };
+	for (const TraceRecord& record : records)
+	{
+		const ThrottleResult result = throttler.Throttle(record, record.timestamp);
+		if (result.releaseHeld)
+		{
+			throttler.ReleaseHeld(log);
+		}
+		if (result.hasHeld)
+		{
+			log(result.held);
+		}
+		if (!result.drop)
+		{
+			log(record);
+		}
+	}
+	throttler.Expire(log, records.empty() ? 0 : records.back().timestamp + throttler.Config().window.count());
+	return logged;
+}
+
+static Throttler MakeAdaptive(uint32_t sampleRate = 100)
+{
+	ThrottleConfig config{};
+	config.policy = ThrottlePolicy::Adaptive;
+	config.window = std::chrono::milliseconds(50);
+	config.sampleRate = sampleRate;
+	return Throttler{ config };
+}
+
+static TraceRecord Update(int64_t timestamp, WORD flags, int16_t x)
+{
+	TraceRecord record{};
+	record.message = WM_POINTERUPDATE;
+	record.wParam = MAKELONG(1, flags);
+	record.lParam = MAKELONG(x, 0);
+	record.timestamp = timestamp;
+	return record;
+}
+
+constexpr int64_t MS = 1000000;
+
+// A 1 kHz burst is sampled down, but its first and last messages and every
+// change of pointer state are kept.
+TEST(Throttle, AdaptiveKeepsEndsAndTransitions)
+{
+	Throttler throttler = MakeAdaptive();
+	std::vector<TraceRecord> records;
+	for (int16_t i = 0; i < 500; i++)
+	{
+		const WORD flags = i >= 200 && i < 203 ? POINTER_MESSAGE_FLAG_INRANGE : POINTER_MESSAGE_FLAG_INRANGE | POINTER_MESSAGE_FLAG_INCONTACT;
+		records.push_back(Update(i * MS, flags, i));
+	}
+	const std::vector<TraceRecord> logged = Adapt(throttler, records);
+	CHECK(logged.size() < 100);
+	CHECK(logged.size() >= 50);
+	CHECK(!logged.empty() && logged.front().lParam == records.front().lParam);
+	CHECK(!logged.empty() && logged.back().lParam == records.back().lParam);
+
+	// The lift at 200, the message before it, the touch down at 203 and the
+	// message before that.
+	for (const int16_t x : { 199, 200, 202, 203 })
+	{
+		CHECK(std::any_of(logged.begin(), logged.end(), [&](const TraceRecord& record) { return GET_X_LPARAM(record.lParam) == x; }));
+	}
+}
+
+// Two interleaved streams and unsampled messages between them come out in the
+// order they went in.
+TEST(Throttle, AdaptivePreservesOrder)
+{
+	Throttler throttler = MakeAdaptive();
+	std::vector<TraceRecord> records;
+	for (int64_t i = 0; i < 1000; i++)
+	{
+		TraceRecord record = i % 2 ? Move(i * MS / 2, static_cast<int16_t>(i)) : Update(i * MS / 2, POINTER_MESSAGE_FLAG_INRANGE, static_cast<int16_t>(i));
+		if (i % 97 == 0)
+		{
+			record.message = WM_POINTERENTER;
+		}
+		// A pause that ends both bursts.
+		if (i >= 500)
+		{
+			record.timestamp += 200 * MS;
+		}
+		records.push_back(record);
+	}
+	const std::vector<TraceRecord> logged = Adapt(throttler, records);
+	CHECK(logged.size() < records.size() / 4);
+	for (size_t i = 1; i < logged.size(); i++)
+	{
+		CHECK(logged[i - 1].timestamp < logged[i].timestamp);
+	}
+	for (const TraceRecord& record : records)
+	{
+		if (record.message == WM_POINTERENTER)
+		{
+			CHECK(std::any_of(logged.begin(), logged.end(), [&](const TraceRecord& kept) { return kept.timestamp == record.timestamp; }));
+		}
+	}
+}
+
+// A slow sink lowers the sample rate; once it speeds up again the rate goes
+// back to the configured one.
+TEST(Throttle, AdaptiveRecoversAfterBurst)
+{
+	Throttler throttler = MakeAdaptive(100);
+	CHECK_EQ(throttler.SampleRate(), 100.0);
+	// 10 ms per event against a 10% budget allows 10 events a second.
+	throttler.ReportSinkCost(100, 1000 * MS);
+	CHECK(throttler.SampleRate() < 11.0);
+
+	std::vector<TraceRecord> records;
+	for (int16_t i = 0; i < 1000; i++)
+	{
+		records.push_back(Update(i * MS, POINTER_MESSAGE_FLAG_INRANGE, i));
+	}
+	const size_t slow = Adapt(throttler, records).size();
+	CHECK(slow <= 14);
+
+	for (int i = 0; i < 100; i++)
+	{
+		throttler.ReportSinkCost(100, 100000);
+	}
+	CHECK_EQ(throttler.SampleRate(), 100.0);
+	for (TraceRecord& record : records)
+	{
+		record.timestamp += 2000 * MS;
+	}
+	const size_t recovered = Adapt(throttler, records).size();
+	CHECK(recovered >= 95);
+	CHECK(recovered <= 105);
+}
@@ -0,0 +1,183 @@
+#include "Decode.h"
+#include "EventLog.h"
+#include "LogSink.h"
+#include "ScratchDirectory.h"
+#include "Test.h"
+#include "Trace.h"
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Pointer updates with their pointer and pen info, and a mouse move every
+// tenth record.
+static TraceRecord Record(uint64_t i)
+{
+	TraceRecord record{};
+	record.timestamp = static_cast<int64_t>(i) * 10;
+	const int16_t x = static_cast<int16_t>(i % 2000);
+	const int16_t y = static_cast<int16_t>(-static_cast<int64_t>(i % 700));
+	record.lParam = MAKELONG(x, y);
+	if (i % 10 == 0)
+	{
+		record.message = WM_MOUSEMOVE;
+		record.wParam = MK_LBUTTON;
+		return record;
+	}
+	record.message = WM_POINTERUPDATE;
+	record.wParam = MAKELONG(i % 4, POINTER_MESSAGE_FLAG_INRANGE | POINTER_MESSAGE_FLAG_INCONTACT);
+	record.flags = TRACE_HAS_POINTER | TRACE_HAS_PEN;
+	record.pointer.pointerType = PT_PEN;
+	record.pointer.pointerId = static_cast<uint32_t>(i % 4);
+	record.pointer.frameId = static_cast<uint32_t>(i);
+	record.pointer.pixelX = x;
+	record.pointer.pixelY = y;
+	record.pointer.himetricX = x * 26;
+	record.pointer.himetricY = y * 26;
+	record.pen.pressure = static_cast<uint32_t>(i % 1024);
+	record.pen.tiltX = static_cast<int32_t>(i % 90) - 45;
+	return record;
+}
+
+static bool SameRecord(const TraceRecord& a, const TraceRecord& b)
+{
+	return std::memcmp(&a, &b, sizeof(TraceRecord)) == 0;
+}
+
+static size_t WriteTrace(const std::filesystem::path& path, uint64_t count)
+{
+	TraceWriter writer{};
+	CHECK(writer.Open(path, 1000));
+	for (uint64_t i = 0; i < count; i++)
+	{
+		CHECK(writer.Append(Record(i)));
+	}
+	CHECK_EQ(writer.Count(), count);
+	writer.Close();
+	CHECK(!writer.IsOpen());
+	return sizeof(TraceHeader) + static_cast<size_t>(count) * sizeof(TraceRecord);
+}
+
+static void Patch(const std::filesystem::path& path, size_t offset, const void* data, size_t size)
+{
+	std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+	file.seekp(static_cast<std::streamoff>(offset));
+	file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+}
+
+// Enough records to make the writer grow its mapping twice; Close cuts the
+// file back to exactly the records written.
+TEST(Trace, RoundTrip)
+{
+	ScratchDirectory directory{ "trace" };
+	const std::filesystem::path path = directory.path / "round.wmpt";
+	const uint64_t count = 2 * TraceWriter::GROWTH_RECORDS + 3;
+	const size_t size = WriteTrace(path, count);
+	CHECK_EQ(static_cast<size_t>(std::filesystem::file_size(path)), size);
+
+	TraceReader reader{};
+	CHECK(reader.Open(path));
+	CHECK_EQ(reader.Header().count, count);
+	CHECK_EQ(reader.Header().timestampFrequency, int64_t{ 1000 });
+	CHECK_EQ(reader.size(), static_cast<size_t>(count));
+	size_t mismatched = 0;
+	for (size_t i = 0; i < reader.size(); i++)
+	{
+		mismatched += SameRecord(reader[i], Record(i)) ? 0 : 1;
+	}
+	CHECK_EQ(mismatched, 0u);
+}
+
+// A writer that never gets to Close leaves a file padded to its growth step,
+// and the header count says how much of it is records.
+TEST(Trace, ReadsWhileWriting)
+{
+	ScratchDirectory directory{ "trace" };
+	const std::filesystem::path path = directory.path / "open.wmpt";
+	TraceWriter writer{};
+	CHECK(writer.Open(path, 1000));
+	for (uint64_t i = 0; i < 5; i++)
+	{
+		writer.Append(Record(i));
+	}
+	TraceReader reader{};
+	CHECK(reader.Open(path));
+	CHECK_EQ(reader.size(), 5u);
+	CHECK(reader.size() == 5 && SameRecord(reader[4], Record(4)));
+}
+
+// A file cut short of the count in its header gives the records that are
+// whole, not the ones the header promises.
+TEST(Trace, HeaderCountBeyondFile)
+{
+	ScratchDirectory directory{ "trace" };
+	const std::filesystem::path path = directory.path / "short.wmpt";
+	WriteTrace(path, 100);
+	std::filesystem::resize_file(path, sizeof(TraceHeader) + 40 * sizeof(TraceRecord) + sizeof(TraceRecord) / 2);
+
+	TraceReader reader{};
+	CHECK(reader.Open(path));
+	CHECK_EQ(reader.Header().count, uint64_t{ 100 });
+	CHECK_EQ(reader.size(), 40u);
+	CHECK(reader.size() == 40 && SameRecord(reader[39], Record(39)));
+}
+
+TEST(Trace, RejectsBadHeaders)
+{
+	ScratchDirectory directory{ "trace" };
+	const std::filesystem::path path = directory.path / "bad.wmpt";
+	TraceReader reader{};
+	CHECK(!reader.Open(directory.path / "missing.wmpt"));
+
+	WriteTrace(path, 10);
+	CHECK(reader.Open(path));
+	Patch(path, offsetof(TraceHeader, magic), "WMPX", 4);
+	CHECK(!reader.Open(path));
+	CHECK_EQ(reader.size(), 0u);
+
+	WriteTrace(path, 10);
+	const uint32_t recordSize = sizeof(TraceRecord) - 8;
+	Patch(path, offsetof(TraceHeader, recordSize), &recordSize, sizeof(recordSize));
+	CHECK(!reader.Open(path));
+
+	WriteTrace(path, 10);
+	const uint32_t version = g_TraceVersion + 1;
+	Patch(path, offsetof(TraceHeader, version), &version, sizeof(version));
+	CHECK(!reader.Open(path));
+
+	WriteTrace(path, 10);
+	std::filesystem::resize_file(path, sizeof(TraceHeader) - 1);
+	CHECK(!reader.Open(path));
+}
+
+// Replaying the records read back logs the same text as logging the records
+// that were written.
+TEST(Trace, ReplayMatchesLive)
+{
+	ScratchDirectory directory{ "trace" };
+	const std::filesystem::path path = directory.path / "replay.wmpt";
+	const uint64_t count = 200;
+	WriteTrace(path, count);
+	TraceReader reader{};
+	CHECK(reader.Open(path));
+
+	for (const bool terse : { false, true })
+	{
+		StringLogSink replayed{};
+		TextEventSink replay{ replayed };
+		CHECK_EQ(ReplayTrace(reader, replay, terse), static_cast<size_t>(count));
+		replay.Flush();
+
+		StringLogSink live{};
+		TextEventSink direct{ live };
+		for (uint64_t i = 0; i < count; i++)
+		{
+			LogMessage(direct, Record(i), terse);
+		}
+		direct.Flush();
+		CHECK(!live.Text().empty());
+		CHECK_EQ(replayed.Text(), live.Text());
+	}
+}
@@ -0,0 +1,427 @@
+#pragma once
+
+#include "Decode.h"
+#include "Trace.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+
+enum class ThrottlePolicy : uint8_t
+{
+	// Drops every message that arrives within the window of the last one let
+	// through.
+	FixedWindow,
+	// Lets `burst` messages through back to back, then one per window.
+	TokenBucket,
+	// Lets the first message of a window through and holds on to the latest
+	// one after it, which is released when the window closes.
+	KeepFirstLast,
+	// Samples high-rate messages (updates, moves, wheel and hit testing) at
+	// a rate the log sink can keep up with instead of dropping whole windows.
+	// The first and last message of a burst, and any whose pointer or button
+	// state differs from the one before, are always kept, as are all other
+	// messages.
+	Adaptive,
+	Count,
+};
+
+constexpr std::string_view ThrottlePolicyName(ThrottlePolicy policy)
+{
+	switch (policy)
+	{
+	case ThrottlePolicy::FixedWindow: return "fixed window";
+	case ThrottlePolicy::TokenBucket: return "token bucket";
+	case ThrottlePolicy::KeepFirstLast: return "keep first/last";
+	case ThrottlePolicy::Adaptive: return "adaptive";
+	default: return "unknown";
+	}
+}
+
+struct ThrottleConfig
+{
+	constexpr static std::chrono::milliseconds DEFAULT_WINDOW{ 500 };
+
+	ThrottlePolicy policy = ThrottlePolicy::FixedWindow;
+	// For Adaptive, how long a message type has to be quiet for its next
+	// message to start a new burst.
+	std::chrono::nanoseconds window = DEFAULT_WINDOW;
+	uint32_t burst = 4;
+	// Adaptive: samples kept per second of each message type, lowered while
+	// logging them would take more than `sinkBudget` of the time.
+	uint32_t sampleRate = 60;
+	double sinkBudget = 0.1;
+};
+
+// Messages that arrive as continuous streams, which Adaptive samples.
+constexpr bool IsSampledMessage(UINT uMsg)
+{
+	switch (uMsg)
+	{
+	case DM_POINTERHITTEST:
+	case WM_NCPOINTERUPDATE:
+	case WM_POINTERUPDATE:
+	case WM_POINTERWHEEL:
+	case WM_POINTERHWHEEL:
+	case WM_TOUCHHITTESTING:
+	case WM_MOUSEMOVE:
+	case WM_MOUSEWHEEL:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// The part of a sampled message whose change is a state transition: pointer
+// flags for pointer messages, the key and button state for mouse messages.
+constexpr uint32_t SampledState(const TraceRecord& record)
+{
+	const WPARAM wParam = static_cast<WPARAM>(record.wParam);
+	return HasPointerIdWParam(record.message) ? HIWORD(wParam) : LOWORD(wParam);
+}
+
+struct ThrottleResult
+{
+	// The message passed in should not be logged.
+	bool drop = false;
+	// A message held back by KeepFirstLast is due and should be logged before
+	// the current one.
+	bool hasHeld = false;
+	TraceRecord held{};
+	// Adaptive keeps the message; the messages it holds, which are all older,
+	// should be released with ReleaseHeld before it is logged so that the log
+	// stays in order.
+	bool releaseHeld = false;
+};
+
+// Per-message throttling state, kept in a dense table indexed through the
+// compile-time message index from Decode.h. FixedWindow and TokenBucket are
+// lock-free; KeepFirstLast and Adaptive need to copy a record and take a
+// per-message mutex for that, so threads only contend on the same message.
+// Throttle can be called from any thread.
+class Throttler
+{
+public:
+	explicit Throttler(ThrottleConfig config = {}) { Configure(config); }
+
+	static int64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Switches policy and resets all per-message state.
+	void Configure(ThrottleConfig config)
+	{
+		m_policy.store(config.policy, std::memory_order_relaxed);
+		m_window.store(config.window.count(), std::memory_order_relaxed);
+		m_burst.store(config.burst ? config.burst : 1, std::memory_order_relaxed);
+		m_sampleRate.store(config.sampleRate ? config.sampleRate : 1, std::memory_order_relaxed);
+		m_sinkBudget.store(config.sinkBudget, std::memory_order_relaxed);
+		UpdateSampleInterval();
+		for (Slot& slot : m_slots)
+		{
+			const std::lock_guard<std::mutex> lock(slot.mutex);
+			slot.mark.store(NEVER, std::memory_order_relaxed);
+			slot.dropped.store(0, std::memory_order_relaxed);
+			SetHeld(slot, false);
+			slot.arrival = NEVER;
+			slot.state = 0;
+		}
+	}
+
+	ThrottleConfig Config() const
+	{
+		ThrottleConfig config{};
+		config.policy = m_policy.load(std::memory_order_relaxed);
+		config.window = std::chrono::nanoseconds(m_window.load(std::memory_order_relaxed));
+		config.burst = m_burst.load(std::memory_order_relaxed);
+		config.sampleRate = m_sampleRate.load(std::memory_order_relaxed);
+		config.sinkBudget = m_sinkBudget.load(std::memory_order_relaxed);
+		return config;
+	}
+
+	// Tells Adaptive how long the log sink took for `events` events, so that
+	// it samples more sparsely while the sink falls behind. The cost per
+	// event is smoothed over recent reports.
+	void ReportSinkCost(uint64_t events, int64_t nanoseconds)
+	{
+		if (events == 0)
+		{
+			return;
+		}
+		const double cost = static_cast<double>(nanoseconds) / static_cast<double>(events);
+		double smoothed = m_sinkCost.load(std::memory_order_relaxed);
+		while (!m_sinkCost.compare_exchange_weak(smoothed, smoothed == 0.0 ? cost : smoothed + (cost - smoothed) / 8.0, std::memory_order_relaxed))
+		{
+		}
+		UpdateSampleInterval();
+	}
+
+	// Samples per second Adaptive currently keeps of each message type.
+	double SampleRate() const
+	{
+		return 1e9 / static_cast<double>(m_sampleInterval.load(std::memory_order_relaxed));
+	}
+
+	ThrottleResult Throttle(const TraceRecord& record, int64_t now = Now())
+	{
+		ThrottleResult result{};
+		Slot* slot = Find(record.message);
+		if (!slot)
+		{
+			return result;
+		}
+
+		const int64_t window = m_window.load(std::memory_order_relaxed);
+		switch (m_policy.load(std::memory_order_relaxed))
+		{
+		case ThrottlePolicy::FixedWindow:
+			{
+				int64_t last = slot->mark.load(std::memory_order_relaxed);
+				do
+				{
+					if (now - last < window)
+					{
+						result.drop = true;
+						break;
+					}
+				} while (!slot->mark.compare_exchange_weak(last, now, std::memory_order_relaxed));
+			}
+			break;
+
+		case ThrottlePolicy::TokenBucket:
+			{
+				// Generic cell rate algorithm: `mark` is the theoretical arrival
+				// time of the next message, which may run ahead of the clock by
+				// up to burst - 1 windows.
+				const int64_t tolerance = window * (m_burst.load(std::memory_order_relaxed) - 1);
+				int64_t tat = slot->mark.load(std::memory_order_relaxed);
+				int64_t next = 0;
+				do
+				{
+					const int64_t base = tat > now ? tat : now;
+					if (base - now > tolerance)
+					{
+						result.drop = true;
+						break;
+					}
+					next = base + window;
+				} while (!slot->mark.compare_exchange_weak(tat, next, std::memory_order_relaxed));
+			}
+			break;
+
+		case ThrottlePolicy::KeepFirstLast:
+			{
+				const std::lock_guard<std::mutex> lock(slot->mutex);
+				if (now - slot->mark.load(std::memory_order_relaxed) >= window)
+				{
+					result.hasHeld = slot->hasHeld;
+					result.held = slot->held;
+					SetHeld(*slot, false);
+					slot->mark.store(now, std::memory_order_relaxed);
+					break;
+				}
+				if (slot->hasHeld)
+				{
+					slot->dropped.fetch_add(1, std::memory_order_relaxed);
+				}
+				slot->held = record;
+				SetHeld(*slot, true);
+				result.drop = true;
+			}
+			return result;
+
+		case ThrottlePolicy::Adaptive:
+			if (!IsSampledMessage(record.message))
+			{
+				result.releaseHeld = m_held.load(std::memory_order_relaxed) > 0;
+				return result;
+			}
+			{
+				const std::lock_guard<std::mutex> lock(slot->mutex);
+				const uint32_t state = SampledState(record);
+				const bool first = now - slot->arrival >= window;
+				const bool transition = state != slot->state;
+				slot->arrival = now;
+				slot->state = state;
+				if (first || transition)
+				{
+					// The held message, the last one of the previous burst or
+					// the last one before the state changed, stays held for
+					// ReleaseHeld.
+					result.releaseHeld = m_held.load(std::memory_order_relaxed) > 0;
+					slot->mark.store(now, std::memory_order_relaxed);
+				}
+				else if (now - slot->mark.load(std::memory_order_relaxed) >= m_sampleInterval.load(std::memory_order_relaxed))
+				{
+					if (slot->hasHeld)
+					{
+						slot->dropped.fetch_add(1, std::memory_order_relaxed);
+						SetHeld(*slot, false);
+					}
+					result.releaseHeld = m_held.load(std::memory_order_relaxed) > 0;
+					slot->mark.store(now, std::memory_order_relaxed);
+				}
+				else
+				{
+					if (slot->hasHeld)
+					{
+						slot->dropped.fetch_add(1, std::memory_order_relaxed);
+					}
+					slot->held = record;
+					SetHeld(*slot, true);
+					result.drop = true;
+				}
+			}
+			return result;
+
+		default:
+			break;
+		}
+
+		if (result.drop)
+		{
+			slot->dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+		return result;
+	}
+
+	// Returns and resets the number of messages of this type dropped since the
+	// last call.
+	uint32_t TakeThrottledCount(UINT uMsg)
+	{
+		Slot* slot = Find(uMsg);
+		if (!slot || slot->dropped.load(std::memory_order_relaxed) == 0)
+		{
+			return 0;
+		}
+		return slot->dropped.exchange(0, std::memory_order_relaxed);
+	}
+
+	// Releases records held by KeepFirstLast whose window has closed, and the
+	// last record of every Adaptive burst that has ended.
+	template <typename Callback>
+	void Expire(Callback&& callback, int64_t now = Now())
+	{
+		const ThrottlePolicy policy = m_policy.load(std::memory_order_relaxed);
+		if (policy != ThrottlePolicy::KeepFirstLast && policy != ThrottlePolicy::Adaptive)
+		{
+			return;
+		}
+		const int64_t window = m_window.load(std::memory_order_relaxed);
+		for (Slot& slot : m_slots)
+		{
+			bool due = false;
+			TraceRecord held{};
+			{
+				const std::lock_guard<std::mutex> lock(slot.mutex);
+				const int64_t since = policy == ThrottlePolicy::Adaptive ? slot.arrival : slot.mark.load(std::memory_order_relaxed);
+				due = slot.hasHeld && now - since >= window;
+				if (due)
+				{
+					held = slot.held;
+					SetHeld(slot, false);
+				}
+			}
+			if (due)
+			{
+				callback(held);
+			}
+		}
+	}
+
+	// Releases every held record at once, oldest first; used before logging a
+	// message that Adaptive keeps.
+	template <typename Callback>
+	void ReleaseHeld(Callback&& callback)
+	{
+		std::array<TraceRecord, g_MessageCount> held;
+		size_t count = 0;
+		for (Slot& slot : m_slots)
+		{
+			const std::lock_guard<std::mutex> lock(slot.mutex);
+			if (slot.hasHeld)
+			{
+				held[count++] = slot.held;
+				SetHeld(slot, false);
+			}
+		}
+		std::sort(held.begin(), held.begin() + count, [](const TraceRecord& a, const TraceRecord& b) { return a.timestamp < b.timestamp; });
+		for (size_t i = 0; i < count; i++)
+		{
+			callback(held[i]);
+		}
+	}
+
+private:
+	constexpr static int64_t NEVER = INT64_MIN / 2;
+
+	struct alignas(64) Slot
+	{
+		std::atomic<int64_t> mark{ NEVER };
+		std::atomic<uint32_t> dropped{ 0 };
+		// Guards everything below it.
+		std::mutex mutex;
+		bool hasHeld = false;
+		TraceRecord held{};
+		// Adaptive: when the last message arrived and its sampled state.
+		int64_t arrival = NEVER;
+		uint32_t state = 0;
+	};
+
+	Slot* Find(UINT uMsg)
+	{
+		if (uMsg >= g_MessageIndexSize || g_MessageIndex[uMsg] == g_NoMessage)
+		{
+			return nullptr;
+		}
+		return &m_slots[g_MessageIndex[uMsg]];
+	}
+
+	// Called with the slot's mutex held.
+	void SetHeld(Slot& slot, bool held)
+	{
+		if (slot.hasHeld != held)
+		{
+			slot.hasHeld = held;
+			if (held)
+			{
+				m_held.fetch_add(1, std::memory_order_relaxed);
+			}
+			else
+			{
+				m_held.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	void UpdateSampleInterval()
+	{
+		double rate = static_cast<double>(m_sampleRate.load(std::memory_order_relaxed));
+		const double cost = m_sinkCost.load(std::memory_order_relaxed);
+		const double budget = m_sinkBudget.load(std::memory_order_relaxed);
+		if (cost > 0.0 && budget > 0.0)
+		{
+			rate = std::min<double>(rate, budget * 1e9 / cost);
+		}
+		// At least one sample a second, so that a slow sink still sees the
+		// shape of the stream.
+		m_sampleInterval.store(static_cast<int64_t>(1e9 / std::max<double>(rate, 1.0)), std::memory_order_relaxed);
+	}
+
+	std::array<Slot, g_MessageCount> m_slots{};
+	std::atomic<ThrottlePolicy> m_policy{ ThrottlePolicy::FixedWindow };
+	std::atomic<int64_t> m_window{ 0 };
+	std::atomic<uint32_t> m_burst{ 1 };
+	std::atomic<uint32_t> m_sampleRate{ 1 };
+	std::atomic<double> m_sinkBudget{ 0.0 };
+	// Nanoseconds the sink takes per event, 0 until the first report.
+	std::atomic<double> m_sinkCost{ 0.0 };
+	std::atomic<int64_t> m_sampleInterval{ 1 };
+	// Slots holding a record, so that Adaptive only asks for ReleaseHeld when
+	// there is something to release.
+	std::atomic<uint32_t> m_held{ 0 };
+};
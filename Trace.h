@@ -0,0 +1,355 @@
+#pragma once
+
+#include "WinCompat.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <type_traits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Binary capture format for pointer and mouse messages.
+//
+// A trace is a TraceHeader followed by a packed array of fixed-size
+// TraceRecords. Everything is little-endian and trivially copyable so that a
+// reader can map the file and hand out pointers into it directly.
+
+constexpr char g_TraceMagic[4] = { 'W', 'M', 'P', 'T' };
+constexpr uint32_t g_TraceVersion = 1;
+
+enum TraceRecordFlags : uint32_t
+{
+	TRACE_HAS_POINTER = 0x1,
+	TRACE_HAS_PEN = 0x2,
+	TRACE_HAS_HITTEST = 0x4,
+};
+
+struct TracePointerInfo
+{
+	uint32_t pointerType;
+	uint32_t pointerId;
+	uint32_t frameId;
+	uint32_t pointerFlags;
+	int32_t pixelX;
+	int32_t pixelY;
+	int32_t himetricX;
+	int32_t himetricY;
+	uint32_t time;
+	uint32_t buttonChangeType;
+	uint64_t performanceCount;
+};
+
+struct TracePenInfo
+{
+	uint32_t penFlags;
+	uint32_t penMask;
+	uint32_t pressure;
+	uint32_t rotation;
+	int32_t tiltX;
+	int32_t tiltY;
+};
+
+// Decoded TOUCH_HIT_TESTING_INPUT; wParam is a pointer for WM_TOUCHHITTESTING
+// and is meaningless once the message has been handled.
+struct TraceHitTest
+{
+	uint32_t pointerId;
+	int32_t x;
+	int32_t y;
+	uint32_t orientation;
+};
+
+struct TraceRecord
+{
+	uint32_t message;
+	uint32_t flags;
+	uint64_t wParam;
+	int64_t lParam;
+	int64_t timestamp;
+	TracePointerInfo pointer;
+	TracePenInfo pen;
+	TraceHitTest hitTest;
+};
+
+struct TraceHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t recordSize;
+	uint32_t reserved;
+	int64_t timestampFrequency;
+	uint64_t count;
+};
+
+static_assert(std::is_trivially_copyable_v<TraceRecord>);
+static_assert(sizeof(TraceHeader) % alignof(TraceRecord) == 0);
+
+constexpr bool IsTracedMessage(UINT uMsg)
+{
+	return (uMsg >= WM_POINTERDEVICECHANGE && uMsg <= WM_POINTERROUTEDRELEASED)
+		|| (uMsg >= WM_MOUSEMOVE && uMsg <= WM_XBUTTONDBLCLK)
+		|| uMsg == WM_MOUSEACTIVATE
+		|| uMsg == WM_MOUSELEAVE;
+}
+
+// Messages whose wParam carries a pointer identifier.
+constexpr bool HasPointerIdWParam(UINT uMsg)
+{
+	return uMsg >= WM_NCPOINTERUPDATE && uMsg <= WM_POINTERROUTEDRELEASED && uMsg != WM_TOUCHHITTESTING;
+}
+
+// Platform-specific file mapping shared by the writer and the reader.
+class TraceMapping
+{
+public:
+	TraceMapping() = default;
+	TraceMapping(const TraceMapping&) = delete;
+	TraceMapping& operator=(const TraceMapping&) = delete;
+	~TraceMapping() { Close(); }
+
+	bool Open(const std::filesystem::path& path, bool writable)
+	{
+		Close();
+		m_writable = writable;
+#ifdef _WIN32
+		m_file = CreateFileW(
+			path.c_str(),
+			writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+			FILE_SHARE_READ,
+			nullptr,
+			writable ? CREATE_ALWAYS : OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL,
+			nullptr
+		);
+		if (m_file == INVALID_HANDLE_VALUE)
+		{
+			m_file = nullptr;
+			return false;
+		}
+		LARGE_INTEGER size{};
+		GetFileSizeEx(m_file, &size);
+		return writable || Map(static_cast<size_t>(size.QuadPart));
+#else
+		m_fd = writable ? open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644) : open(path.c_str(), O_RDONLY);
+		if (m_fd < 0)
+		{
+			return false;
+		}
+		struct stat st{};
+		fstat(m_fd, &st);
+		return writable || Map(static_cast<size_t>(st.st_size));
+#endif
+	}
+
+	// Resizes the underlying file and remaps it. Existing contents are kept.
+	bool Map(size_t size)
+	{
+		Unmap();
+		if (size == 0)
+		{
+			return true;
+		}
+#ifdef _WIN32
+		const DWORD protect = m_writable ? PAGE_READWRITE : PAGE_READONLY;
+		ULARGE_INTEGER mapSize{};
+		mapSize.QuadPart = size;
+		m_mapping = CreateFileMappingW(m_file, nullptr, protect, mapSize.HighPart, mapSize.LowPart, nullptr);
+		if (!m_mapping)
+		{
+			return false;
+		}
+		m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, m_writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size));
+#else
+		if (m_writable && ftruncate(m_fd, static_cast<off_t>(size)) != 0)
+		{
+			return false;
+		}
+		void* data = mmap(nullptr, size, m_writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, m_fd, 0);
+		m_data = data == MAP_FAILED ? nullptr : static_cast<uint8_t*>(data);
+#endif
+		m_size = m_data ? size : 0;
+		return m_data != nullptr;
+	}
+
+	// Unmaps and shrinks the file to its final length.
+	void Close(size_t finalSize = SIZE_MAX)
+	{
+		Unmap();
+#ifdef _WIN32
+		if (m_file)
+		{
+			if (m_writable && finalSize != SIZE_MAX)
+			{
+				LARGE_INTEGER end{};
+				end.QuadPart = static_cast<LONGLONG>(finalSize);
+				SetFilePointerEx(m_file, end, nullptr, FILE_BEGIN);
+				SetEndOfFile(m_file);
+			}
+			CloseHandle(m_file);
+			m_file = nullptr;
+		}
+#else
+		if (m_fd >= 0)
+		{
+			if (m_writable && finalSize != SIZE_MAX)
+			{
+				(void)ftruncate(m_fd, static_cast<off_t>(finalSize));
+			}
+			close(m_fd);
+			m_fd = -1;
+		}
+#endif
+	}
+
+	uint8_t* Data() const { return m_data; }
+	size_t Size() const { return m_size; }
+
+private:
+	void Unmap()
+	{
+#ifdef _WIN32
+		if (m_data)
+		{
+			UnmapViewOfFile(m_data);
+		}
+		if (m_mapping)
+		{
+			CloseHandle(m_mapping);
+			m_mapping = nullptr;
+		}
+#else
+		if (m_data)
+		{
+			munmap(m_data, m_size);
+		}
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+#ifdef _WIN32
+	HANDLE m_file = nullptr;
+	HANDLE m_mapping = nullptr;
+#else
+	int m_fd = -1;
+#endif
+	bool m_writable = false;
+	uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+};
+
+// Append-only trace writer. The file is grown in large steps and records are
+// copied straight into the mapping; the header count is updated after every
+// record so that a trace cut short by a crash is still readable.
+class TraceWriter
+{
+public:
+	constexpr static size_t GROWTH_RECORDS = 64 * 1024;
+
+	~TraceWriter() { Close(); }
+
+	bool Open(const std::filesystem::path& path, int64_t timestampFrequency)
+	{
+		Close();
+		if (!m_mapping.Open(path, true) || !m_mapping.Map(Offset(GROWTH_RECORDS)))
+		{
+			m_mapping.Close();
+			return false;
+		}
+		TraceHeader header{};
+		std::memcpy(header.magic, g_TraceMagic, sizeof(header.magic));
+		header.version = g_TraceVersion;
+		header.recordSize = sizeof(TraceRecord);
+		header.timestampFrequency = timestampFrequency;
+		std::memcpy(m_mapping.Data(), &header, sizeof(header));
+		m_capacity = GROWTH_RECORDS;
+		m_count = 0;
+		m_open = true;
+		return true;
+	}
+
+	bool Append(const TraceRecord& record)
+	{
+		if (!m_open)
+		{
+			return false;
+		}
+		if (m_count == m_capacity)
+		{
+			if (!m_mapping.Map(Offset(m_capacity + GROWTH_RECORDS)))
+			{
+				Close();
+				return false;
+			}
+			m_capacity += GROWTH_RECORDS;
+		}
+		std::memcpy(m_mapping.Data() + Offset(m_count), &record, sizeof(record));
+		m_count++;
+		std::memcpy(m_mapping.Data() + offsetof(TraceHeader, count), &m_count, sizeof(m_count));
+		return true;
+	}
+
+	void Close()
+	{
+		if (m_open)
+		{
+			m_mapping.Close(Offset(m_count));
+			m_open = false;
+		}
+	}
+
+	bool IsOpen() const { return m_open; }
+	uint64_t Count() const { return m_count; }
+
+private:
+	static size_t Offset(uint64_t index) { return sizeof(TraceHeader) + static_cast<size_t>(index) * sizeof(TraceRecord); }
+
+	TraceMapping m_mapping;
+	uint64_t m_capacity = 0;
+	uint64_t m_count = 0;
+	bool m_open = false;
+};
+
+// Read-only view of a trace. Records are returned in place from the mapping.
+class TraceReader
+{
+public:
+	bool Open(const std::filesystem::path& path)
+	{
+		m_records = nullptr;
+		m_count = 0;
+		if (!m_mapping.Open(path, false) || m_mapping.Size() < sizeof(TraceHeader))
+		{
+			return false;
+		}
+		std::memcpy(&m_header, m_mapping.Data(), sizeof(m_header));
+		if (std::memcmp(m_header.magic, g_TraceMagic, sizeof(g_TraceMagic)) != 0
+			|| m_header.version != g_TraceVersion
+			|| m_header.recordSize != sizeof(TraceRecord))
+		{
+			return false;
+		}
+		const uint64_t available = (m_mapping.Size() - sizeof(TraceHeader)) / sizeof(TraceRecord);
+		m_count = m_header.count < available ? m_header.count : available;
+		m_records = reinterpret_cast<const TraceRecord*>(m_mapping.Data() + sizeof(TraceHeader));
+		return true;
+	}
+
+	const TraceHeader& Header() const { return m_header; }
+	size_t size() const { return static_cast<size_t>(m_count); }
+	const TraceRecord* begin() const { return m_records; }
+	const TraceRecord* end() const { return m_records + m_count; }
+	const TraceRecord& operator[](size_t i) const { return m_records[i]; }
+
+private:
+	TraceMapping m_mapping;
+	TraceHeader m_header{};
+	const TraceRecord* m_records = nullptr;
+	uint64_t m_count = 0;
+};